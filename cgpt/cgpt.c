@@ -38,6 +38,7 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Apply many commands to a drive at once"},
 };
 
 static void Usage(void) {
@@ -53,10 +54,45 @@ static void Usage(void) {
   printf("\nFor more detailed usage, use %s COMMAND -h\n\n", progname);
 }
 
-int main(int argc, char *argv[]) {
+// Returns the index of the command named 'command', or of the only command it
+// is a prefix of, or -1 if there's no such command.
+static int FindCommand(const char *command) {
   int i;
   int match_count = 0;
   int match_index = 0;
+
+  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
+    // exact match?
+    if (0 == strcmp(cmds[i].name, command)) {
+      match_index = i;
+      match_count = 1;
+      break;
+    }
+    // unique match?
+    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
+      match_index = i;
+      match_count++;
+    }
+  }
+
+  return match_count == 1 ? match_index : -1;
+}
+
+int RunCommand(int argc, char *argv[]) {
+  int i = FindCommand(argv[0]);
+
+  if (i < 0) {
+    Error("unknown command: %s\n", argv[0]);
+    return CGPT_FAILED;
+  }
+
+  // reset getopt, which then starts at argv[1]
+  optind = 0;
+  return cmds[i].fp(argc, argv);
+}
+
+int main(int argc, char *argv[]) {
+  int i;
   char* command;
 
   progname = strrchr(argv[0], '/');
@@ -74,22 +110,9 @@ int main(int argc, char *argv[]) {
   command = argv[optind++];
 
   // Find the command to invoke.
-  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
-    // exact match?
-    if (0 == strcmp(cmds[i].name, command)) {
-      match_index = i;
-      match_count = 1;
-      break;
-    }
-    // unique match?
-    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
-      match_index = i;
-      match_count++;
-    }
-  }
-
-  if (match_count == 1)
-    return cmds[match_index].fp(argc, argv);
+  i = FindCommand(command);
+  if (i >= 0)
+    return cmds[i].fp(argc, argv);
 
   // Couldn't find a single matching command.
   Usage();
@@ -64,6 +64,17 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
 int DriveClose(struct drive *drive, int update_as_needed);
 int CheckValid(const struct drive *drive);
 
+// Starts a batch of commands on 'drive_path', which is opened read-write and
+// loaded once. Until DriveBatchEnd(), DriveOpen() of the same path returns
+// the shared in-memory drive, and DriveClose() and WritePMBR() only keep the
+// changes in memory.
+//
+// Returns CGPT_FAILED if the drive can't be loaded or a batch is running.
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size);
+// Ends the batch, writing the GPT and PMBR changes once if 'update' is
+// nonzero, or discarding all of them otherwise.
+int DriveBatchEnd(int update);
+
 /* Loads sectors from 'drive'.
  *
  *   drive -- open drive.
@@ -190,6 +201,11 @@ int cmd_find(int argc, char *argv[]);
 int cmd_edit(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
+
+// Runs the command named by 'argv[0]' (or a unique prefix of it), with getopt
+// starting at 'argv[1]'.
+int RunCommand(int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
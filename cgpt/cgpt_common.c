@@ -112,7 +112,29 @@ int Load(struct drive *drive, uint8_t *buf,
 }
 
 
+// The drive shared by the commands of a batch; see DriveBatchBegin().
+static struct {
+  int active;
+  const char *drive_path;
+  uint64_t drive_size;
+  struct drive drive;       /* GPT and PMBR as changed by the batch so far */
+  uint8_t modified;         /* GPT parts changed by the batch */
+  int pmbr_loaded;
+  int pmbr_modified;
+} batch;
+
+static int IsBatchDrive(const struct drive *drive) {
+  return batch.active && drive->fd == batch.drive.fd;
+}
+
 int ReadPMBR(struct drive *drive) {
+  if (IsBatchDrive(drive)) {
+    if (!batch.pmbr_loaded)
+      return CGPT_FAILED;
+    memcpy(&drive->pmbr, &batch.drive.pmbr, sizeof(struct pmbr));
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
@@ -124,6 +146,13 @@ int ReadPMBR(struct drive *drive) {
 }
 
 int WritePMBR(struct drive *drive) {
+  if (IsBatchDrive(drive)) {
+    memcpy(&batch.drive.pmbr, &drive->pmbr, sizeof(struct pmbr));
+    batch.pmbr_loaded = 1;
+    batch.pmbr_modified = 1;
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
@@ -321,6 +350,17 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   require(drive_path);
   require(drive);
 
+  if (batch.active && !strcmp(drive_path, batch.drive_path)) {
+    if (drive_size != batch.drive_size) {
+      Error("%s is already open with a different drive size\n", drive_path);
+      return CGPT_FAILED;
+    }
+    // Each command sees only its own changes as modified.
+    memcpy(drive, &batch.drive, sizeof(struct drive));
+    drive->gpt.modified = 0;
+    return CGPT_OK;
+  }
+
   // Clear struct for proper error handling.
   memset(drive, 0, sizeof(struct drive));
 
@@ -367,6 +407,15 @@ error_close:
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
 
+  if (IsBatchDrive(drive)) {
+    // The buffers are shared with the batch, so only keep the state.
+    if (update_as_needed) {
+      batch.modified |= drive->gpt.modified;
+      memcpy(&batch.drive.gpt, &drive->gpt, sizeof(GptData));
+    }
+    return CGPT_OK;
+  }
+
   if (update_as_needed) {
     if (GptSave(drive)) {
         errors++;
@@ -393,6 +442,42 @@ int DriveClose(struct drive *drive, int update_as_needed) {
 }
 
 
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size) {
+  if (batch.active) {
+    Error("A batch is already running\n");
+    return CGPT_FAILED;
+  }
+
+  memset(&batch, 0, sizeof(batch));
+  if (CGPT_OK != DriveOpen(drive_path, &batch.drive, O_RDWR, drive_size))
+    return CGPT_FAILED;
+  batch.pmbr_loaded = (CGPT_OK == ReadPMBR(&batch.drive));
+
+  batch.drive_path = drive_path;
+  batch.drive_size = drive_size;
+  batch.active = 1;
+  return CGPT_OK;
+}
+
+int DriveBatchEnd(int update) {
+  int errors = 0;
+
+  if (!batch.active)
+    return CGPT_FAILED;
+  batch.active = 0;
+
+  batch.drive.gpt.modified = batch.modified;
+  if (update && batch.pmbr_modified && CGPT_OK != WritePMBR(&batch.drive)) {
+    Error("Cannot write PMBR: %s\n", strerror(errno));
+    errors++;
+  }
+  if (CGPT_OK != DriveClose(&batch.drive, update && !errors))
+    errors++;
+
+  return errors ? CGPT_FAILED : CGPT_OK;
+}
+
+
 /* GUID conversion functions. Accepted format:
  *
  *   "C12A7328-F81F-11D2-BA4B-00A0C93EC93B"
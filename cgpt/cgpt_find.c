@@ -4,9 +4,12 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "cgpt.h"
@@ -21,17 +24,15 @@ static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
                        uint64_t count) {
   uint8_t *bufptr = params->comparebuf;
 
-  if (-1 == lseek(fd, pos, SEEK_SET))
-    return 0;
-
   // keep reading until done or error
   while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+    ssize_t bytes_read = pread(fd, bufptr, count, pos);
     // negative means error, 0 means (unexpected) EOF
     if (bytes_read <= 0)
       return 0;
     count -= bytes_read;
     bufptr += bytes_read;
+    pos += bytes_read;
   }
 
   return 1;
@@ -277,6 +278,136 @@ static int scan_spi_gpt(CgptFindParams *params) {
 }
 #endif
 
+// Most devices searched at once by search_devs(). Searching is mostly waiting
+// for the devices, so this doesn't depend on the number of CPUs.
+#define MAX_SEARCH_JOBS 16
+
+// What searching one device found, filled in by the process searching it.
+struct search_result {
+  int hits;
+  int match_partnum;
+};
+
+// Starts a process searching 'pathname', which prints the matches to
+// '*out_fd' and counts them in 'result'. Returns its pid, or -1 on failure.
+static pid_t fork_search(CgptFindParams *params, const char *pathname,
+                         struct search_result *result, int *out_fd) {
+  int fds[2];
+  pid_t pid;
+
+  if (pipe(fds) < 0)
+    return -1;
+
+  fflush(stdout);
+  pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid > 0) {
+    close(fds[1]);
+    *out_fd = fds[0];
+    return pid;
+  }
+
+  close(fds[0]);
+  if (dup2(fds[1], STDOUT_FILENO) < 0)
+    _exit(1);
+  close(fds[1]);
+  params->hits = 0;
+  params->match_partnum = 0;
+  do_search(params, pathname);
+  result->hits = params->hits;
+  result->match_partnum = params->match_partnum;
+  _exit(fflush(stdout) ? 1 : 0);
+}
+
+// Reads all output of the search process 'pid' from 'fd', and returns it (with
+// '*size') only if the search completed. Returns NULL on failure.
+static char *collect_search(pid_t pid, int fd, size_t *size) {
+  char *buf = NULL, *new_buf;
+  size_t len = 0, max = 0;
+  ssize_t r = -1;
+  int status;
+
+  while (1) {
+    if (len == max) {
+      max = max ? max * 2 : BUFSIZE;
+      new_buf = realloc(buf, max);
+      if (!new_buf)
+        break;
+      buf = new_buf;
+    }
+    r = read(fd, buf + len, max - len);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      break;
+    len += r;
+  }
+  close(fd);
+
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) || r < 0) {
+    free(buf);
+    return NULL;
+  }
+  *size = len;
+  return buf;
+}
+
+// Searches the devices in 'devs', several at once if params->parallel is set,
+// but prints the matches in the same order as searching them one after
+// another. Returns the number of devices with matches.
+static int search_devs(CgptFindParams *params, char *const devs[],
+                       int num_devs) {
+  struct search_result *results = MAP_FAILED;
+  pid_t pids[MAX_SEARCH_JOBS];
+  int fds[MAX_SEARCH_JOBS];
+  int found = 0;
+  int started = 0;
+  int i;
+
+  // The results are shared with the search processes.
+  if (params->parallel && num_devs > 1)
+    results = mmap(NULL, num_devs * sizeof(*results), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  for (i = 0; i < num_devs; i++) {
+    int slot = i % MAX_SEARCH_JOBS;
+    char *buf = NULL;
+    size_t size;
+
+    // Keep up to MAX_SEARCH_JOBS searches running from devs[i] on.
+    for (; results != MAP_FAILED && started < num_devs &&
+           started < i + MAX_SEARCH_JOBS; started++)
+      pids[started % MAX_SEARCH_JOBS] =
+          fork_search(params, devs[started], &results[started],
+                      &fds[started % MAX_SEARCH_JOBS]);
+
+    if (results != MAP_FAILED && pids[slot] > 0)
+      buf = collect_search(pids[slot], fds[slot], &size);
+    if (buf) {
+      fwrite(buf, 1, size, stdout);
+      free(buf);
+      params->hits += results[i].hits;
+      if (!params->match_partnum)
+        params->match_partnum = results[i].match_partnum;
+      if (results[i].hits)
+        found++;
+    } else if (do_search(params, devs[i])) {
+      // Searching serially, or the search process failed (or couldn't
+      // start), so search here.
+      found++;
+    }
+  }
+
+  if (results != MAP_FAILED)
+    munmap(results, num_devs * sizeof(*results));
+  return found;
+}
+
 // This scans all the physical devices it can find, looking for a match. It
 // returns true if any matches were found, false otherwise.
 static int scan_real_devs(CgptFindParams *params) {
@@ -285,6 +416,9 @@ static int scan_real_devs(CgptFindParams *params) {
   char partname_prev[MAX_PARTITION_NAME_LEN];
   FILE *fp;
   char *pathname;
+  char **devs = NULL, **new_devs;
+  int num_devs = 0;
+  int i;
 
   fp = fopen(PROC_PARTITIONS, "re");
   if (!fp) {
@@ -308,8 +442,12 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
+        new_devs = realloc(devs, (num_devs + 1) * sizeof(*devs));
+        if (new_devs) {
+          devs = new_devs;
+          devs[num_devs] = strdup(pathname);
+          if (devs[num_devs])
+            num_devs++;
         }
       }
     }
@@ -320,6 +458,11 @@ static int scan_real_devs(CgptFindParams *params) {
   fclose(fp);
   free(line);
 
+  found = search_devs(params, devs, num_devs);
+  for (i = 0; i < num_devs; i++)
+    free(devs[i]);
+  free(devs);
+
   found += scan_spi_gpt(params);
 
   return found;
@@ -335,3 +478,11 @@ void CgptFind(CgptFindParams *params) {
   else
     scan_real_devs(params);
 }
+
+void CgptFindDrives(CgptFindParams *params, char *const drive_names[],
+                    int num_drives) {
+  if (params == NULL)
+    return;
+
+  search_devs(params, drive_names, num_drives);
+}
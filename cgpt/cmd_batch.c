@@ -0,0 +1,191 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+// Most arguments a command in the script can have.
+#define MAX_BATCH_ARGS 64
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] SCRIPT DRIVE\n\n"
+         "Apply the commands in SCRIPT (\"-\" for stdin) to DRIVE, which is\n"
+         "loaded and saved only once. Each line of SCRIPT is a command with\n"
+         "its options but without DRIVE, for example:\n\n"
+         "    add -i 2 -P 1 -T 0 -S 1\n"
+         "    add -i 4 -l \"KERN-B\"\n"
+         "    prioritize -i 2\n\n"
+         "Blank lines and lines starting with '#' are skipped. If any command\n"
+         "fails, DRIVE is left unchanged.\n\n"
+         "Options:\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside;\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE\n"
+         "\n", progname);
+}
+
+// Splits 'line' in place into words separated by spaces, where quotes group
+// words together. Returns the number of words, or -1 if there are too many
+// or a quote isn't closed.
+static int SplitLine(char *line, char *words[], int max_words) {
+  char *in = line, *out = line;
+  int count = 0;
+
+  while (1) {
+    char quote = 0;
+
+    while (isspace((unsigned char)*in))
+      in++;
+    if (!*in)
+      break;
+    if (count >= max_words)
+      return -1;
+    words[count++] = out;
+
+    while (*in && (quote || !isspace((unsigned char)*in))) {
+      if (*in == quote)
+        quote = 0;
+      else if (!quote && (*in == '"' || *in == '\''))
+        quote = *in;
+      else
+        *out++ = *in;
+      in++;
+    }
+    if (quote)
+      return -1;
+    if (*in)
+      in++;
+    *out++ = '\0';
+  }
+
+  return count;
+}
+
+// Runs each command of 'script' on the batch drive.
+static int RunScript(FILE *script, const char *drive_name,
+                     const char *drive_size) {
+  char *line = NULL;
+  size_t line_size = 0;
+  int line_num = 0;
+  int retval = CGPT_OK;
+
+  while (getline(&line, &line_size, script) != -1) {
+    char *argv[MAX_BATCH_ARGS + 4];
+    int argc = 0;
+    int words;
+
+    line_num++;
+    words = SplitLine(line, argv, MAX_BATCH_ARGS);
+    if (words < 0) {
+      Error("line %d: unmatched quote or too many arguments\n", line_num);
+      retval = CGPT_FAILED;
+      break;
+    }
+    if (!words || argv[0][0] == '#')
+      continue;
+
+    // Give the command the batch's drive size and drive.
+    argc = words;
+    if (drive_size) {
+      memmove(argv + 3, argv + 1, (argc - 1) * sizeof(argv[0]));
+      argv[1] = (char *)"-D";
+      argv[2] = (char *)drive_size;
+      argc += 2;
+    }
+    argv[argc++] = (char *)drive_name;
+    argv[argc] = NULL;
+
+    if (CGPT_OK != RunCommand(argc, argv)) {
+      Error("line %d: %s failed\n", line_num, argv[0]);
+      retval = CGPT_FAILED;
+      break;
+    }
+  }
+
+  free(line);
+  return retval;
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  const char *drive_size_arg = NULL;
+  uint64_t drive_size = 0;
+  const char *script_name;
+  const char *drive_name;
+  FILE *script;
+  int retval;
+
+  int c;
+  char* e = 0;
+  int errorcnt = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hD:")) != -1)
+  {
+    switch (c)
+    {
+    case 'D':
+      drive_size_arg = optarg;
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind + 2 != argc) {
+    Usage();
+    return CGPT_FAILED;
+  }
+  script_name = argv[optind];
+  drive_name = argv[optind + 1];
+
+  if (!strcmp(script_name, "-")) {
+    script = stdin;
+  } else {
+    script = fopen(script_name, "r");
+    if (!script) {
+      Error("Can't open %s: %s\n", script_name, strerror(errno));
+      return CGPT_FAILED;
+    }
+  }
+
+  if (CGPT_OK != DriveBatchBegin(drive_name, drive_size)) {
+    retval = CGPT_FAILED;
+  } else {
+    retval = RunScript(script, drive_name, drive_size_arg);
+    if (CGPT_OK != DriveBatchEnd(retval == CGPT_OK))
+      retval = CGPT_FAILED;
+  }
+
+  if (script != stdin)
+    fclose(script);
+  return retval;
+}
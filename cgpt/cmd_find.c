@@ -75,7 +75,6 @@ int cmd_find(int argc, char *argv[]) {
   CgptFindParams params;
   memset(&params, 0, sizeof(params));
 
-  int i;
   int errorcnt = 0;
   char *e = 0;
   int c;
@@ -162,11 +161,10 @@ int cmd_find(int argc, char *argv[]) {
     return CGPT_FAILED;
   }
 
+  // cgpt has no show_fn of its own, so it can search in child processes.
+  params.parallel = 1;
   if (optind < argc) {
-    for (i=optind; i<argc; i++) {
-      params.drive_name = argv[i];
-      CgptFind(&params);
-      }
+    CgptFindDrives(&params, argv + optind, argc - optind);
   } else {
       CgptFind(&params);
   }
@@ -25,6 +25,12 @@ enum vb2_load_partition_flags {
 
 #define KBUF_SIZE 65536  /* Bytes to read at start of kernel partition */
 
+/* Most kernel partitions whose vblocks are read in one batch */
+#define VBLOCK_BATCH_MAX 8
+
+/* Default bytes of kernel body to read before hashing them */
+#define KBODY_CHUNK_SIZE (256 * 1024)
+
 /* Minimum context work buffer size needed for vb2_load_partition() */
 #define VB2_LOAD_PARTITION_WORKBUF_BYTES	\
 	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + KBUF_SIZE)
@@ -342,29 +348,38 @@ static vb2_error_t vb2_verify_kernel_vblock(
  * @param ctx		Vboot context
  * @param params	Load-kernel parameters
  * @param stream	Stream to load kernel from
+ * @param vblock	First KBUF_SIZE bytes of the partition if they have
+ *			already been read, in which case the stream starts
+ *			after them; NULL to read them from the stream.  The
+ *			buffer is modified during verification.
  * @param lpflags	Flags (one or more of vb2_load_partition_flags)
  * @return VB2_SUCCESS, or non-zero error code.
  */
 static vb2_error_t vb2_load_partition(
 	struct vb2_context *ctx, struct vb2_kernel_params *params,
-	VbExStream_t stream, uint32_t lpflags)
+	VbExStream_t stream, uint8_t *vblock, uint32_t lpflags)
 {
 	uint32_t read_ms = 0, start_ts;
+	uint32_t vblock_read = 0;
 	struct vb2_workbuf wb;
+	uint8_t *kbuf = vblock;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
 
-	/* Allocate kernel header buffer in workbuf */
-	uint8_t *kbuf = vb2_workbuf_alloc(&wb, KBUF_SIZE);
-	if (!kbuf)
-		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
+	if (!kbuf) {
+		/* Allocate kernel header buffer in workbuf */
+		kbuf = vb2_workbuf_alloc(&wb, KBUF_SIZE);
+		if (!kbuf)
+			return VB2_ERROR_LOAD_PARTITION_WORKBUF;
 
-	start_ts = vb2ex_mtime();
-	if (VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
-		VB2_DEBUG("Unable to read start of partition.\n");
-		return VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
+		start_ts = vb2ex_mtime();
+		if (VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
+			VB2_DEBUG("Unable to read start of partition.\n");
+			return VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
+		}
+		read_ms += vb2ex_mtime() - start_ts;
+		vblock_read = KBUF_SIZE;
 	}
-	read_ms += vb2ex_mtime() - start_ts;
 
 	if (vb2_verify_kernel_vblock(ctx, kbuf, KBUF_SIZE, lpflags, &wb))
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_VBLOCK;
@@ -399,8 +414,27 @@ static vb2_error_t vb2_load_partition(
 		return 	VB2_ERROR_LOAD_PARTITION_BODY_SIZE;
 	}
 
-	uint32_t body_toread = preamble->body_signature.data_size;
+	/* Get key for body verification from the keyblock. */
+	struct vb2_public_key data_key;
+	if (vb2_unpack_key(&data_key, &keyblock->data_key)) {
+		VB2_DEBUG("Unable to unpack kernel data key\n");
+		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+	}
+
+	data_key.allow_hwcrypto = vb2api_hwcrypto_allowed(ctx);
+
+	uint32_t body_size = preamble->body_signature.data_size;
+	uint32_t body_toread = body_size;
 	uint8_t *body_readptr = kernbuf;
+	uint32_t hash_ms = 0;
+	struct vb2_digest_context dc;
+	struct vb2_hash hash;
+
+	if (vb2_digest_init(&dc, data_key.allow_hwcrypto, data_key.hash_alg,
+			    body_size)) {
+		VB2_DEBUG("Unable to start kernel data digest.\n");
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+	}
 
 	/*
 	 * If we've already read part of the kernel, copy that to the beginning
@@ -411,34 +445,49 @@ static vb2_error_t vb2_load_partition(
 		body_copied = body_toread;  /* Don't over-copy tiny kernel */
 	memcpy(body_readptr, kbuf + body_offset, body_copied);
 	body_toread -= body_copied;
-	body_readptr += body_copied;
 
-	/* Read the kernel data */
-	start_ts = vb2ex_mtime();
-	if (body_toread && VbExStreamRead(stream, body_toread, body_readptr)) {
-		VB2_DEBUG("Unable to read kernel data.\n");
-		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
-	}
-	read_ms += vb2ex_mtime() - start_ts;
-	if (read_ms == 0)  /* Avoid division by 0 in speed calculation */
-		read_ms = 1;
-	VB2_DEBUG("read %u KB in %u ms at %u KB/s.\n",
-		  (body_toread + KBUF_SIZE) / 1024, read_ms,
-		  (uint32_t)(((body_toread + KBUF_SIZE) * VB2_MSEC_PER_SEC) /
-			     (read_ms * 1024)));
+	/*
+	 * Read the rest of the kernel data a chunk at a time, extending the
+	 * digest over each chunk as soon as it arrives.  The chunk is still
+	 * in cache, and the stream can fetch the next one while we hash.
+	 */
+	uint32_t chunk_size = params->body_chunk_size ?: KBODY_CHUNK_SIZE;
+	uint32_t hash_size = body_copied;
+	while (1) {
+		start_ts = vb2ex_mtime();
+		if (vb2_digest_extend(&dc, body_readptr, hash_size)) {
+			VB2_DEBUG("Unable to hash kernel data.\n");
+			return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+		}
+		hash_ms += vb2ex_mtime() - start_ts;
+		body_readptr += hash_size;
 
-	/* Get key for preamble/data verification from the keyblock. */
-	struct vb2_public_key data_key;
-	if (vb2_unpack_key(&data_key, &keyblock->data_key)) {
-		VB2_DEBUG("Unable to unpack kernel data key\n");
-		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+		if (!body_toread)
+			break;
+
+		hash_size = VB2_MIN(body_toread, chunk_size);
+		start_ts = vb2ex_mtime();
+		if (VbExStreamRead(stream, hash_size, body_readptr)) {
+			VB2_DEBUG("Unable to read kernel data.\n");
+			return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		}
+		read_ms += vb2ex_mtime() - start_ts;
+		body_toread -= hash_size;
 	}
 
-	data_key.allow_hwcrypto = vb2api_hwcrypto_allowed(ctx);
+	uint32_t body_read = body_size - body_copied;
+	if (read_ms == 0)  /* Avoid division by 0 in speed calculation */
+		read_ms = 1;
+	VB2_DEBUG("read %u KB in %u ms at %u KB/s, hashed in %u ms.\n",
+		  (body_read + vblock_read) / 1024, read_ms,
+		  (uint32_t)(((body_read + vblock_read) * VB2_MSEC_PER_SEC) /
+			     (read_ms * 1024)), hash_ms);
 
 	/* Verify kernel data */
-	if (vb2_verify_data(kernbuf, kernbuf_size, &preamble->body_signature,
-			    &data_key, &wb)) {
+	if (vb2_digest_finalize(&dc, hash.raw,
+				vb2_digest_size(data_key.hash_alg)) ||
+	    vb2_verify_digest(&data_key, &preamble->body_signature, hash.raw,
+			      &wb)) {
 		VB2_DEBUG("Kernel data verification failed.\n");
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
 	}
@@ -474,7 +523,7 @@ static vb2_error_t try_minios_kernel(struct vb2_context *ctx,
 		return rv;
 	}
 
-	rv = vb2_load_partition(ctx, params, stream, lpflags);
+	rv = vb2_load_partition(ctx, params, stream, NULL, lpflags);
 	VB2_DEBUG("vb2_load_partition returned: %d\n", rv);
 
 	VbExStreamClose(stream);
@@ -598,6 +647,119 @@ vb2_error_t vb2api_load_minios_kernel(struct vb2_context *ctx,
 	return rv;
 }
 
+/*
+ * Kernel partitions whose vblocks are read together.  Only used once a good
+ * kernel has been found, when the remaining candidates are just checked for
+ * rollback and nothing but their vblocks is needed.
+ */
+struct vblock_batch {
+	struct {
+		/* Index of the partition in the GPT entries */
+		int gpt_index;
+		uint64_t start;
+		uint64_t size;
+		/* First KBUF_SIZE bytes, or NULL if they weren't read */
+		uint8_t *vblock;
+	} part[VBLOCK_BATCH_MAX];
+	uint32_t count;
+	/* Next entry returned by next_kernel_entry() */
+	uint32_t next;
+	/* Buffer holding all the vblocks */
+	uint8_t *buf;
+};
+
+/*
+ * Take up to VBLOCK_BATCH_MAX of the remaining kernel partitions in priority
+ * order, then read their vblocks in order of increasing LBA.  Each read is
+ * bounded to the vblock, so the stream never covers the kernel body.
+ */
+static void read_vblock_batch(GptData *gpt, struct vb2_disk_info *disk_info,
+			      struct vblock_batch *batch)
+{
+	uint64_t kbuf_sectors = KBUF_SIZE / disk_info->bytes_per_lba;
+	uint32_t order[VBLOCK_BATCH_MAX];
+	uint32_t i, j, read_ms, start_ts;
+	uint64_t start, size;
+
+	batch->count = batch->next = 0;
+	while (batch->count < VBLOCK_BATCH_MAX &&
+	       GptNextKernelEntry(gpt, &start, &size) == GPT_SUCCESS) {
+		batch->part[batch->count].gpt_index = gpt->current_kernel;
+		batch->part[batch->count].start = start;
+		batch->part[batch->count].size = size;
+		batch->part[batch->count].vblock = NULL;
+		batch->count++;
+	}
+
+	if (!batch->count || KBUF_SIZE % disk_info->bytes_per_lba)
+		return;
+
+	/*
+	 * Only allocate room for the partitions actually taken.  A later batch
+	 * is only read if this one was full, so it never needs more.
+	 */
+	if (!batch->buf)
+		batch->buf = malloc(batch->count * KBUF_SIZE);
+	if (!batch->buf) {
+		VB2_DEBUG("Unable to allocate vblock batch buffer.\n");
+		return;
+	}
+
+	/* Insertion sort by starting LBA */
+	for (i = 0; i < batch->count; i++) {
+		for (j = i; j > 0 && batch->part[order[j - 1]].start >
+					     batch->part[i].start; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	start_ts = vb2ex_mtime();
+	for (i = 0; i < batch->count; i++) {
+		uint8_t *buf = batch->buf + order[i] * KBUF_SIZE;
+		VbExStream_t stream;
+
+		start = batch->part[order[i]].start;
+		size = batch->part[order[i]].size;
+		if (size <= kbuf_sectors ||
+		    VbExStreamOpen(disk_info->handle, start, kbuf_sectors,
+				   &stream))
+			continue;
+		if (!VbExStreamRead(stream, KBUF_SIZE, buf))
+			batch->part[order[i]].vblock = buf;
+		VbExStreamClose(stream);
+	}
+	read_ms = vb2ex_mtime() - start_ts;
+	VB2_DEBUG("Read %u vblocks in %u ms.\n", batch->count, read_ms);
+}
+
+/*
+ * Return the next candidate kernel partition.  With batching enabled and
+ * only vblocks left to check, the remaining partitions come from a batch and
+ * *vblock is set if the vblock was already read.
+ */
+static int next_kernel_entry(GptData *gpt, struct vb2_disk_info *disk_info,
+			     struct vblock_batch *batch, bool vblock_only,
+			     uint64_t *start, uint64_t *size, uint8_t **vblock)
+{
+	*vblock = NULL;
+
+	if (!vblock_only || !(disk_info->flags & VB2_DISK_FLAG_BATCH_VBLOCKS))
+		return GptNextKernelEntry(gpt, start, size);
+
+	if (batch->next == batch->count) {
+		read_vblock_batch(gpt, disk_info, batch);
+		if (!batch->count)
+			return GPT_ERROR_NO_VALID_KERNEL;
+	}
+
+	gpt->current_kernel = batch->part[batch->next].gpt_index;
+	*start = batch->part[batch->next].start;
+	*size = batch->part[batch->next].size;
+	*vblock = batch->part[batch->next].vblock;
+	batch->next++;
+	return GPT_SUCCESS;
+}
+
 vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 			       struct vb2_kernel_params *params,
 			       struct vb2_disk_info *disk_info)
@@ -605,6 +767,7 @@ vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	int found_partitions = 0;
 	uint32_t lowest_version = LOWEST_TPM_VERSION;
+	struct vblock_batch batch = {0};
 	vb2_error_t rv;
 
 	/* Clear output params */
@@ -631,8 +794,11 @@ vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 
 	/* Loop over candidate kernel partitions */
 	uint64_t part_start, part_size;
-	while (GptNextKernelEntry(&gpt, &part_start, &part_size) ==
-	       GPT_SUCCESS) {
+	uint8_t *vblock;
+	while (next_kernel_entry(&gpt, disk_info, &batch,
+				 params->partition_number > 0,
+				 &part_start, &part_size,
+				 &vblock) == GPT_SUCCESS) {
 
 		VB2_DEBUG("Found kernel entry at %"
 			  PRIu64 " size %" PRIu64 "\n",
@@ -641,16 +807,6 @@ vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 		/* Found at least one kernel partition. */
 		found_partitions++;
 
-		/* Set up the stream */
-		VbExStream_t stream = NULL;
-		if (VbExStreamOpen(disk_info->handle,
-				   part_start, part_size, &stream)) {
-			VB2_DEBUG("Partition error getting stream.\n");
-			VB2_DEBUG("Marking kernel as invalid.\n");
-			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
-			continue;
-		}
-
 		uint32_t lpflags = 0;
 		if (params->partition_number > 0) {
 			/*
@@ -660,8 +816,26 @@ vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 			lpflags |= VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY;
 		}
 
-		rv = vb2_load_partition(ctx, params, stream, lpflags);
-		VbExStreamClose(stream);
+		/*
+		 * Set up the stream, unless the vblock was read in a batch
+		 * and is all we need.
+		 */
+		VbExStream_t stream = NULL;
+		if (vblock)
+			rv = VB2_SUCCESS;
+		else
+			rv = VbExStreamOpen(disk_info->handle,
+					    part_start, part_size, &stream);
+		if (rv) {
+			VB2_DEBUG("Partition error getting stream.\n");
+			VB2_DEBUG("Marking kernel as invalid.\n");
+			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
+			continue;
+		}
+
+		rv = vb2_load_partition(ctx, params, stream, vblock, lpflags);
+		if (stream)
+			VbExStreamClose(stream);
 
 		if (rv) {
 			VB2_DEBUG("Marking kernel as invalid (err=%x).\n", rv);
@@ -728,9 +902,11 @@ vb2_error_t vb2api_load_kernel(struct vb2_context *ctx,
 			VB2_DEBUG("Same kernel version\n");
 			break;
 		}
-	} /* while(GptNextKernelEntry) */
+	} /* while(next_kernel_entry) */
 
  gpt_done:
+	free(batch.buf);
+
 	/* Write and free GPT data */
 	WriteAndFreeGptData(disk_info->handle, &gpt);
 
@@ -124,17 +124,8 @@ static void montMul1(const struct vb2_public_key *key,
 		montMulAdd0(key, c, a);
 }
 
-/**
- * In-place public exponentiation.
- *
- * @param key		Key to use in signing
- * @param inout		Input and output big-endian byte array
- * @param workbuf32	Work buffer; caller must verify this is
- *			(3 * key->arrsize) elements long.
- * @param exp		RSA public exponent: either 65537 (F4) or 3
- */
-static void modpow(const struct vb2_public_key *key, uint8_t *inout,
-		uint32_t *workbuf32, int exp)
+void vb2_modpow32(const struct vb2_public_key *key, uint8_t *inout,
+		  uint32_t *workbuf32, int exp)
 {
 	uint32_t *a = workbuf32;
 	uint32_t *aR = a + key->arrsize;
@@ -182,6 +173,212 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 	}
 }
 
+#ifdef VB2_RSA_LIMB64
+
+uint64_t vb2_mont_n0inv64(const struct vb2_public_key *key)
+{
+	uint64_t n0 = key->n[0] | (uint64_t)key->n[1] << 32;
+	/* key->n0inv is -1 / n mod 2^32; one Newton step doubles that */
+	uint64_t inv = -(uint64_t)key->n0inv;
+
+	inv *= 2 - n0 * inv;
+	return -inv;
+}
+
+/*
+ * The same Montgomery arithmetic on 64-bit limbs.  R is unchanged, so
+ * key->rr can be used as is, but there are half as many limbs and a quarter
+ * as many multiplies.  key->n and key->rr are read two words at a time.
+ */
+
+typedef unsigned __int128 uint128_t;
+
+static inline uint64_t limb64(const uint32_t *a, uint32_t i)
+{
+	return a[2 * i] | (uint64_t)a[2 * i + 1] << 32;
+}
+
+/**
+ * a[] -= mod
+ */
+static void subM64(const struct vb2_public_key *key, uint64_t *a)
+{
+	uint128_t A = 0;
+	uint32_t i;
+	for (i = 0; i < key->arrsize / 2; ++i) {
+		A = (uint128_t)a[i] - limb64(key->n, i) - (uint64_t)(A >> 127);
+		a[i] = (uint64_t)A;
+	}
+}
+
+/**
+ * Return a[] >= mod
+ */
+static int mont_ge64(const struct vb2_public_key *key, const uint64_t *a)
+{
+	uint32_t i;
+	for (i = key->arrsize / 2; i;) {
+		--i;
+		if (a[i] < limb64(key->n, i))
+			return 0;
+		if (a[i] > limb64(key->n, i))
+			return 1;
+	}
+	return 1;  /* equal */
+}
+
+/**
+ * Montgomery c[] += a * b[] / R % mod
+ */
+static void montMulAdd64(const struct vb2_public_key *key, uint64_t n0inv,
+			 uint64_t *c, const uint64_t a, const uint64_t *b)
+{
+	uint128_t A = (uint128_t)a * b[0] + c[0];
+	uint64_t d0 = (uint64_t)A * n0inv;
+	uint128_t B = (uint128_t)d0 * limb64(key->n, 0) + (uint64_t)A;
+	uint32_t i;
+
+	for (i = 1; i < key->arrsize / 2; ++i) {
+		A = (A >> 64) + (uint128_t)a * b[i] + c[i];
+		B = (B >> 64) + (uint128_t)d0 * limb64(key->n, i) +
+			(uint64_t)A;
+		c[i - 1] = (uint64_t)B;
+	}
+
+	A = (A >> 64) + (B >> 64);
+
+	c[i - 1] = (uint64_t)A;
+
+	if (A >> 64) {
+		subM64(key, c);
+	}
+}
+
+/**
+ * Montgomery c[] += 0 * b[] / R % mod
+ */
+static void montMulAdd064(const struct vb2_public_key *key, uint64_t n0inv,
+			  uint64_t *c)
+{
+	uint64_t d0 = c[0] * n0inv;
+	uint128_t B = (uint128_t)d0 * limb64(key->n, 0) + c[0];
+	uint32_t i;
+
+	for (i = 1; i < key->arrsize / 2; ++i) {
+		B = (B >> 64) + (uint128_t)d0 * limb64(key->n, i) + c[i];
+		c[i - 1] = (uint64_t)B;
+	}
+
+	c[i - 1] = B >> 64;
+}
+
+/**
+ * Montgomery c[] = a[] * b[] / R % mod
+ */
+static void montMul64(const struct vb2_public_key *key, uint64_t n0inv,
+		      uint64_t *c, const uint64_t *a, const uint64_t *b)
+{
+	uint32_t i;
+	for (i = 0; i < key->arrsize / 2; ++i) {
+		c[i] = 0;
+	}
+	for (i = 0; i < key->arrsize / 2; ++i) {
+		montMulAdd64(key, n0inv, c, a[i], b);
+	}
+}
+
+/* Montgomery c[] = a[] * 1 / R % key. */
+static void montMul164(const struct vb2_public_key *key, uint64_t n0inv,
+		       uint64_t *c, const uint64_t *a)
+{
+	uint32_t i;
+
+	for (i = 0; i < key->arrsize / 2; ++i)
+		c[i] = 0;
+
+	montMulAdd64(key, n0inv, c, 1, a);
+	for (i = 1; i < key->arrsize / 2; ++i)
+		montMulAdd064(key, n0inv, c);
+}
+
+void vb2_modpow64(const struct vb2_public_key *key, uint8_t *inout,
+		  uint32_t *workbuf32, int exp)
+{
+	const uint32_t size = key->arrsize / 2;
+	const uint64_t n0inv = vb2_mont_n0inv64(key);
+	uint64_t *a = (uint64_t *)workbuf32;
+	uint64_t *aR = a + size;
+	uint64_t *aaR = aR + size;
+	uint64_t *aaa = aaR;  /* Re-use location. */
+	uint64_t *rr = aaR;  /* Only needed before aaR is. */
+	int i, j;
+
+	/* Convert from big endian byte array to little endian limb array. */
+	for (i = 0; i < (int)size; ++i) {
+		const uint8_t *p = inout + (size - 1 - i) * 8;
+		uint64_t tmp = 0;
+		for (j = 0; j < 8; ++j)
+			tmp = tmp << 8 | p[j];
+		a[i] = tmp;
+		rr[i] = limb64(key->rr, i);
+	}
+
+	montMul64(key, n0inv, aR, a, rr);  /* aR = a * RR / R mod M */
+	if (exp == 3) {
+		montMul64(key, n0inv, aaR, aR, aR);
+		montMul64(key, n0inv, a, aaR, aR);
+		montMul164(key, n0inv, aaa, a);
+	} else {
+		/* Exponent 65537 */
+		for (i = 0; i < 16; i+=2) {
+			montMul64(key, n0inv, aaR, aR, aR);
+			montMul64(key, n0inv, aR, aaR, aaR);
+		}
+		montMul64(key, n0inv, aaa, aR, a);
+	}
+
+	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
+	if (mont_ge64(key, aaa)) {
+		subM64(key, aaa);
+	}
+
+	/* Convert to bigendian byte array */
+	for (i = (int)size - 1; i >= 0; --i) {
+		uint64_t tmp = aaa[i];
+		for (j = 56; j >= 0; j -= 8)
+			*inout++ = (uint8_t)(tmp >> j);
+	}
+}
+
+#endif  /* VB2_RSA_LIMB64 */
+
+/**
+ * In-place public exponentiation, using the fastest implementation available.
+ *
+ * @param key		Key to use in signing
+ * @param inout		Input and output big-endian byte array
+ * @param workbuf32	Work buffer; caller must verify this is
+ *			(3 * key->arrsize) elements long.
+ * @param exp		RSA public exponent: either 65537 (F4) or 3
+ */
+static void modpow(const struct vb2_public_key *key, uint8_t *inout,
+		   uint32_t *workbuf32, int exp)
+{
+#ifdef X86_RSA_DISPATCH
+	if (vb2_modpow_ifma_supported(key)) {
+		vb2_modpow_ifma(key, inout, exp);
+		return;
+	}
+#endif
+#ifdef VB2_RSA_LIMB64
+	if (!(key->arrsize & 1)) {
+		vb2_modpow64(key, inout, workbuf32, exp);
+		return;
+	}
+#endif
+	vb2_modpow32(key, inout, workbuf32, exp);
+}
+
 uint32_t vb2_rsa_sig_size(enum vb2_signature_algorithm sig_alg)
 {
 	switch (sig_alg) {
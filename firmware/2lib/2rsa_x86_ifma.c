@@ -0,0 +1,340 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * RSA public exponentiation with AVX-512 IFMA, for x86 host builds.
+ *
+ * vpmadd52luq/vpmadd52huq multiply 52-bit limbs, so numbers are converted to
+ * radix 2^52, using enough limbs for R = 2^(52 * limbs) to be above 4n.  Then
+ * Montgomery products of inputs below 2n stay below 2n, and need no
+ * conditional subtraction until the end.  R^2 mod n for the new R is derived
+ * from key->rr by doubling.  Vectors are padded with zero limbs.
+ *
+ * Tools verify many objects against the same few keys, so the converted
+ * modulus and R^2 are cached in a small fixed table per thread, matched on
+ * the modulus itself.
+ *
+ * Only the functions marked IFMA_TARGET use AVX-512, so the rest of the file
+ * is safe to run before the CPU has been probed.
+ */
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2rsa_private.h"
+#include "2sysincludes.h"
+
+#define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+
+#define LIMB_BITS	52
+#define LIMB_MASK	((1ULL << LIMB_BITS) - 1)
+#define LANES		8
+/* Enough vectors of limbs for RSA-8192 */
+#define MAX_VECS	20
+#define MAX_LIMBS	(MAX_VECS * LANES)
+#define MAX_WORDS	(8192 / 32)
+
+/* Number of keys whose Montgomery constants are kept */
+#define KEY_CACHE_SIZE	4
+
+/* CPUID.1:ECX */
+#define CPUID1_ECX_OSXSAVE	(1 << 27)
+/* CPUID.(7,0):EBX */
+#define CPUID7_EBX_AVX512F	(1 << 16)
+#define CPUID7_EBX_AVX512IFMA	(1 << 21)
+/* XCR0: SSE, AVX, opmask and ZMM register state enabled by the OS */
+#define XCR0_AVX512		0xe6
+
+typedef unsigned __int128 uint128_t;
+
+/* Montgomery constants for a key, in radix 2^52 */
+struct ifma_key {
+	/* Key the constants were derived from */
+	uint32_t arrsize;
+	uint32_t n0inv;
+	uint32_t n32[MAX_WORDS];
+
+	/* Limbs needed for R > 4n */
+	uint32_t limbs;
+	/* -1 / n mod 2^52 */
+	uint64_t k0;
+	uint64_t n[MAX_LIMBS];
+	/* R^2 mod n */
+	uint64_t rr[MAX_LIMBS];
+};
+
+/* Entries with arrsize 0 are unused */
+static __thread struct ifma_key key_cache[KEY_CACHE_SIZE];
+static __thread uint32_t key_cache_next;
+
+static bool cpu_supported(void)
+{
+	static bool probed;
+	static bool supported;
+	unsigned int a, b, c, d;
+	unsigned int xcr0_lo, xcr0_hi;
+
+	if (probed)
+		return supported;
+	probed = true;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & CPUID1_ECX_OSXSAVE))
+		return false;
+	asm volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	if ((xcr0_lo & XCR0_AVX512) != XCR0_AVX512)
+		return false;
+
+	if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		supported = (b & CPUID7_EBX_AVX512F) &&
+			(b & CPUID7_EBX_AVX512IFMA);
+
+	return supported;
+}
+
+bool vb2_modpow_ifma_supported(const struct vb2_public_key *key)
+{
+	return key->arrsize <= MAX_WORDS && cpu_supported();
+}
+
+/* Convert little endian 32-bit words to radix 2^52 limbs. */
+static void to_limbs(uint64_t *r, uint32_t limbs, const uint32_t *a,
+		     uint32_t words)
+{
+	uint128_t acc = 0;
+	uint32_t bits = 0;
+	uint32_t i, j = 0;
+
+	for (i = 0; i < words; i++) {
+		acc |= (uint128_t)a[i] << bits;
+		for (bits += 32; bits >= LIMB_BITS; bits -= LIMB_BITS) {
+			r[j++] = (uint64_t)acc & LIMB_MASK;
+			acc >>= LIMB_BITS;
+		}
+	}
+	while (j < limbs) {
+		r[j++] = (uint64_t)acc & LIMB_MASK;
+		acc >>= LIMB_BITS;
+	}
+}
+
+/* Convert radix 2^52 limbs back to little endian 32-bit words. */
+static void from_limbs(uint32_t *r, uint32_t words, const uint64_t *a)
+{
+	uint128_t acc = 0;
+	uint32_t bits = 0;
+	uint32_t i, j = 0;
+
+	for (i = 0; j < words; i++) {
+		acc |= (uint128_t)a[i] << bits;
+		for (bits += LIMB_BITS; bits >= 32 && j < words; bits -= 32) {
+			r[j++] = (uint32_t)acc;
+			acc >>= 32;
+		}
+	}
+}
+
+/* Return a[] >= n[] */
+static int ge_limbs(const uint64_t *a, const uint64_t *n, uint32_t limbs)
+{
+	uint32_t i;
+
+	for (i = limbs; i;) {
+		--i;
+		if (a[i] != n[i])
+			return a[i] > n[i];
+	}
+	return 1;  /* equal */
+}
+
+/* a[] -= n[] */
+static void sub_limbs(uint64_t *a, const uint64_t *n, uint32_t limbs)
+{
+	uint64_t borrow = 0;
+	uint32_t i;
+
+	for (i = 0; i < limbs; i++) {
+		uint64_t t = a[i] - n[i] - borrow;
+		a[i] = t & LIMB_MASK;
+		borrow = t >> 63;
+	}
+}
+
+/*
+ * Montgomery r[] = a[] * b[] / R mod n, for a, b < 2n.  The result is below
+ * 2n and normalized to 52-bit limbs.  r may not alias a or b.
+ *
+ * Each round adds a[i] * b and q * n, where q makes the lowest limb zero,
+ * then shifts the accumulator down one limb.  The low halves of the products
+ * are added before the shift and the high halves, which belong one limb up,
+ * after it.  Carries are only propagated out of the lowest limb, which is
+ * safe since each limb gains less than 2^54 per round, over at most
+ * MAX_LIMBS rounds.
+ */
+IFMA_TARGET
+static void mont_mul(uint64_t *r, const uint64_t *a, const uint64_t *b,
+		     const uint64_t *n, uint64_t k0, uint32_t limbs)
+{
+	const uint32_t vecs = (limbs + LANES - 1) / LANES;
+	__m512i acc[MAX_VECS + 1];
+	__m512i bv[MAX_VECS], nv[MAX_VECS];
+	uint64_t carry;
+	uint32_t i, v;
+
+	for (v = 0; v < vecs; v++) {
+		acc[v] = _mm512_setzero_si512();
+		bv[v] = _mm512_loadu_si512(b + v * LANES);
+		nv[v] = _mm512_loadu_si512(n + v * LANES);
+	}
+	acc[vecs] = _mm512_setzero_si512();
+
+	for (i = 0; i < limbs; i++) {
+		__m512i ai = _mm512_set1_epi64(a[i]);
+		__m512i qv;
+		uint64_t q;
+
+		for (v = 0; v < vecs; v++)
+			acc[v] = _mm512_madd52lo_epu64(acc[v], ai, bv[v]);
+
+		q = (_mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0])) * k0) &
+			LIMB_MASK;
+		qv = _mm512_set1_epi64(q);
+		acc[0] = _mm512_madd52lo_epu64(acc[0], qv, nv[0]);
+		carry = _mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0])) >>
+			LIMB_BITS;
+		for (v = 1; v < vecs; v++)
+			acc[v] = _mm512_madd52lo_epu64(acc[v], qv, nv[v]);
+
+		/* Shift down one limb; the lowest is now zero */
+		for (v = 0; v < vecs; v++)
+			acc[v] = _mm512_alignr_epi64(acc[v + 1], acc[v], 1);
+		acc[0] = _mm512_add_epi64(acc[0], _mm512_zextsi128_si512(
+					_mm_cvtsi64_si128(carry)));
+
+		for (v = 0; v < vecs; v++) {
+			acc[v] = _mm512_madd52hi_epu64(acc[v], ai, bv[v]);
+			acc[v] = _mm512_madd52hi_epu64(acc[v], qv, nv[v]);
+		}
+	}
+
+	for (v = 0; v < vecs; v++)
+		_mm512_storeu_si512(r + v * LANES, acc[v]);
+
+	/* Normalize */
+	carry = 0;
+	for (i = 0; i < vecs * LANES; i++) {
+		r[i] += carry;
+		carry = r[i] >> LIMB_BITS;
+		r[i] &= LIMB_MASK;
+	}
+}
+
+/* Derive the Montgomery constants for a key. */
+static void init_key(struct ifma_key *ik, const struct vb2_public_key *key)
+{
+	const uint32_t words = key->arrsize;
+	const uint32_t padded = (words * 32 + 2 + LANES * LIMB_BITS - 1) /
+		(LANES * LIMB_BITS) * LANES;
+	uint32_t i;
+
+	ik->arrsize = words;
+	ik->n0inv = key->n0inv;
+	memcpy(ik->n32, key->n, words * sizeof(uint32_t));
+
+	ik->limbs = (words * 32 + 2 + LIMB_BITS - 1) / LIMB_BITS;
+	ik->k0 = vb2_mont_n0inv64(key) & LIMB_MASK;
+	to_limbs(ik->n, padded, key->n, words);
+
+	/*
+	 * R^2 mod n for the new R is key->rr * 2^(2 * extra bits).  All the
+	 * limbs stay normalized, so the top one can't overflow.
+	 */
+	to_limbs(ik->rr, padded, key->rr, words);
+	for (i = 0; i < 2 * (ik->limbs * LIMB_BITS - words * 32); i++) {
+		uint64_t carry = 0;
+		uint32_t j;
+
+		for (j = 0; j < ik->limbs; j++) {
+			ik->rr[j] = (ik->rr[j] << 1) | carry;
+			carry = ik->rr[j] >> LIMB_BITS;
+			ik->rr[j] &= LIMB_MASK;
+		}
+		if (ge_limbs(ik->rr, ik->n, ik->limbs))
+			sub_limbs(ik->rr, ik->n, ik->limbs);
+	}
+}
+
+/*
+ * Return the constants for a key from the cache, deriving them if needed.
+ */
+static const struct ifma_key *get_key(const struct vb2_public_key *key)
+{
+	struct ifma_key *ik;
+	uint32_t i;
+
+	for (i = 0; i < KEY_CACHE_SIZE; i++) {
+		ik = &key_cache[i];
+		if (ik->arrsize == key->arrsize &&
+		    ik->n0inv == key->n0inv &&
+		    !memcmp(ik->n32, key->n, key->arrsize * sizeof(uint32_t)))
+			return ik;
+	}
+
+	/* Replace the oldest entry */
+	ik = &key_cache[key_cache_next++ % KEY_CACHE_SIZE];
+	init_key(ik, key);
+	return ik;
+}
+
+void vb2_modpow_ifma(const struct vb2_public_key *key, uint8_t *inout,
+		     int exp)
+{
+	const struct ifma_key *ik = get_key(key);
+	const uint32_t words = key->arrsize;
+	uint64_t a[MAX_LIMBS], aR[MAX_LIMBS], aaR[MAX_LIMBS], aaa[MAX_LIMBS];
+	uint32_t words32[MAX_WORDS];
+	uint32_t i, limbs, padded;
+
+	limbs = ik->limbs;
+	padded = (limbs + LANES - 1) / LANES * LANES;
+
+	/* Convert from big endian byte array. */
+	for (i = 0; i < words; ++i) {
+		const uint8_t *p = inout + (words - 1 - i) * 4;
+		words32[i] = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 |
+			p[3];
+	}
+	to_limbs(a, padded, words32, words);
+
+	/* aR = a * RR / R mod M */
+	mont_mul(aR, a, ik->rr, ik->n, ik->k0, limbs);
+	if (exp == 3) {
+		mont_mul(aaR, aR, aR, ik->n, ik->k0, limbs);
+		mont_mul(a, aaR, aR, ik->n, ik->k0, limbs);
+		memset(aR, 0, padded * sizeof(aR[0]));
+		aR[0] = 1;
+		mont_mul(aaa, a, aR, ik->n, ik->k0, limbs);
+	} else {
+		/* Exponent 65537 */
+		for (i = 0; i < 16; i += 2) {
+			mont_mul(aaR, aR, aR, ik->n, ik->k0, limbs);
+			mont_mul(aR, aaR, aaR, ik->n, ik->k0, limbs);
+		}
+		mont_mul(aaa, aR, a, ik->n, ik->k0, limbs);
+	}
+
+	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
+	if (ge_limbs(aaa, ik->n, limbs))
+		sub_limbs(aaa, ik->n, limbs);
+
+	/* Convert to big endian byte array */
+	from_limbs(words32, words, aaa);
+	for (i = words; i;) {
+		uint32_t tmp = words32[--i];
+		*inout++ = (uint8_t)(tmp >> 24);
+		*inout++ = (uint8_t)(tmp >> 16);
+		*inout++ = (uint8_t)(tmp >>  8);
+		*inout++ = (uint8_t)(tmp >>  0);
+	}
+}
@@ -139,6 +139,14 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 	int j;
 #endif
 
+#ifdef X86_SHA_DISPATCH
+	vb2_sha256_transform_fn fast = vb2_sha256_x86_transform();
+	if (fast) {
+		fast(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+
 	for (i = 0; i < (int) block_nb; i++) {
 		sub_block = message + (i << 6);
 
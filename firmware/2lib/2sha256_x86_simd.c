@@ -0,0 +1,115 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-256 block transforms using SIMD for the message schedule.
+ *
+ * The message schedule of a block doesn't depend on the hash state, so the
+ * schedules of eight consecutive blocks are expanded together, one block per
+ * 32-bit lane. The rounds then run on the precomputed W + K values.
+ *
+ * The same code is built twice: for AVX2 (one 256-bit register per schedule
+ * word, rorx in the rounds) and for SSSE3 (two 128-bit registers per schedule
+ * word). Only call each one after checking the CPU supports it.
+ */
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define SHA256_SIMD_LANES 8
+
+typedef uint32_t vb2_u32x8 __attribute__((vector_size(32)));
+
+#define SHFR(x, n)    ((x) >> (n))
+#define ROTR(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SHA256_F1(x) (ROTR(x,  2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define SHA256_F2(x) (ROTR(x,  6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SHA256_F3(x) (ROTR(x,  7) ^ ROTR(x, 18) ^ SHFR(x,  3))
+#define SHA256_F4(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ SHFR(x, 10))
+
+#define SHA256_SIMD_EXP(a, b, c, d, e, f, g, h, j)			\
+	{								\
+		t1 = h + SHA256_F2(e) + CH(e, f, g) + wk[j][i];		\
+		t2 = SHA256_F1(a) + MAJ(a, b, c);			\
+		d += t1;						\
+		h = t1 + t2;						\
+	}
+
+/*
+ * Inlined into each of the target-specific functions below, so the compiler
+ * generates the vector code for that instruction set.
+ */
+static inline __attribute__((always_inline))
+void sha256_simd_transform(uint32_t *h, const uint8_t *message,
+			   unsigned int block_nb)
+{
+	/* 64 * 32 = 2048 bytes of stack for W + K of eight blocks */
+	vb2_u32x8 wk[64];
+	vb2_u32x8 w[16];
+	uint32_t a, b, c, d, e, f, g, hh;
+	uint32_t t1, t2;
+	unsigned int lanes;
+	int i, j;
+
+	while (block_nb) {
+		lanes = VB2_MIN(block_nb, SHA256_SIMD_LANES);
+
+		for (j = 0; j < 16; j++) {
+			for (i = 0; i < SHA256_SIMD_LANES; i++) {
+				uint32_t x = 0;
+				if (i < lanes)
+					PACK32(&message[(i << 6) + (j << 2)],
+					       &x);
+				w[j][i] = x;
+			}
+			wk[j] = w[j] + vb2_sha256_k[j];
+		}
+
+		/* w[] is used as a ring of the last 16 schedule words */
+		for (j = 16; j < 64; j++) {
+			w[j & 15] += SHA256_F4(w[(j - 2) & 15]) +
+				w[(j - 7) & 15] + SHA256_F3(w[(j - 15) & 15]);
+			wk[j] = w[j & 15] + vb2_sha256_k[j];
+		}
+
+		for (i = 0; i < lanes; i++) {
+			a = h[0]; b = h[1]; c = h[2]; d = h[3];
+			e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+			for (j = 0; j < 64; j += 8) {
+				SHA256_SIMD_EXP(a, b, c, d, e, f, g, hh, j);
+				SHA256_SIMD_EXP(hh, a, b, c, d, e, f, g, j + 1);
+				SHA256_SIMD_EXP(g, hh, a, b, c, d, e, f, j + 2);
+				SHA256_SIMD_EXP(f, g, hh, a, b, c, d, e, j + 3);
+				SHA256_SIMD_EXP(e, f, g, hh, a, b, c, d, j + 4);
+				SHA256_SIMD_EXP(d, e, f, g, hh, a, b, c, j + 5);
+				SHA256_SIMD_EXP(c, d, e, f, g, hh, a, b, j + 6);
+				SHA256_SIMD_EXP(b, c, d, e, f, g, hh, a, j + 7);
+			}
+
+			h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+			h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		}
+
+		message += lanes * VB2_SHA256_BLOCK_SIZE;
+		block_nb -= lanes;
+	}
+}
+
+__attribute__((target("avx2,bmi2")))
+void vb2_sha256_transform_avx2(uint32_t *h, const uint8_t *message,
+			       unsigned int block_nb)
+{
+	sha256_simd_transform(h, message, block_nb);
+}
+
+__attribute__((target("ssse3")))
+void vb2_sha256_transform_ssse3(uint32_t *h, const uint8_t *message,
+				unsigned int block_nb)
+{
+	sha256_simd_transform(h, message, block_nb);
+}
@@ -37,6 +37,7 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
 
 #define SHFR(x, n)    (x >> n)
@@ -50,38 +51,6 @@
 #define SHA512_F3(x) (ROTR(x,  1) ^ ROTR(x,  8) ^ SHFR(x,  7))
 #define SHA512_F4(x) (ROTR(x, 19) ^ ROTR(x, 61) ^ SHFR(x,  6))
 
-#define UNPACK32(x, str)				\
-	{						\
-		*((str) + 3) = (uint8_t) ((x)      );	\
-		*((str) + 2) = (uint8_t) ((x) >>  8);	\
-		*((str) + 1) = (uint8_t) ((x) >> 16);	\
-		*((str) + 0) = (uint8_t) ((x) >> 24);	\
-	}
-
-#define UNPACK64(x, str)					\
-	{							\
-		*((str) + 7) = (uint8_t) x;			\
-		*((str) + 6) = (uint8_t) ((uint64_t)x >> 8);	\
-		*((str) + 5) = (uint8_t) ((uint64_t)x >> 16);	\
-		*((str) + 4) = (uint8_t) ((uint64_t)x >> 24);	\
-		*((str) + 3) = (uint8_t) ((uint64_t)x >> 32);	\
-		*((str) + 2) = (uint8_t) ((uint64_t)x >> 40);	\
-		*((str) + 1) = (uint8_t) ((uint64_t)x >> 48);	\
-		*((str) + 0) = (uint8_t) ((uint64_t)x >> 56);	\
-	}
-
-#define PACK64(str, x)						\
-	{							\
-		*(x) =   ((uint64_t) *((str) + 7)      )	\
-			| ((uint64_t) *((str) + 6) <<  8)       \
-			| ((uint64_t) *((str) + 5) << 16)       \
-			| ((uint64_t) *((str) + 4) << 24)       \
-			| ((uint64_t) *((str) + 3) << 32)       \
-			| ((uint64_t) *((str) + 2) << 40)       \
-			| ((uint64_t) *((str) + 1) << 48)       \
-			| ((uint64_t) *((str) + 0) << 56);      \
-	}
-
 /* Macros used for loops unrolling */
 
 #define SHA512_SCR(i)						\
@@ -93,7 +62,7 @@
 #define SHA512_EXP(a, b, c, d, e, f, g ,h, j)				\
 	{								\
 		t1 = wv[h] + SHA512_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha512_k[j] + w[j];				\
+			+ vb2_sha512_k[j] + w[j];				\
 		t2 = SHA512_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -113,7 +82,7 @@ static const uint64_t sha384_h0[8] = {
 	0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
 };
 
-static const uint64_t sha512_k[80] = {
+const uint64_t vb2_sha512_k[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
 	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
 	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -190,6 +159,14 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 	const uint8_t *sub_block;
 	int i, j;
 
+#ifdef X86_SHA_DISPATCH
+	vb2_sha512_transform_fn fast = vb2_sha512_x86_transform();
+	if (fast) {
+		fast(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+
 	for (i = 0; i < (int) block_nb; i++) {
 		sub_block = message + (i << 7);
 
@@ -265,7 +242,7 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 
 		for (j = 0; j < 80; j++) {
 			t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha512_k[j] + w[j];
+				+ vb2_sha512_k[j] + w[j];
 			t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
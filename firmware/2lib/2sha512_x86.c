@@ -0,0 +1,94 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-512 block transform using AVX2 for the message schedule and BMI2
+ * (rorx) for the rounds.
+ *
+ * The message schedule of a block doesn't depend on the hash state, so the
+ * schedules of four consecutive blocks are expanded together, one block per
+ * 64-bit lane of a 256-bit vector. The rounds then run on the precomputed
+ * W + K values. Only call this after checking the CPU supports AVX2 and BMI2.
+ */
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define SHA512_AVX2_LANES 4
+
+typedef uint64_t vb2_u64x4 __attribute__((vector_size(32)));
+
+#define SHFR(x, n)    ((x) >> (n))
+#define ROTR(x, n)    (((x) >> (n)) | ((x) << (64 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SHA512_F1(x) (ROTR(x, 28) ^ ROTR(x, 34) ^ ROTR(x, 39))
+#define SHA512_F2(x) (ROTR(x, 14) ^ ROTR(x, 18) ^ ROTR(x, 41))
+#define SHA512_F3(x) (ROTR(x,  1) ^ ROTR(x,  8) ^ SHFR(x,  7))
+#define SHA512_F4(x) (ROTR(x, 19) ^ ROTR(x, 61) ^ SHFR(x,  6))
+
+#define SHA512_AVX2_EXP(a, b, c, d, e, f, g, h, j)			\
+	{								\
+		t1 = h + SHA512_F2(e) + CH(e, f, g) + wk[j][i];		\
+		t2 = SHA512_F1(a) + MAJ(a, b, c);			\
+		d += t1;						\
+		h = t1 + t2;						\
+	}
+
+void vb2_sha512_transform_avx2(uint64_t *h, const uint8_t *message,
+			       unsigned int block_nb)
+{
+	/* 80 * 32 = 2560 bytes of stack for W + K of four blocks */
+	vb2_u64x4 wk[80];
+	vb2_u64x4 w[16];
+	uint64_t a, b, c, d, e, f, g, hh;
+	uint64_t t1, t2;
+	unsigned int lanes;
+	int i, j;
+
+	while (block_nb) {
+		lanes = VB2_MIN(block_nb, SHA512_AVX2_LANES);
+
+		for (j = 0; j < 16; j++) {
+			for (i = 0; i < SHA512_AVX2_LANES; i++) {
+				uint64_t x = 0;
+				if (i < lanes)
+					PACK64(&message[(i << 7) + (j << 3)],
+					       &x);
+				w[j][i] = x;
+			}
+			wk[j] = w[j] + vb2_sha512_k[j];
+		}
+
+		/* w[] is used as a ring of the last 16 schedule words */
+		for (j = 16; j < 80; j++) {
+			w[j & 15] += SHA512_F4(w[(j - 2) & 15]) +
+				w[(j - 7) & 15] + SHA512_F3(w[(j - 15) & 15]);
+			wk[j] = w[j & 15] + vb2_sha512_k[j];
+		}
+
+		for (i = 0; i < lanes; i++) {
+			a = h[0]; b = h[1]; c = h[2]; d = h[3];
+			e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+			for (j = 0; j < 80; j += 8) {
+				SHA512_AVX2_EXP(a, b, c, d, e, f, g, hh, j);
+				SHA512_AVX2_EXP(hh, a, b, c, d, e, f, g, j + 1);
+				SHA512_AVX2_EXP(g, hh, a, b, c, d, e, f, j + 2);
+				SHA512_AVX2_EXP(f, g, hh, a, b, c, d, e, j + 3);
+				SHA512_AVX2_EXP(e, f, g, hh, a, b, c, d, j + 4);
+				SHA512_AVX2_EXP(d, e, f, g, hh, a, b, c, j + 5);
+				SHA512_AVX2_EXP(c, d, e, f, g, hh, a, b, j + 6);
+				SHA512_AVX2_EXP(b, c, d, e, f, g, hh, a, j + 7);
+			}
+
+			h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+			h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		}
+
+		message += lanes * VB2_SHA512_BLOCK_SIZE;
+		block_nb -= lanes;
+	}
+}
@@ -7,6 +7,7 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
 
 size_t vb2_digest_size(enum vb2_hash_algorithm hash_alg)
@@ -55,6 +56,16 @@ size_t vb2_hash_block_size(enum vb2_hash_algorithm alg)
 	}
 }
 
+const char *vb2_digest_impl_name(enum vb2_hash_algorithm hash_alg)
+{
+#ifdef X86_SHA_DISPATCH
+	const char *name = vb2_sha_x86_impl_name(hash_alg);
+	if (name)
+		return name;
+#endif
+	return "generic";
+}
+
 test_mockable
 vb2_error_t vb2_digest_init(struct vb2_digest_context *dc, bool allow_hwcrypto,
 			    enum vb2_hash_algorithm algo, uint32_t data_size)
@@ -0,0 +1,127 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Run-time selection of accelerated SHA block transforms for x86 host builds.
+ * This file must be built without any -m flags beyond the baseline ISA, since
+ * it runs before we know what the CPU supports.
+ */
+
+#include <cpuid.h>
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+/* CPUID.1:ECX */
+#define CPUID1_ECX_SSSE3	(1 << 9)
+#define CPUID1_ECX_OSXSAVE	(1 << 27)
+#define CPUID1_ECX_AVX		(1 << 28)
+/* CPUID.(7,0):EBX */
+#define CPUID7_EBX_AVX2		(1 << 5)
+#define CPUID7_EBX_BMI2		(1 << 8)
+#define CPUID7_EBX_SHA		(1 << 29)
+/* XCR0: SSE and AVX register state enabled by the OS */
+#define XCR0_SSE_AVX		0x6
+
+struct sha_x86_impl {
+	bool probed;
+	const char *sha256_name;
+	vb2_sha256_transform_fn sha256;
+	const char *sha512_name;
+	vb2_sha512_transform_fn sha512;
+};
+
+static struct sha_x86_impl impl;
+
+/*
+ * sha256rnds2 keeps the state as F, E, B, A, H, G, D, C, so shuffle the
+ * portable state around the SHA extension transform.
+ */
+static void sha256_transform_shani(uint32_t *h, const uint8_t *message,
+				   unsigned int block_nb)
+{
+	uint32_t state[8] = {
+		h[5], h[4], h[1], h[0], h[7], h[6], h[3], h[2],
+	};
+
+	vb2_sha256_transform_x86ext(state, message, block_nb);
+
+	h[0] = state[3]; h[1] = state[2]; h[2] = state[7]; h[3] = state[6];
+	h[4] = state[1]; h[5] = state[0]; h[6] = state[5]; h[7] = state[4];
+}
+
+static void probe_cpu(void)
+{
+	unsigned int a, b, c, d;
+	unsigned int ecx1, ebx7 = 0;
+	unsigned int xcr0_lo, xcr0_hi;
+	bool avx = false;
+
+	impl.probed = true;
+
+	if (!__get_cpuid(1, &a, &b, &ecx1, &d))
+		return;
+
+	if ((ecx1 & CPUID1_ECX_OSXSAVE) && (ecx1 & CPUID1_ECX_AVX)) {
+		asm volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+		avx = (xcr0_lo & XCR0_SSE_AVX) == XCR0_SSE_AVX;
+	}
+
+	if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		ebx7 = b;
+
+	if ((ebx7 & CPUID7_EBX_SHA) && (ecx1 & CPUID1_ECX_SSSE3)) {
+		impl.sha256_name = "sha-ni";
+		impl.sha256 = sha256_transform_shani;
+	} else if (avx && (ebx7 & CPUID7_EBX_AVX2) &&
+		   (ebx7 & CPUID7_EBX_BMI2)) {
+		impl.sha256_name = "avx2";
+		impl.sha256 = vb2_sha256_transform_avx2;
+	} else if (ecx1 & CPUID1_ECX_SSSE3) {
+		impl.sha256_name = "ssse3";
+		impl.sha256 = vb2_sha256_transform_ssse3;
+	}
+
+	if (avx && (ebx7 & CPUID7_EBX_AVX2) && (ebx7 & CPUID7_EBX_BMI2)) {
+		impl.sha512_name = "avx2";
+		impl.sha512 = vb2_sha512_transform_avx2;
+	}
+
+	VB2_DEBUG("SHA-256 %s, SHA-512 %s\n",
+		  impl.sha256_name ? impl.sha256_name : "generic",
+		  impl.sha512_name ? impl.sha512_name : "generic");
+}
+
+vb2_sha256_transform_fn vb2_sha256_x86_transform(void)
+{
+	if (!impl.probed)
+		probe_cpu();
+
+	return impl.sha256;
+}
+
+vb2_sha512_transform_fn vb2_sha512_x86_transform(void)
+{
+	if (!impl.probed)
+		probe_cpu();
+
+	return impl.sha512;
+}
+
+const char *vb2_sha_x86_impl_name(enum vb2_hash_algorithm hash_alg)
+{
+	if (!impl.probed)
+		probe_cpu();
+
+	switch (hash_alg) {
+	case VB2_HASH_SHA224:
+	case VB2_HASH_SHA256:
+		return impl.sha256_name;
+	case VB2_HASH_SHA384:
+	case VB2_HASH_SHA512:
+		return impl.sha512_name;
+	default:
+		return NULL;
+	}
+}
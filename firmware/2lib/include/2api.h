@@ -534,6 +534,12 @@ struct vb2_kernel_params {
 	void *kernel_buffer;
 	/* Size of kernel buffer in bytes. */
 	uint32_t kernel_buffer_size;
+	/*
+	 * Bytes of kernel body to read from the stream at a time; each chunk
+	 * is hashed before the next is read. Should be a multiple of the disk
+	 * sector size. 0 uses the default of 256 KB.
+	 */
+	uint32_t body_chunk_size;
 
 	/*
 	 * Outputs from vb2api_load_kernel(); valid only if it returns success.
@@ -584,6 +590,14 @@ struct vb2_kernel_params {
  */
 #define VB2_DISK_FLAG_EXTERNAL_GPT (1 << 16)
 
+/*
+ * Once a good kernel has been found, read the vblocks of the remaining
+ * candidate partitions together in LBA order for the rollback check, instead
+ * of interleaving each read with verification.  This helps disks where each
+ * seek or command has a high fixed cost, such as slow eMMC or USB sticks.
+ */
+#define VB2_DISK_FLAG_BATCH_VBLOCKS (1 << 17)
+
 /* Information on a single disk. */
 struct vb2_disk_info {
 	/* Disk handle. */
@@ -18,4 +18,37 @@ int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a);
 vb2_error_t vb2_check_padding(const uint8_t *sig,
 			      const struct vb2_public_key *key);
 
+/*
+ * In-place public exponentiation on 32-bit limbs.  Works for any key, and is
+ * the reference for the other implementations, which must give bit-identical
+ * results.  workbuf32 must be (3 * key->arrsize) elements long.
+ */
+void vb2_modpow32(const struct vb2_public_key *key, uint8_t *inout,
+		  uint32_t *workbuf32, int exp);
+
+/* Compilers with 128-bit integers get a 64-bit limb implementation. */
+#ifdef __SIZEOF_INT128__
+#define VB2_RSA_LIMB64
+
+/* Montgomery constant -1 / n mod 2^64, for 64-bit limb implementations */
+uint64_t vb2_mont_n0inv64(const struct vb2_public_key *key);
+
+/*
+ * The same on 64-bit limbs, for keys with an even key->arrsize.  workbuf32
+ * must be (3 * key->arrsize) elements long and 8-byte aligned.
+ */
+void vb2_modpow64(const struct vb2_public_key *key, uint8_t *inout,
+		  uint32_t *workbuf32, int exp);
+#endif
+
+#ifdef X86_RSA_DISPATCH
+/*
+ * AVX-512 IFMA implementation for x86 host builds.  Only call
+ * vb2_modpow_ifma() if vb2_modpow_ifma_supported() returns true for the key.
+ */
+bool vb2_modpow_ifma_supported(const struct vb2_public_key *key);
+void vb2_modpow_ifma(const struct vb2_public_key *key, uint8_t *inout,
+		     int exp);
+#endif
+
 #endif  /* VBOOT_REFERENCE_2RSA_PRIVATE_H_ */
@@ -205,6 +205,18 @@ size_t vb2_digest_size(enum vb2_hash_algorithm hash_alg);
  */
 size_t vb2_hash_block_size(enum vb2_hash_algorithm alg);
 
+/**
+ * Return the name of the software implementation used for a hash algorithm.
+ *
+ * Host builds for x86-64 pick the fastest implementation the running CPU
+ * supports when the first digest is started; other builds always use the
+ * portable one.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return A short name such as "sha-ni", "avx2", "ssse3" or "generic".
+ */
+const char *vb2_digest_impl_name(enum vb2_hash_algorithm hash_alg);
+
 /**
  * Initialize a digest context for doing block-style digesting, potentially
  * making use of the vb2ex_hwcrypto APIs. Whether HW crypto is allowed by policy
@@ -19,6 +19,57 @@
 
 extern const uint32_t vb2_sha256_h0[8];
 extern const uint32_t vb2_sha256_k[64];
+extern const uint64_t vb2_sha512_k[80];
+
+/**
+ * SHA-256 block transform using the x86 SHA extension.
+ *
+ * The state is kept in the order used by sha256rnds2: F, E, B, A, H, G, D, C.
+ * Only call this after checking the CPU supports SHA and SSSE3.
+ */
+void vb2_sha256_transform_x86ext(uint32_t *state, const uint8_t *message,
+				 unsigned int block_nb);
+
+#ifdef X86_SHA_DISPATCH
+/* SHA block transforms working directly on the hash state */
+typedef void (*vb2_sha256_transform_fn)(uint32_t *h, const uint8_t *message,
+					unsigned int block_nb);
+typedef void (*vb2_sha512_transform_fn)(uint64_t *h, const uint8_t *message,
+					unsigned int block_nb);
+
+/**
+ * Pick the fastest SHA-256 block transform supported by the running CPU.
+ *
+ * The CPU is only probed on the first call.
+ *
+ * @return The accelerated transform, or NULL to use the portable one.
+ */
+vb2_sha256_transform_fn vb2_sha256_x86_transform(void);
+
+/**
+ * Pick the fastest SHA-512 block transform supported by the running CPU.
+ *
+ * The CPU is only probed on the first call.
+ *
+ * @return The accelerated transform, or NULL to use the portable one.
+ */
+vb2_sha512_transform_fn vb2_sha512_x86_transform(void);
+
+/**
+ * Name the implementation picked for a hash algorithm.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return The name, or NULL if the portable implementation is used.
+ */
+const char *vb2_sha_x86_impl_name(enum vb2_hash_algorithm hash_alg);
+
+void vb2_sha256_transform_avx2(uint32_t *h, const uint8_t *message,
+			       unsigned int block_nb);
+void vb2_sha256_transform_ssse3(uint32_t *h, const uint8_t *message,
+				unsigned int block_nb);
+void vb2_sha512_transform_avx2(uint64_t *h, const uint8_t *message,
+			       unsigned int block_nb);
+#endif
 
 #define UNPACK32(x, str)				\
 	{						\
@@ -35,4 +86,29 @@ extern const uint32_t vb2_sha256_k[64];
 			| ((uint32_t) *((str) + 1) << 16)       \
 			| ((uint32_t) *((str) + 0) << 24);      \
 	}
+
+#define UNPACK64(x, str)					\
+	{							\
+		*((str) + 7) = (uint8_t) x;			\
+		*((str) + 6) = (uint8_t) ((uint64_t)x >> 8);	\
+		*((str) + 5) = (uint8_t) ((uint64_t)x >> 16);	\
+		*((str) + 4) = (uint8_t) ((uint64_t)x >> 24);	\
+		*((str) + 3) = (uint8_t) ((uint64_t)x >> 32);	\
+		*((str) + 2) = (uint8_t) ((uint64_t)x >> 40);	\
+		*((str) + 1) = (uint8_t) ((uint64_t)x >> 48);	\
+		*((str) + 0) = (uint8_t) ((uint64_t)x >> 56);	\
+	}
+
+#define PACK64(str, x)						\
+	{							\
+		*(x) =   ((uint64_t) *((str) + 7)      )	\
+			| ((uint64_t) *((str) + 6) <<  8)       \
+			| ((uint64_t) *((str) + 5) << 16)       \
+			| ((uint64_t) *((str) + 4) << 24)       \
+			| ((uint64_t) *((str) + 3) << 32)       \
+			| ((uint64_t) *((str) + 2) << 40)       \
+			| ((uint64_t) *((str) + 1) << 48)       \
+			| ((uint64_t) *((str) + 0) << 56);      \
+	}
+
 #endif  /* VBOOT_REFERENCE_2SHA_PRIVATE_H_ */
@@ -318,6 +318,32 @@ uint32_t TlclReadDelegationFamilyTable(TPM_FAMILY_TABLE_ENTRY *table,
 #endif  /* TPM2_MODE */
 #endif  /* CHROMEOS_ENVIRONMENT */
 
+/*****************************************************************************/
+/* Functions implemented in tlcl_cache.c */
+
+/* Counters of the commands sent since the library was loaded. */
+struct tlcl_stats {
+	uint32_t round_trips;  /* Commands sent to the TPM */
+	uint32_t cache_hits;  /* Commands answered from the response cache */
+	uint32_t time_ms;  /* Time spent waiting for the TPM */
+};
+
+/**
+ * Enable or disable caching of responses which can't change until the next
+ * command modifying TPM state, such as flags and NV space info.  Only enable
+ * this when nothing else talks to the TPM.  Disabled by default.
+ *
+ * This is meant for firmware which owns the TPM, to call after TlclLibInit().
+ * Nothing in this repository enables it: the host tools, such as tpmc, share
+ * the TPM with other processes.
+ */
+void TlclEnableResponseCache(int enable);
+
+/**
+ * Get the counters of commands sent so far.
+ */
+void TlclGetStats(struct tlcl_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
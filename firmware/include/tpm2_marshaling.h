@@ -31,6 +31,18 @@ extern "C" {
 int tpm_marshal_command(TPM_CC command, void *tpm_command_body,
 			void *buffer, int buffer_size);
 
+/**
+ * tpm_marshal_command_fields
+ *
+ * Same as tpm_marshal_command(), but always serializes the command field by
+ * field instead of copying the template kept for frequent commands.  Included
+ * here for tests.
+ *
+ * Returns number of bytes placed in the buffer, or -1 on error.
+ */
+int tpm_marshal_command_fields(TPM_CC command, void *tpm_command_body,
+			       void *buffer, int buffer_size);
+
 /**
  * tpm_unmarshal_response
  *
@@ -8,6 +8,45 @@
 
 #include "2sysincludes.h"
 
+/**
+ * Calculate the CRC32 of a buffer, using the fastest implementation available.
+ */
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Calculate the CRC32 of a buffer one byte at a time. This is the reference
+ * the faster implementations are tested against.
+ */
+uint32_t Crc32Bytewise(const void *buffer, uint32_t len);
+
+/**
+ * Calculate the CRC32 of a buffer eight bytes at a time (slice-by-8).
+ */
+uint32_t Crc32Slice8(const void *buffer, uint32_t len);
+
+#ifdef X86_CRC32_DISPATCH
+/* Shortest buffer worth folding, and the granularity of the fold. */
+#define CRC32_FOLD_MIN_LEN 64
+#define CRC32_FOLD_ALIGN 16
+
+/**
+ * Check whether the CPU supports carry-less multiply. The CPU is only probed
+ * on the first call.
+ *
+ * @return 1 if Crc32PclmulFold() may be called, 0 if not.
+ */
+int Crc32PclmulSupported(void);
+
+/**
+ * Fold a buffer into a CRC32 register using PCLMULQDQ.
+ *
+ * @param crc		Current CRC register (not inverted)
+ * @param buf		Data to add
+ * @param len		Length of data; a multiple of CRC32_FOLD_ALIGN and at
+ *			least CRC32_FOLD_MIN_LEN
+ * @return The updated CRC register.
+ */
+uint32_t Crc32PclmulFold(uint32_t crc, const uint8_t *buf, uint32_t len);
+#endif
+
 #endif  /* VBOOT_REFERENCE_CRC32_H_ */
@@ -714,8 +714,117 @@ static void marshal_pcr_extend(void **buffer,
 	marshal_TPML_DIGEST_VALUES(buffer, &command_body->digests, buffer_space);
 }
 
+/*
+ * The fixed-shape commands sent on every boot are copied from templates built
+ * at compile time, and only their variable fields are patched in.  The
+ * templates produce the same bytes as the marshal_*() functions above.
+ */
+#define BE16(x) (uint8_t)((x) >> 8), (uint8_t)(x)
+#define BE32(x) (uint8_t)((x) >> 24), (uint8_t)((x) >> 16), \
+		(uint8_t)((x) >> 8), (uint8_t)(x)
+
+/* Password session with empty nonce and auth, and its 32-bit size. */
+#define PASSWORD_SESSION BE32(9), BE32(TPM_RS_PW), BE16(0), 0, BE16(0)
+
+static const uint8_t nv_read_template[] = {
+	BE16(TPM_ST_SESSIONS), BE32(35), BE32(TPM2_NV_Read),
+	BE32(TPM_RH_PLATFORM),	/* Auth handle */
+	BE32(0),		/* NV index */
+	PASSWORD_SESSION,
+	BE16(0),		/* Size */
+	BE16(0),		/* Offset */
+};
+
+static const uint8_t get_capability_template[] = {
+	BE16(TPM_ST_NO_SESSIONS), BE32(22), BE32(TPM2_GetCapability),
+	BE32(0),		/* Capability */
+	BE32(0),		/* Property */
+	BE32(0),		/* Property count */
+};
+
+static const uint8_t pcr_extend_template[] = {
+	BE16(TPM_ST_SESSIONS), BE32(65), BE32(TPM2_PCR_Extend),
+	BE32(0),		/* PCR handle */
+	PASSWORD_SESSION,
+	BE32(1),		/* Digest count */
+	BE16(TPM_ALG_SHA256),
+	/* SHA256 digest follows */
+};
+
+/*
+ * Copies the template for the command and patches in its fields. Returns the
+ * size of the command, -1 if it doesn't fit in the buffer, or 0 if the command
+ * has no template and needs to be marshaled field by field.
+ */
+static int marshal_from_template(TPM_CC command, void *tpm_command_body,
+				 uint8_t *buffer, int buffer_size)
+{
+	struct tpm2_nv_read_cmd *nv_read;
+	struct tpm2_get_capability_cmd *get_capability;
+	struct tpm2_pcr_extend_cmd *pcr_extend;
+	int size;
+
+	switch (command) {
+	case TPM2_NV_Read:
+		size = sizeof(nv_read_template);
+		if (buffer_size < size)
+			return -1;
+		nv_read = tpm_command_body;
+		memcpy(buffer, nv_read_template, size);
+		/* Use empty password auth if platform hierarchy is disabled */
+		if (ph_disabled)
+			write_be32(buffer + 10, nv_read->nvIndex);
+		write_be32(buffer + 14, nv_read->nvIndex);
+		write_be16(buffer + 31, nv_read->size);
+		write_be16(buffer + 33, nv_read->offset);
+		return size;
+
+	case TPM2_GetCapability:
+		size = sizeof(get_capability_template);
+		if (buffer_size < size)
+			return -1;
+		get_capability = tpm_command_body;
+		memcpy(buffer, get_capability_template, size);
+		write_be32(buffer + 10, get_capability->capability);
+		write_be32(buffer + 14, get_capability->property);
+		write_be32(buffer + 18, get_capability->property_count);
+		return size;
+
+	case TPM2_PCR_Extend:
+		pcr_extend = tpm_command_body;
+		if (pcr_extend->digests.count != 1 ||
+		    pcr_extend->digests.digests[0].hashAlg != TPM_ALG_SHA256)
+			return 0;
+		size = sizeof(pcr_extend_template) + SHA256_DIGEST_SIZE;
+		if (buffer_size < size)
+			return -1;
+		memcpy(buffer, pcr_extend_template,
+		       sizeof(pcr_extend_template));
+		write_be32(buffer + 10, pcr_extend->pcrHandle);
+		memcpy(buffer + sizeof(pcr_extend_template),
+		       pcr_extend->digests.digests[0].digest.sha256,
+		       SHA256_DIGEST_SIZE);
+		return size;
+
+	default:
+		return 0;
+	}
+}
+
 int tpm_marshal_command(TPM_CC command, void *tpm_command_body,
 			void *buffer, int buffer_size)
+{
+	int size = marshal_from_template(command, tpm_command_body,
+					 buffer, buffer_size);
+
+	if (size)
+		return size;
+	return tpm_marshal_command_fields(command, tpm_command_body,
+					  buffer, buffer_size);
+}
+
+int tpm_marshal_command_fields(TPM_CC command, void *tpm_command_body,
+			       void *buffer, int buffer_size)
 {
 	void *cmd_body = (uint8_t *)buffer + sizeof(struct tpm_header);
 	int max_body_size = buffer_size - sizeof(struct tpm_header);
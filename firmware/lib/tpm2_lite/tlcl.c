@@ -9,6 +9,7 @@
 #include "2common.h"
 #include "2sysincludes.h"
 #include "tlcl.h"
+#include "tlcl_internal.h"
 #include "tpm2_marshaling.h"
 
 /*
@@ -23,6 +24,21 @@
 /* Global buffer for deserialized responses. */
 struct tpm2_response tpm2_resp;
 
+/* Gets how a TPM command interacts with the response cache. */
+static enum tlcl_cache_policy cache_policy(TPM_CC command)
+{
+	switch (command) {
+	case TPM2_GetCapability:
+	case TPM2_NV_ReadPublic:
+		return TLCL_CACHE_USE;
+	case TPM2_NV_Read:
+	case TPM2_GetRandom:
+		return TLCL_CACHE_NONE;
+	default:
+		return TLCL_CACHE_INVALIDATE;
+	}
+}
+
 /*
  * Serializes and sends the command, gets back the response and
  * parses it into the provided buffer.
@@ -55,7 +71,8 @@ static uint32_t tpm_get_response(TPM_CC command,
 	}
 
 	in_size = sizeof(cr_buffer);
-	res = vb2ex_tpm_send_recv(cr_buffer, out_size, cr_buffer, &in_size);
+	res = tlcl_transmit(cr_buffer, cr_buffer, &in_size,
+			    cache_policy(command));
 	if (res != TPM_SUCCESS) {
 		VB2_DEBUG("tpm transaction failed for %#x with error %#x\n",
 			  command, res);
@@ -130,6 +147,7 @@ uint32_t TlclLibInit(void)
 
 uint32_t TlclLibClose(void)
 {
+	tlcl_cache_invalidate();
 	return vb2ex_tpm_close();
 }
 
@@ -139,8 +157,9 @@ uint32_t TlclSendReceive(const uint8_t *request, uint8_t *response,
 	uint32_t rv, resp_size;
 
 	resp_size = max_length;
-	rv = vb2ex_tpm_send_recv(request, tpm_get_packet_size(request),
-				 response, &resp_size);
+	/* The command code sits where responses have their response code. */
+	rv = tlcl_transmit(request, response, &resp_size,
+			   cache_policy(tpm_get_packet_response_code(request)));
 
 	return rv ? rv : tpm_get_packet_response_code(response);
 }
@@ -84,4 +84,34 @@ static inline uint16_t ReadTpmUint16(const uint8_t **buffer) {
 	return value;
 }
 
+/* Size of the response cache; larger requests or responses aren't cached. */
+#define TLCL_CACHE_ENTRIES 4
+#define TLCL_CACHE_MAX_REQUEST 32
+#define TLCL_CACHE_MAX_RESPONSE 128
+
+/* How a command interacts with the response cache. */
+enum tlcl_cache_policy {
+	/* Reads state, but only state the cache doesn't hold */
+	TLCL_CACHE_NONE,
+	/* Response may be answered from and stored in the cache */
+	TLCL_CACHE_USE,
+	/* May modify TPM state, so drops everything cached */
+	TLCL_CACHE_INVALIDATE,
+};
+
+/*
+ * Send a request to the TPM and get its response, going through the response
+ * cache according to the policy of the command.  Same parameters and return
+ * value as vb2ex_tpm_send_recv(), except the request length is taken from its
+ * header.
+ */
+uint32_t tlcl_transmit(const uint8_t *request, uint8_t *response,
+		       uint32_t *response_length,
+		       enum tlcl_cache_policy policy);
+
+/*
+ * Drop all responses from the cache.
+ */
+void tlcl_cache_invalidate(void);
+
 #endif  /* VBOOT_REFERENCE_TLCL_INTERNAL_H_ */
@@ -57,6 +57,26 @@ static inline int TpmReturnCode(const uint8_t* buffer)
 	return TpmCommandCode(buffer);
 }
 
+/* Gets how a TPM command interacts with the response cache. */
+static enum tlcl_cache_policy CachePolicy(const uint8_t* request)
+{
+	uint32_t length;
+
+	switch (TpmCommandCode(request)) {
+	case TPM_ORD_GetCapability:
+		return TLCL_CACHE_USE;
+	case TPM_ORD_NV_ReadValue:
+		/* A zero-length read sets the read lock of the space. */
+		FromTpmUint32(request + tpm_nv_read_cmd.length, &length);
+		return length ? TLCL_CACHE_NONE : TLCL_CACHE_INVALIDATE;
+	case TPM_ORD_PcrRead:
+	case TPM_ORD_GetRandom:
+		return TLCL_CACHE_NONE;
+	default:
+		return TLCL_CACHE_INVALIDATE;
+	}
+}
+
 /* Like TlclSendReceive below, but do not retry if NEEDS_SELFTEST or
  * DOING_SELFTEST errors are returned.
  */
@@ -74,8 +94,8 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 		  request[6], request[7], request[8], request[9]);
 #endif
 
-	result = vb2ex_tpm_send_recv(request, TpmCommandSize(request),
-				     response, &response_length);
+	result = tlcl_transmit(request, response, &response_length,
+			       CachePolicy(request));
 	if (TPM_SUCCESS != result) {
 		/* Communication with TPM failed, so response is garbage */
 		VB2_DEBUG("TPM: command %#x send/receive failed: %#x\n",
@@ -393,6 +413,7 @@ uint32_t TlclLibInit(void)
 
 uint32_t TlclLibClose(void)
 {
+	tlcl_cache_invalidate();
 	return vb2ex_tpm_close();
 }
 
@@ -0,0 +1,134 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * TPM transport shared by the TPM 1.2 and TPM 2.0 libraries: counts round
+ * trips to the TPM and optionally caches responses which can't change until
+ * the next command modifying TPM state.
+ */
+
+#include "2api.h"
+#include "2common.h"
+#include "2sysincludes.h"
+#include "tlcl.h"
+#include "tlcl_internal.h"
+
+/* Command and response header: tag (2), size (4), command/response code (4) */
+#define TPM_HEADER_SIZE 10
+
+struct cache_entry {
+	uint32_t request_size;  /* 0 if the entry is unused */
+	uint32_t response_size;
+	uint8_t request[TLCL_CACHE_MAX_REQUEST];
+	uint8_t response[TLCL_CACHE_MAX_RESPONSE];
+};
+
+static struct {
+	int enabled;
+	int next;  /* Entry to replace next */
+	struct cache_entry entries[TLCL_CACHE_ENTRIES];
+} cache;
+
+static struct tlcl_stats stats;
+
+static uint32_t packet_size(const uint8_t *packet)
+{
+	uint32_t size;
+
+	FromTpmUint32(packet + sizeof(uint16_t), &size);
+	return size;
+}
+
+static uint32_t packet_code(const uint8_t *packet)
+{
+	uint32_t code;
+
+	FromTpmUint32(packet + sizeof(uint16_t) + sizeof(uint32_t), &code);
+	return code;
+}
+
+static struct cache_entry *cache_find(const uint8_t *request,
+				      uint32_t request_size)
+{
+	int i;
+
+	for (i = 0; i < TLCL_CACHE_ENTRIES; i++) {
+		struct cache_entry *e = &cache.entries[i];
+
+		if (e->request_size == request_size &&
+		    !memcmp(e->request, request, request_size))
+			return e;
+	}
+	return NULL;
+}
+
+void tlcl_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < TLCL_CACHE_ENTRIES; i++)
+		cache.entries[i].request_size = 0;
+}
+
+uint32_t tlcl_transmit(const uint8_t *request, uint8_t *response,
+		       uint32_t *response_length,
+		       enum tlcl_cache_policy policy)
+{
+	uint8_t key[TLCL_CACHE_MAX_REQUEST];
+	uint32_t request_size = packet_size(request);
+	struct cache_entry *e = NULL;
+	uint32_t start_ms;
+	uint32_t rv;
+
+	if (policy == TLCL_CACHE_USE &&
+	    (!cache.enabled || request_size > sizeof(key)))
+		policy = TLCL_CACHE_NONE;
+
+	if (policy == TLCL_CACHE_USE) {
+		e = cache_find(request, request_size);
+		if (e && e->response_size <= *response_length) {
+			memcpy(response, e->response, e->response_size);
+			*response_length = e->response_size;
+			stats.cache_hits++;
+			return TPM_SUCCESS;
+		}
+		/* The request and response may share a buffer. */
+		memcpy(key, request, request_size);
+	} else if (policy == TLCL_CACHE_INVALIDATE) {
+		tlcl_cache_invalidate();
+	}
+
+	start_ms = vb2ex_mtime();
+	rv = vb2ex_tpm_send_recv(request, request_size, response,
+				 response_length);
+	stats.time_ms += vb2ex_mtime() - start_ms;
+	stats.round_trips++;
+
+	/* Only successful, complete responses are worth keeping. */
+	if (policy == TLCL_CACHE_USE && rv == TPM_SUCCESS &&
+	    *response_length >= TPM_HEADER_SIZE &&
+	    *response_length <= TLCL_CACHE_MAX_RESPONSE &&
+	    packet_code(response) == TPM_SUCCESS) {
+		if (!e) {
+			e = &cache.entries[cache.next];
+			cache.next = (cache.next + 1) % TLCL_CACHE_ENTRIES;
+		}
+		memcpy(e->request, key, request_size);
+		e->request_size = request_size;
+		memcpy(e->response, response, *response_length);
+		e->response_size = *response_length;
+	}
+
+	return rv;
+}
+
+void TlclEnableResponseCache(int enable)
+{
+	cache.enabled = enable;
+	tlcl_cache_invalidate();
+}
+
+void TlclGetStats(struct tlcl_stats *out)
+{
+	*out = stats;
+}
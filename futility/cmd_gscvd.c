@@ -4,6 +4,7 @@
  * found in the LICENSE file.
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -18,6 +19,7 @@
 #include "gsc_ro.h"
 #include "host_key21.h"
 #include "host_keyblock.h"
+#include "host_misc.h"
 #include "host_signature.h"
 
 /*
@@ -77,6 +79,7 @@ static const char usage[] =
 	"firmware image or allows to validate a previously prepared image\n"
 	"containing the RO verification space.\n\n"
 	"Usage: " MYNAME " gscvd PARAMS <AP FIRMWARE FILE> [<root key hash>]\n"
+	"       " MYNAME " gscvd <AP FIRMWARE FILE>... [<root key hash>]\n"
 	"\n\nCreation of RO Verification space:\n\n"
 	"Required PARAMS:\n"
 	"  -R|--ranges        STRING        Comma separated colon delimited\n"
@@ -92,6 +95,10 @@ static const char usage[] =
 	"                                     which the image is signed.\n"
 	"                                     Can be passed as a 4-letter\n"
 	"                                     string or a hexadecimal number.\n"
+	"                                     A comma separated list signs a\n"
+	"                                     copy of the image for each\n"
+	"                                     Board ID, saved as\n"
+	"                                     OUTFILE.<Board ID in hex>.\n"
 	"  -r|--root_pub_key  <file>        The main public key, in .vbpubk\n"
 	"                                     format, used to verify platform\n"
 	"                                     key\n"
@@ -103,12 +110,15 @@ static const char usage[] =
 	"                                     verification data\n"
 	"Optional PARAMS:\n"
 	"  [--outfile]        OUTFILE       Output firmware image containing\n"
-	"                                     RO verification information\n"
+	"                                     RO verification information,\n"
+	"                                     required with several Board IDs\n"
 	"\n\n"
 	"Validation of RO Verification space:\n\n"
 	"   The only required parameter is <AP FIRMWARE FILE>, if optional\n"
 	"   <root key hash> is given, it is compared to the hash\n"
-	"   of the root key found in <AP_FIRMWARE_FILE>.\n"
+	"   of the root key found in <AP_FIRMWARE_FILE>. Several AP firmware\n"
+	"   files can be validated at once. The last argument is taken as\n"
+	"   the root key hash if it is 64 hex digits.\n"
 	"\n\n"
 	"  -h|--help                        Print this message\n\n";
 
@@ -136,6 +146,15 @@ struct gscvd_ro_ranges {
 	struct gscvd_ro_range ranges[MAX_RANGES];
 };
 
+/* Max number of Board IDs to sign an AP firmware file for at once. */
+#define MAX_BOARD_IDS 64
+
+/* Container keeping track of the Board IDs to create GVDs for. */
+struct gscvd_board_ids {
+	size_t count;
+	uint32_t ids[MAX_BOARD_IDS];
+};
+
 /**
  * Load the AP firmware file into memory.
  *
@@ -350,6 +369,69 @@ static int parse_ranges(const char *input, struct gscvd_ro_ranges *output)
 	return rv;
 }
 
+/**
+ * Parse Board ID list supplied by the user.
+ *
+ * The input is a comma separated list of Board IDs, each either a 4-letter
+ * string or a hexadecimal number.
+ *
+ * @param input  user input, part of the command line
+ * @param output  pointer to the Board IDs container
+ *
+ * @return zero on success, -1 on failure
+ */
+static int parse_board_ids(const char *input, struct gscvd_board_ids *output)
+{
+	char *cursor;
+	char *delim;
+	char *str = strdup(input);
+	int rv = 0;
+
+	if (!str) {
+		ERROR("Failed to allocate memory for Board ID string copy!\n");
+		return -1;
+	}
+
+	cursor = str;
+	do {
+		char *e;
+		long long bid;
+
+		if (output->count >= ARRAY_SIZE(output->ids)) {
+			ERROR("Too many Board IDs!\n");
+			rv = -1;
+			break;
+		}
+
+		delim = strchr(cursor, ',');
+		if (delim)
+			*delim = '\0';
+
+		if (strlen(cursor) == 4) {
+			output->ids[output->count++] = cursor[0] << 24 |
+						       cursor[1] << 16 |
+						       cursor[2] << 8 |
+						       cursor[3];
+		} else {
+			errno = 0;
+			bid = strtoull(cursor, &e, 16);
+			if (errno || !*cursor || *e || (bid >= UINT32_MAX)) {
+				ERROR("Cannot parse Board ID '%s'\n", cursor);
+				rv = -1;
+				break;
+			}
+			output->ids[output->count++] = (uint32_t)bid;
+		}
+
+		cursor = delim + 1;
+		/* Iterate until there is no more commas. */
+	} while (delim);
+
+	free(str);
+
+	return rv;
+}
+
 /**
  * Add GBB to ranges.
  *
@@ -465,11 +547,14 @@ static int calculate_ranges_digest(const struct file_buf *ap_firmware_file,
  * Build GSC verification data.
  *
  * Calculate size of the structure including the signature and the root key,
- * allocate memory, fill up the structure, calculate AP RO ranges digest and
- * then the GVD signature.
+ * allocate memory, fill up the structure with the AP RO ranges digest and then
+ * calculate the GVD signature. The ranges digest does not depend on the Board
+ * ID, so it is calculated once by the caller for all the GVDs of an image.
  *
  * @param ap_firmware_file  pointer to the AP firmware file layout descriptor
  * @param ranges  pointer to the container of ranges to include in verification
+ * @param ranges_digest  SHA256 digest of the ranges, padded with zeros to the
+ *			 size of gsc_verification_data.ranges_digest
  * @param root_pubk  pointer to the root pubk container
  * @param privk   pointer to the private key to use for signing
  * @param board_id  Board ID value to use.
@@ -480,6 +565,7 @@ static int calculate_ranges_digest(const struct file_buf *ap_firmware_file,
 static
 struct gsc_verification_data *create_gvd(struct file_buf *ap_firmware_file,
 					 struct gscvd_ro_ranges *ranges,
+					 const uint8_t *ranges_digest,
 					 const struct vb2_packed_key *root_pubk,
 					 const struct vb2_private_key *privk,
 					 uint32_t board_id)
@@ -514,13 +600,7 @@ struct gsc_verification_data *create_gvd(struct file_buf *ap_firmware_file,
 	gvd->fmap_location = (uintptr_t)fmh - (uintptr_t)ap_firmware_file->data;
 
 	gvd->hash_alg = VB2_HASH_SHA256;
-
-	if (calculate_ranges_digest(ap_firmware_file, ranges, gvd->hash_alg,
-				    gvd->ranges_digest,
-				    sizeof(gvd->ranges_digest))) {
-		free(gvd);
-		return NULL;
-	}
+	memcpy(gvd->ranges_digest, ranges_digest, sizeof(gvd->ranges_digest));
 
 	/* Prepare signature header. */
 	vb2_init_signature(&gvd->sig_header,
@@ -605,6 +685,36 @@ static int fill_gvd_area(struct file_buf *ap_firmware_file,
 	return 0;
 }
 
+/**
+ * Save the AP firmware file signed for one of several Board IDs.
+ *
+ * @param ap_firmware_file  pointer to the AP firmware file layout descriptor
+ * @param outfile  base name of the output files
+ * @param board_id  Board ID the RO_GSCVD area was filled for
+ *
+ * @return zero on success, -1 on failure
+ */
+static int write_board_id_file(const struct file_buf *ap_firmware_file,
+			       const char *outfile, uint32_t board_id)
+{
+	char *path;
+	int rv = 0;
+
+	if (asprintf(&path, "%s.%08x", outfile, board_id) < 0) {
+		ERROR("Failed to allocate memory for file name\n");
+		return -1;
+	}
+
+	if (vb2_write_file(path, ap_firmware_file->data,
+			   ap_firmware_file->len) != VB2_SUCCESS) {
+		ERROR("Failed to write %s\n", path);
+		rv = -1;
+	}
+
+	free(path);
+	return rv;
+}
+
 /**
  * Initialize a work buffer structure.
  *
@@ -727,28 +837,6 @@ static int validate_privk(struct vb2_keyblock *kblock,
 	return rv;
 }
 
-/**
- * Copy ranges from AP firmware file into gscvd_ro_ranges container
- *
- * While copying the ranges verify that they do not overlap.
- *
- * @param ap_firmware_file  pointer to the AP firmware file layout descriptor
- * @param gvd  pointer to the GVD header followed by the ranges
- * @param ranges  pointer to the ranges container to copy ranges to
- *
- * @return 0 on successful copy nonzero on errors.
- */
-static int copy_ranges(const struct file_buf *ap_firmware_file,
-		       const struct gsc_verification_data *gvd,
-		       struct gscvd_ro_ranges *ranges)
-{
-	ranges->range_count = gvd->range_count;
-	memcpy(ranges->ranges, gvd->ranges,
-	       sizeof(ranges->ranges[0]) * ranges->range_count);
-
-	return verify_ranges(ranges, ap_firmware_file);
-}
-
 /**
  * Basic validation of GVD included in a AP firmware file.
  *
@@ -844,43 +932,80 @@ static int validate_gvd_signature(struct gsc_verification_data *gvd,
 	return rv;
 }
 
+/*
+ * Parts of the last successfully validated AP firmware file. Images signed with
+ * the same ranges and keys (e.g. for several Board IDs) only need their ranges
+ * hashed again, the range checks and signature verifications are reused.
+ */
+struct gscvd_validated {
+	void *fmap;
+	size_t fmap_size;
+	struct gsc_verification_data *gvd;
+	struct vb2_keyblock *keyblock;
+};
+
+static void free_gscvd_validated(struct gscvd_validated *validated)
+{
+	free(validated->fmap);
+	free(validated->gvd);
+	free(validated->keyblock);
+	memset(validated, 0, sizeof(*validated));
+}
+
+/**
+ * Check if a buffer is the same as one cached from the last validated file.
+ */
+static bool same_as_validated(const void *validated, size_t validated_size,
+			      const void *data, size_t size)
+{
+	return validated && (validated_size == size) &&
+	       !memcmp(validated, data, size);
+}
+
+/**
+ * Allocate a copy of a buffer, to be cached if validation succeeds.
+ */
+static void *copy_validated(const void *data, size_t size)
+{
+	void *copy = malloc(size);
+
+	if (!copy)
+		ERROR("Failed to allocate %zd bytes\n", size);
+	else
+		memcpy(copy, data, size);
+
+	return copy;
+}
+
 /*
  * Validate GVD of the passed in AP firmware file and possibly the root key hash
  *
- * The input parameters are the subset of the command line, the first argv
- * string is the AP firmware file name, the second string, if present, is the
- * hash of the root public key included in the RO_GSCVD area of the AP
- * firmware file.
+ * @param file_name  name of the AP firmware file
+ * @param root_key_digest  expected hash of the root public key, or NULL
+ * @param last  parts of the last validated file, updated on success
  *
  * @return zero on success, -1 on failure.
  */
-static int validate_gscvd(int argc, char *argv[])
+static int validate_ap_firmware(const char *file_name,
+				const struct vb2_hash *root_key_digest,
+				struct gscvd_validated *last)
 {
-	struct file_buf ap_firmware_file;
-	int rv;
+	struct file_buf ap_firmware_file = { .fd = -1 };
+	struct gscvd_validated this = {0};
 	struct gscvd_ro_ranges ranges;
 	struct gsc_verification_data *gvd;
-	const char *file_name;
+	struct vb2_keyblock *kblock;
+	const FmapHeader *fmh;
 	uint8_t digest[sizeof(gvd->ranges_digest)];
-	struct vb2_hash root_key_digest = { .algo = VB2_HASH_SHA256 };
-
-	/* Guaranteed to be available. */
-	file_name = argv[0];
-
-	if (argc > 1)
-		parse_digest_or_die(root_key_digest.sha256,
-				    sizeof(root_key_digest.sha256),
-				    argv[1]);
+	bool same_fmap, same_ranges, same_keys, same_gvd;
+	int rv;
 
 	do {
-		struct vb2_keyblock *kblock;
-
 		rv = -1; /* Speculative, will be cleared on success. */
 
 		if (load_ap_firmware(file_name, &ap_firmware_file, FILE_RO))
 			break;
 
-		/* Copy ranges from gscvd to local structure. */
 		gvd = (struct gsc_verification_data
 			       *)(ap_firmware_file.data +
 				  ap_firmware_file.ro_gscvd->area_offset);
@@ -888,7 +1013,58 @@ static int validate_gscvd(int argc, char *argv[])
 		if (validate_gvd(gvd, &ap_firmware_file))
 			break;
 
-		if (copy_ranges(&ap_firmware_file, gvd, &ranges))
+		/* Find the keyblock. */
+		kblock = (struct vb2_keyblock *)((uintptr_t)gvd + gvd->size);
+		if (gvd->size + sizeof(*kblock) >
+			    ap_firmware_file.ro_gscvd->area_size ||
+		    gvd->size + kblock->keyblock_size >
+			    ap_firmware_file.ro_gscvd->area_size) {
+			ERROR("Keyblock does not fit in RO_GSCVD\n");
+			break;
+		}
+
+		/*
+		 * Keep copies, verifying the signatures may change them in
+		 * place.
+		 */
+		fmh = fmap_find(ap_firmware_file.data, ap_firmware_file.len);
+		this.fmap_size = sizeof(*fmh) +
+				 fmh->fmap_nareas * sizeof(FmapAreaHeader);
+		this.fmap = copy_validated(fmh, this.fmap_size);
+		this.gvd = copy_validated(gvd, gvd->size);
+		this.keyblock = copy_validated(kblock, kblock->keyblock_size);
+		if (!this.fmap || !this.gvd || !this.keyblock)
+			break;
+
+		same_fmap = same_as_validated(last->fmap, last->fmap_size,
+					      fmh, this.fmap_size);
+		same_ranges = last->gvd &&
+			      same_as_validated(last->gvd->ranges,
+						last->gvd->range_count *
+						sizeof(gvd->ranges[0]),
+						gvd->ranges, gvd->range_count *
+						sizeof(gvd->ranges[0]));
+		same_keys = last->gvd &&
+			    same_as_validated(
+				    vb2_packed_key_data(&last->gvd->root_key_header),
+				    last->gvd->root_key_header.key_size,
+				    vb2_packed_key_data(&gvd->root_key_header),
+				    gvd->root_key_header.key_size) &&
+			    same_as_validated(last->keyblock,
+					      last->keyblock->keyblock_size,
+					      kblock, kblock->keyblock_size);
+		same_gvd = same_keys &&
+			   same_as_validated(last->gvd, last->gvd->size,
+					     gvd, gvd->size);
+
+		/* Copy ranges from gscvd to local structure. */
+		ranges.range_count = gvd->range_count;
+		memcpy(ranges.ranges, gvd->ranges,
+		       sizeof(ranges.ranges[0]) * ranges.range_count);
+
+		/* The same ranges in the same FMAP were checked already. */
+		if (!(same_fmap && same_ranges) &&
+		    verify_ranges(&ranges, &ap_firmware_file))
 			break;
 
 		if (calculate_ranges_digest(&ap_firmware_file, &ranges,
@@ -901,23 +1077,22 @@ static int validate_gscvd(int argc, char *argv[])
 			break;
 		}
 
-		/* Find the keyblock. */
-		kblock = (struct vb2_keyblock *)((uintptr_t)gvd + gvd->size);
-
-		if ((argc > 1) && (vb2_hash_verify(false,
+		if (root_key_digest && (vb2_hash_verify(false,
 				vb2_packed_key_data(&gvd->root_key_header),
 				gvd->root_key_header.key_size,
-				&root_key_digest) != VB2_SUCCESS)) {
+				root_key_digest) != VB2_SUCCESS)) {
 			ERROR("Sha256 mismatch\n");
 			break;
 		}
 
-		if (validate_pubk_signature(&gvd->root_key_header, kblock)) {
+		if (!same_keys &&
+		    validate_pubk_signature(&gvd->root_key_header, kblock)) {
 			ERROR("Keyblock not signed by root key\n");
 			break;
 		}
 
-		if (validate_gvd_signature(gvd, &kblock->data_key)) {
+		if (!same_gvd &&
+		    validate_gvd_signature(gvd, &kblock->data_key)) {
 			ERROR("GVD not signed by platform key\n");
 			break;
 		}
@@ -925,6 +1100,13 @@ static int validate_gscvd(int argc, char *argv[])
 		rv = 0;
 	} while (false);
 
+	if (!rv) {
+		free_gscvd_validated(last);
+		*last = this;
+	} else {
+		free_gscvd_validated(&this);
+	}
+
 	if (ap_firmware_file.fd != -1)
 		futil_unmap_and_close_file(ap_firmware_file.fd, FILE_RO,
 					   ap_firmware_file.data,
@@ -933,6 +1115,65 @@ static int validate_gscvd(int argc, char *argv[])
 	return rv;
 }
 
+/*
+ * Check if a command line argument is a root key hash, i.e. a SHA-256 digest in
+ * hex.
+ */
+static bool is_root_key_hash(const char *arg)
+{
+	struct vb2_hash hash;
+	size_t i;
+
+	if (strlen(arg) != 2 * sizeof(hash.sha256))
+		return false;
+
+	for (i = 0; arg[i]; i++)
+		if (!isxdigit((unsigned char)arg[i]))
+			return false;
+
+	return true;
+}
+
+/*
+ * Validate GVD of the passed in AP firmware files and possibly the root key
+ * hash
+ *
+ * The input parameters are the subset of the command line, the argv strings
+ * are the AP firmware file names, the last string, if it is 64 hex digits, is
+ * the hash of the root public key included in the RO_GSCVD area of the AP
+ * firmware files.
+ *
+ * @return zero on success, -1 on failure.
+ */
+static int validate_gscvd(int argc, char *argv[])
+{
+	struct vb2_hash root_key_digest = { .algo = VB2_HASH_SHA256 };
+	const struct vb2_hash *expected_root_key = NULL;
+	struct gscvd_validated last = {0};
+	int errorcount = 0;
+	int i;
+
+	if (argc > 1 && is_root_key_hash(argv[argc - 1])) {
+		argc--;
+		parse_digest_or_die(root_key_digest.sha256,
+				    sizeof(root_key_digest.sha256),
+				    argv[argc]);
+		expected_root_key = &root_key_digest;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (!validate_ap_firmware(argv[i], expected_root_key, &last))
+			continue;
+		if (argc > 1)
+			ERROR("Validation failed: %s\n", argv[i]);
+		errorcount++;
+	}
+
+	free_gscvd_validated(&last);
+
+	return errorcount ? -1 : 0;
+}
+
 /**
  * Calculate and report sha256 hash of the public key body.
  *
@@ -978,8 +1219,11 @@ static int do_gscvd(int argc, char *argv[])
 	struct vb2_keyblock *kblock = NULL;
 	struct vb2_private_key *plat_privk = NULL;
 	struct gsc_verification_data *gvd = NULL;
+	uint8_t ranges_digest[sizeof(gvd->ranges_digest)];
 	struct file_buf ap_firmware_file = { .fd = -1 };
-	uint32_t board_id = UINT32_MAX;
+	struct gscvd_board_ids board_ids = { .count = 0 };
+	int mode = FILE_RW;
+	size_t j;
 	int rv = 0;
 
 	ranges.range_count = 0;
@@ -1000,28 +1244,11 @@ static int do_gscvd(int argc, char *argv[])
 		case 'G':
 			do_gbb = true;
 			break;
-		case 'b': {
-			char *e;
-			long long bid;
-
-			if (strlen(optarg) == 4) {
-				board_id = optarg[0] << 24 |
-					   optarg[1] << 16 |
-					   optarg[2] << 8 |
-					   optarg[3];
-				break;
-			}
-
-			bid = strtoull(optarg, &e, 16);
-			if (*e || (bid >= UINT32_MAX)) {
-				ERROR("Cannot parse Board ID '%s'\n",
-				      optarg);
+		case 'b':
+			if (parse_board_ids(optarg, &board_ids))
+				/* Error message has been already printed. */
 				errorcount++;
-			} else {
-				board_id = (uint32_t)bid;
-			}
 			break;
-		}
 		case 'r':
 			root_pubk = vb2_read_packed_key(optarg);
 			if (!root_pubk) {
@@ -1092,11 +1319,16 @@ static int do_gscvd(int argc, char *argv[])
 		goto usage_out;
 	}
 
-	if (board_id == UINT32_MAX) {
+	if (!board_ids.count) {
 		ERROR("Missing --board_id argument\n");
 		goto usage_out;
 	}
 
+	if (board_ids.count > 1 && !outfile) {
+		ERROR("Missing --outfile argument for several Board IDs\n");
+		goto usage_out;
+	}
+
 	if (!ranges.range_count && !do_gbb) {
 		ERROR("Missing --ranges argument\n");
 		goto usage_out;
@@ -1104,7 +1336,11 @@ static int do_gscvd(int argc, char *argv[])
 
 	infile = argv[optind];
 
-	if (outfile) {
+	if (board_ids.count > 1) {
+		/* Every Board ID gets its own copy, written after signing. */
+		work_file = infile;
+		mode = FILE_RO;
+	} else if (outfile) {
 		futil_copy_file_or_die(infile, outfile);
 		work_file = outfile;
 	} else {
@@ -1120,7 +1356,7 @@ static int do_gscvd(int argc, char *argv[])
 		if (validate_privk(kblock, plat_privk))
 			break;
 
-		if (load_ap_firmware(work_file, &ap_firmware_file, FILE_RW))
+		if (load_ap_firmware(work_file, &ap_firmware_file, mode))
 			break;
 
 		if (do_gbb && add_gbb(&ranges, &ap_firmware_file))
@@ -1129,12 +1365,31 @@ static int do_gscvd(int argc, char *argv[])
 		if (verify_ranges(&ranges, &ap_firmware_file))
 			break;
 
-		gvd = create_gvd(&ap_firmware_file, &ranges,
-				 root_pubk, plat_privk, board_id);
-		if (!gvd)
+		/* The ranges are the same for all Board IDs, hash them once. */
+		if (calculate_ranges_digest(&ap_firmware_file, &ranges,
+					    VB2_HASH_SHA256, ranges_digest,
+					    sizeof(ranges_digest)))
 			break;
 
-		if (fill_gvd_area(&ap_firmware_file, gvd, kblock))
+		for (j = 0; j < board_ids.count; j++) {
+			gvd = create_gvd(&ap_firmware_file, &ranges,
+					 ranges_digest, root_pubk, plat_privk,
+					 board_ids.ids[j]);
+			if (!gvd)
+				break;
+
+			if (fill_gvd_area(&ap_firmware_file, gvd, kblock))
+				break;
+
+			if (board_ids.count > 1 &&
+			    write_board_id_file(&ap_firmware_file, outfile,
+						board_ids.ids[j]))
+				break;
+
+			free(gvd);
+			gvd = NULL;
+		}
+		if (j < board_ids.count)
 			break;
 
 		dump_pubk_hash(root_pubk);
@@ -1148,7 +1403,7 @@ static int do_gscvd(int argc, char *argv[])
 	vb2_private_key_free(plat_privk);
 
 	if (ap_firmware_file.fd != -1)
-		futil_unmap_and_close_file(ap_firmware_file.fd, FILE_RW,
+		futil_unmap_and_close_file(ap_firmware_file.fd, mode,
 					   ap_firmware_file.data,
 					   ap_firmware_file.len);
 
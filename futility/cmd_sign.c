@@ -15,6 +15,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "2common.h"
@@ -57,6 +58,133 @@ static int no_opt_if(int expr, const char *optname)
 	return 0;
 }
 
+/* Kinds of key file that the sign command reads */
+enum key_kind {
+	KEY_PRIVATE,		/* .vbprivk */
+	KEY_PEM,		/* PEM private key, with an algorithm */
+	KEY_KEYBLOCK,		/* .keyblock */
+	KEY_PACKED,		/* .vbpubk */
+	KEY_PRIKEY,		/* .vbprik2 */
+};
+
+/*
+ * Keys which have been read.  Each file is only read once, so --batch jobs
+ * that use the same keys don't read and parse them again.
+ */
+struct cached_key {
+	enum key_kind kind;
+	char *path;
+	uint32_t pem_algo;
+	void *key;
+	struct cached_key *next;
+};
+
+static struct cached_key *key_cache;
+
+/* Return a key from the cache, reading it if needed.  NULL if error. */
+static void *read_key(enum key_kind kind, const char *path, uint32_t pem_algo)
+{
+	struct cached_key *c;
+	void *key = NULL;
+
+	for (c = key_cache; c; c = c->next) {
+		if (c->kind == kind && !strcmp(c->path, path) &&
+		    (kind != KEY_PEM || c->pem_algo == pem_algo))
+			return c->key;
+	}
+
+	switch (kind) {
+	case KEY_PRIVATE:
+		key = vb2_read_private_key(path);
+		break;
+	case KEY_PEM:
+		key = vb2_read_private_key_pem(path, pem_algo);
+		break;
+	case KEY_KEYBLOCK:
+		key = vb2_read_keyblock(path);
+		break;
+	case KEY_PACKED:
+		key = vb2_read_packed_key(path);
+		break;
+	case KEY_PRIKEY:
+		if (vb21_private_key_read((struct vb2_private_key **)&key,
+					  path))
+			key = NULL;
+		break;
+	}
+	if (!key)
+		return NULL;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		FATAL("Failed to allocate key cache entry\n");
+	c->kind = kind;
+	c->path = strdup(path);
+	c->pem_algo = pem_algo;
+	c->key = key;
+	c->next = key_cache;
+	key_cache = c;
+
+	return key;
+}
+
+static void free_key_cache(void)
+{
+	struct cached_key *c;
+
+	while ((c = key_cache)) {
+		key_cache = c->next;
+		switch (c->kind) {
+		case KEY_PRIVATE:
+		case KEY_PEM:
+			vb2_free_private_key(c->key);
+			break;
+		case KEY_PRIKEY:
+			vb2_private_key_free(c->key);
+			break;
+		default:
+			free(c->key);
+			break;
+		}
+		free(c->path);
+		free(c);
+	}
+}
+
+/*
+ * Keyblocks waiting for a persistent external signer.  --batch jobs queue
+ * their requests here instead of waiting for each signature, so the signer
+ * always has work.
+ */
+struct pending_keyblock {
+	struct vb2_keyblock *block;
+	int id;
+	char *outfile;
+	int lineno;		/* Line of the --batch file */
+	struct pending_keyblock *next;
+};
+
+static bool pem_persistent;
+static bool defer_external_signing;
+static int batch_lineno;
+static struct pending_keyblock *pending_keyblocks;
+static struct pending_keyblock **pending_tail = &pending_keyblocks;
+
+/* Queue a keyblock which is waiting for signature request [id]. */
+static void defer_keyblock(struct vb2_keyblock *block, int id)
+{
+	struct pending_keyblock *p = calloc(1, sizeof(*p));
+
+	if (!p)
+		FATAL("Failed to allocate pending keyblock\n");
+	p->block = block;
+	p->id = id;
+	p->outfile = strdup(sign_option.outfile);
+	p->lineno = batch_lineno;
+	*pending_tail = p;
+	pending_tail = &p->next;
+}
+
 /* This wraps/signs a public key, producing a keyblock. */
 int ft_sign_pubkey(const char *name, void *data)
 {
@@ -76,7 +204,26 @@ int ft_sign_pubkey(const char *name, void *data)
 	}
 
 	if (sign_option.pem_signpriv) {
-		if (sign_option.pem_external) {
+		if (sign_option.pem_external && pem_persistent &&
+		    defer_external_signing) {
+			/* Write it out once the signature comes back. */
+			int id;
+
+			block = vb2_start_keyblock_external(
+				data_key,
+				sign_option.pem_signpriv,
+				sign_option.pem_algo,
+				sign_option.flags,
+				sign_option.pem_external,
+				&id);
+			if (block) {
+				defer_keyblock(block, id);
+				rv = 0;
+			} else {
+				fprintf(stderr, "Unable to create keyblock\n");
+			}
+			goto done;
+		} else if (sign_option.pem_external) {
 			/* External signing uses the PEM file directly. */
 			block = vb2_create_keyblock_external(
 				data_key,
@@ -85,8 +232,8 @@ int ft_sign_pubkey(const char *name, void *data)
 				sign_option.flags,
 				sign_option.pem_external);
 		} else {
-			sign_option.signprivate = vb2_read_private_key_pem(
-				sign_option.pem_signpriv,
+			sign_option.signprivate = read_key(
+				KEY_PEM, sign_option.pem_signpriv,
 				sign_option.pem_algo);
 			if (!sign_option.signprivate) {
 				fprintf(stderr,
@@ -104,6 +251,11 @@ int ft_sign_pubkey(const char *name, void *data)
 					    sign_option.flags);
 	}
 
+	if (!block) {
+		fprintf(stderr, "Unable to create keyblock\n");
+		goto done;
+	}
+
 	/* Write it out */
 	rv = WriteSomeParts(sign_option.outfile, block, block->keyblock_size,
 			    NULL, 0);
@@ -352,7 +504,7 @@ static int load_keyset(void)
 			     "vbprivk") <= 0)
 			FATAL("Failed to allocate string\n");
 		INFO("Loading private data key from default keyset: %s\n", buf);
-		sign_option.signprivate = vb2_read_private_key(buf);
+		sign_option.signprivate = read_key(KEY_PRIVATE, buf, 0);
 		if (!sign_option.signprivate) {
 			ERROR("Error reading %s\n", buf);
 			errorcnt++;
@@ -365,7 +517,7 @@ static int load_keyset(void)
 			     "keyblock") <= 0)
 			FATAL("Failed to allocate string\n");
 		INFO("Loading keyblock from default keyset: %s\n", buf);
-		sign_option.keyblock = vb2_read_keyblock(buf);
+		sign_option.keyblock = read_key(KEY_KEYBLOCK, buf, 0);
 		if (!sign_option.keyblock) {
 			ERROR("Error reading %s\n", buf);
 			errorcnt++;
@@ -378,7 +530,7 @@ static int load_keyset(void)
 			     "vbpubk") <= 0)
 			FATAL("Failed to allocate string\n");
 		INFO("Loading kernel subkey from default keyset: %s\n", buf);
-		sign_option.kernel_subkey = vb2_read_packed_key(buf);
+		sign_option.kernel_subkey = read_key(KEY_PACKED, buf, 0);
 		if (!sign_option.kernel_subkey) {
 			ERROR("Error reading %s\n", buf);
 			errorcnt++;
@@ -410,6 +562,9 @@ static const char usage_pubkey[] = "\n"
 	"  --pem_external   PROGRAM"
 	"         External program to compute the signature\n"
 	"                                     (requires a PEM signing key)\n"
+	"  --pem_persistent"
+	"                 Start the external program once, and send it\n"
+	"                                     every signature over its stdin\n"
 	"\n";
 static void print_help_pubkey(int argc, char *argv[])
 {
@@ -681,6 +836,13 @@ static const char usage_default[] = "\n"
 	"  usbpd1 firmware image               same, or signed in-place\n"
 	"  RW device image                     same, or signed in-place\n"
 	"\n"
+	"To sign many files in one run, reading each key only once:\n"
+	"\n"
+	"  --batch FILE     Read one set of PARAMS INFILE [OUTFILE] per line\n"
+	"                     of FILE (or - for stdin), separated by spaces.\n"
+	"                     PARAMS on the command line apply to every line.\n"
+	"  --jobs NUM       Sign using NUM processes (default 1)\n"
+	"\n"
 	"For more information, use \"" MYNAME " help %s TYPE\", where\n"
 	"TYPE is one of:\n\n";
 static void print_help_default(int argc, char *argv[])
@@ -719,6 +881,7 @@ enum no_short_opts {
 	OPT_PEM_SIGNPRIV,
 	OPT_PEM_ALGO,
 	OPT_PEM_EXTERNAL,
+	OPT_PEM_PERSISTENT,
 	OPT_TYPE,
 	OPT_HASH_ALG,
 	OPT_RO_SIZE,
@@ -728,6 +891,8 @@ enum no_short_opts {
 	OPT_DATA_SIZE,
 	OPT_SIG_SIZE,
 	OPT_PRIKEY,
+	OPT_BATCH,
+	OPT_JOBS,
 	OPT_HELP,
 };
 
@@ -755,6 +920,7 @@ static const struct option long_opts[] = {
 	{"pem",          1, NULL, OPT_PEM_SIGNPRIV}, /* alias */
 	{"pem_algo",     1, NULL, OPT_PEM_ALGO},
 	{"pem_external", 1, NULL, OPT_PEM_EXTERNAL},
+	{"pem_persistent", 0, NULL, OPT_PEM_PERSISTENT},
 	{"type",         1, NULL, OPT_TYPE},
 	{"vblockonly",   0, &sign_option.vblockonly, 1},
 	{"hash_alg",     1, NULL, OPT_HASH_ALG},
@@ -766,6 +932,8 @@ static const struct option long_opts[] = {
 	{"sig_size",     1, NULL, OPT_SIG_SIZE},
 	{"prikey",       1, NULL, OPT_PRIKEY},
 	{"privkey",      1, NULL, OPT_PRIKEY},	/* alias */
+	{"batch",        1, NULL, OPT_BATCH},
+	{"jobs",         1, NULL, OPT_JOBS},
 	{"help",         0, NULL, OPT_HELP},
 	{NULL,           0, NULL, 0},
 };
@@ -784,13 +952,20 @@ static int parse_number_opt(const char *arg, const char *name, uint32_t *dest)
 	return 0;
 }
 
-static int do_sign(int argc, char *argv[])
+/* Batch mode options */
+static const char *batch_file;
+static uint32_t batch_jobs = 1;
+
+/*
+ * Parse options into sign_option.  An input file given with an option is
+ * returned in *infile.  Returns the number of errors.
+ */
+static int parse_sign_opts(int argc, char *argv[], char **infile,
+			   int *helpind)
 {
-	char *infile = 0;
 	int i;
 	int errorcnt = 0;
 	char *e = 0;
-	int helpind = 0;
 	int longindex;
 
 	opterr = 0;		/* quiet, you */
@@ -798,21 +973,23 @@ static int do_sign(int argc, char *argv[])
 				&longindex)) != -1) {
 		switch (i) {
 		case 's':
-			sign_option.signprivate = vb2_read_private_key(optarg);
+			sign_option.signprivate =
+				read_key(KEY_PRIVATE, optarg, 0);
 			if (!sign_option.signprivate) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
 			}
 			break;
 		case 'b':
-			sign_option.keyblock = vb2_read_keyblock(optarg);
+			sign_option.keyblock = read_key(KEY_KEYBLOCK, optarg, 0);
 			if (!sign_option.keyblock) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
 			}
 			break;
 		case 'k':
-			sign_option.kernel_subkey = vb2_read_packed_key(optarg);
+			sign_option.kernel_subkey =
+				read_key(KEY_PACKED, optarg, 0);
 			if (!sign_option.kernel_subkey) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
@@ -847,7 +1024,7 @@ static int do_sign(int argc, char *argv[])
 			VBOOT_FALLTHROUGH;
 		case OPT_INFILE:
 			sign_option.inout_file_count++;
-			infile = optarg;
+			*infile = optarg;
 			break;
 		case OPT_OUTFILE:
 			sign_option.inout_file_count++;
@@ -948,6 +1125,10 @@ static int do_sign(int argc, char *argv[])
 		case OPT_PEM_EXTERNAL:
 			sign_option.pem_external = optarg;
 			break;
+		case OPT_PEM_PERSISTENT:
+			vb2_external_signer_persist(true);
+			pem_persistent = true;
+			break;
 		case OPT_TYPE:
 			if (!futil_str_to_file_type(optarg,
 						    &sign_option.type)) {
@@ -959,14 +1140,25 @@ static int do_sign(int argc, char *argv[])
 			}
 			break;
 		case OPT_PRIKEY:
-			if (vb21_private_key_read(&sign_option.prikey,
-						  optarg)) {
+			sign_option.prikey = read_key(KEY_PRIKEY, optarg, 0);
+			if (!sign_option.prikey) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
 			}
 			break;
+		case OPT_BATCH:
+			if (batch_file) {
+				fprintf(stderr, "Only one --batch is allowed\n");
+				errorcnt++;
+			}
+			batch_file = optarg;
+			break;
+		case OPT_JOBS:
+			errorcnt += parse_number_opt(optarg, "jobs",
+						     &batch_jobs);
+			break;
 		case OPT_HELP:
-			helpind = optind - 1;
+			*helpind = optind - 1;
 			break;
 
 		case '?':
@@ -989,22 +1181,21 @@ static int do_sign(int argc, char *argv[])
 		}
 	}
 
-	if (helpind) {
-		/* Skip all the options we've already parsed */
-		optind--;
-		argv[optind] = argv[0];
-		argc -= optind;
-		argv += optind;
-		print_help(argc, argv);
-		return !!errorcnt;
-	}
+	return errorcnt;
+}
 
+/*
+ * Check the arguments for the type of thing we're signing, then sign it.
+ * Takes and returns the error count; nothing is signed if it's non-zero.
+ */
+static int sign_infile(int argc, char *argv[], char *infile, int errorcnt)
+{
 	/* If we don't have an input file already, we need one */
 	if (!infile) {
 		if (argc - optind <= 0) {
 			errorcnt++;
 			fprintf(stderr, "ERROR: missing input filename\n");
-			goto done;
+			return errorcnt;
 		} else {
 			sign_option.inout_file_count++;
 			infile = argv[optind++];
@@ -1021,7 +1212,7 @@ static int do_sign(int argc, char *argv[])
 	if (sign_option.type == FILE_TYPE_UNKNOWN &&
 	    futil_file_type(infile, &sign_option.type)) {
 		errorcnt++;
-		goto done;
+		return errorcnt;
 	}
 
 	/* We may be able to infer the type based on the other args */
@@ -1121,7 +1312,7 @@ static int do_sign(int argc, char *argv[])
 		if (sign_option.create_new_outfile) {
 			errorcnt++;
 			fprintf(stderr, "Missing output filename\n");
-			goto done;
+			return errorcnt;
 		} else {
 			sign_option.outfile = infile;
 		}
@@ -1135,7 +1326,7 @@ static int do_sign(int argc, char *argv[])
 	}
 
 	if (errorcnt)
-		goto done;
+		return errorcnt;
 
 	if (!sign_option.create_new_outfile) {
 		/* We'll read-modify-write the output file */
@@ -1145,12 +1336,220 @@ static int do_sign(int argc, char *argv[])
 	}
 
 	errorcnt += futil_file_type_sign(sign_option.type, infile);
-done:
-	free(sign_option.signprivate);
-	free(sign_option.keyblock);
-	free(sign_option.kernel_subkey);
-	if (sign_option.prikey)
-		vb2_private_key_free(sign_option.prikey);
+
+	return errorcnt;
+}
+
+/* Most arguments on one line of a --batch file */
+#define BATCH_MAX_ARGS 64
+
+/* A line of a --batch file */
+struct batch_job {
+	char *line;
+	int lineno;
+};
+
+/* Sign one --batch line, on top of the options given on the command line. */
+static int sign_batch_job(const struct sign_option_s *defaults,
+			  const char *progname, struct batch_job *job)
+{
+	char *argv[BATCH_MAX_ARGS + 2];
+	char *infile = 0;
+	char *tok, *save;
+	int argc = 0;
+	int helpind = 0;
+	int errorcnt;
+
+	argv[argc++] = (char *)progname;
+	for (tok = strtok_r(job->line, " \t", &save); tok;
+	     tok = strtok_r(NULL, " \t", &save)) {
+		if (argc > BATCH_MAX_ARGS) {
+			fprintf(stderr, "%s:%d: too many arguments\n",
+				batch_file, job->lineno);
+			return 1;
+		}
+		argv[argc++] = tok;
+	}
+	argv[argc] = NULL;
+
+	sign_option = *defaults;
+	batch_lineno = job->lineno;
+	optind = 0;
+	errorcnt = parse_sign_opts(argc, argv, &infile, &helpind);
+	if (helpind) {
+		fprintf(stderr, "--help can't be used in a batch\n");
+		errorcnt++;
+	}
+	errorcnt = sign_infile(argc, argv, infile, errorcnt);
+
+	/* Keys stay in the cache, but free anything else this job read */
+	if (sign_option.bootloader_data != defaults->bootloader_data)
+		free(sign_option.bootloader_data);
+	if (sign_option.config_data != defaults->config_data)
+		free(sign_option.config_data);
+
+	if (errorcnt)
+		fprintf(stderr, "%s:%d: signing failed\n", batch_file,
+			job->lineno);
+	return errorcnt;
+}
+
+/*
+ * Wait for the signatures of all the deferred keyblocks, and write them out.
+ * Returns the number that failed.
+ */
+static int finish_pending_keyblocks(void)
+{
+	struct pending_keyblock *p;
+	int failed = 0;
+
+	while ((p = pending_keyblocks)) {
+		pending_keyblocks = p->next;
+		if (vb2_finish_keyblock_external(p->block, p->id) ||
+		    WriteSomeParts(p->outfile, p->block,
+				   p->block->keyblock_size, NULL, 0)) {
+			fprintf(stderr, "%s:%d: signing failed\n", batch_file,
+				p->lineno);
+			failed++;
+		}
+		free(p->block);
+		free(p->outfile);
+		free(p);
+	}
+	pending_tail = &pending_keyblocks;
+
+	return failed;
+}
+
+/*
+ * Sign everything listed in the --batch file, one set of PARAMS INFILE
+ * [OUTFILE] per line, with --jobs processes.  Keys are only read once per
+ * process.  Returns the number of failed jobs.
+ */
+static int sign_batch(const char *progname)
+{
+	const struct sign_option_s defaults = sign_option;
+	struct batch_job *jobs = NULL;
+	uint32_t njobs = 0, i, worker, failed = 0;
+	char *buf = NULL;
+	size_t bufsize = 0;
+	int lineno = 0;
+	FILE *fp;
+
+	fp = strcmp(batch_file, "-") ? fopen(batch_file, "r") : stdin;
+	if (!fp) {
+		fprintf(stderr, "Can't open %s: %s\n", batch_file,
+			strerror(errno));
+		return 1;
+	}
+
+	while (getline(&buf, &bufsize, fp) != -1) {
+		char *line = buf + strspn(buf, " \t");
+
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		jobs = realloc(jobs, (njobs + 1) * sizeof(*jobs));
+		if (!jobs)
+			FATAL("Failed to allocate batch jobs\n");
+		jobs[njobs].line = strdup(line);
+		jobs[njobs].lineno = lineno;
+		njobs++;
+	}
+	free(buf);
+	if (fp != stdin)
+		fclose(fp);
+
+	if (batch_jobs > njobs)
+		batch_jobs = njobs;
+
+	defer_external_signing = true;
+	if (batch_jobs <= 1) {
+		for (i = 0; i < njobs; i++)
+			failed += !!sign_batch_job(&defaults, progname,
+						   &jobs[i]);
+		failed += finish_pending_keyblocks();
+	} else {
+		/* Worker N signs every Nth job, and exits with its failures */
+		fflush(stdout);
+		fflush(stderr);
+		for (worker = 0; worker < batch_jobs; worker++) {
+			pid_t pid = fork();
+
+			if (pid < 0) {
+				fprintf(stderr, "Couldn't fork: %s\n",
+					strerror(errno));
+				failed++;
+				break;
+			}
+			if (!pid) {
+				for (i = worker; i < njobs; i += batch_jobs)
+					failed += !!sign_batch_job(
+						&defaults, progname, &jobs[i]);
+				failed += finish_pending_keyblocks();
+				vb2_external_signer_persist(false);
+				fflush(stdout);
+				fflush(stderr);
+				_exit(VB2_MIN(failed, 255));
+			}
+		}
+		while (worker--) {
+			int status;
+
+			if (wait(&status) < 0 || !WIFEXITED(status))
+				failed++;
+			else
+				failed += WEXITSTATUS(status);
+		}
+	}
+
+	for (i = 0; i < njobs; i++)
+		free(jobs[i].line);
+	free(jobs);
+
+	defer_external_signing = false;
+	sign_option = defaults;
+	if (failed)
+		fprintf(stderr, "%u of %u batch jobs failed\n", failed, njobs);
+	return failed;
+}
+
+static int do_sign(int argc, char *argv[])
+{
+	char *infile = 0;
+	int errorcnt = 0;
+	int helpind = 0;
+
+	errorcnt = parse_sign_opts(argc, argv, &infile, &helpind);
+
+	if (helpind) {
+		/* Skip all the options we've already parsed */
+		optind--;
+		argv[optind] = argv[0];
+		argc -= optind;
+		argv += optind;
+		print_help(argc, argv);
+		free_key_cache();
+		vb2_external_signer_persist(false);
+		return !!errorcnt;
+	}
+
+	if (batch_file) {
+		if (infile || argc - optind > 0) {
+			fprintf(stderr,
+				"Files to sign go in the --batch file\n");
+			errorcnt++;
+		}
+		if (!errorcnt)
+			errorcnt = sign_batch(argv[0]);
+	} else {
+		errorcnt = sign_infile(argc, argv, infile, errorcnt);
+	}
+
+	free_key_cache();
+	vb2_external_signer_persist(false);
 
 	if (errorcnt)
 		fprintf(stderr, "Use --help for usage instructions\n");
@@ -19,6 +19,7 @@ enum {
 	OPT_DUMMY = 0x100,
 
 	OPT_CCD,
+	OPT_DRY_RUN,
 	OPT_EMULATE,
 	OPT_FACTORY,
 	OPT_FAST,
@@ -56,6 +57,7 @@ static struct option const long_opts[] = {
 	{"mode", 1, NULL, 'm'},
 
 	{"ccd", 0, NULL, OPT_CCD},
+	{"dry-run", 0, NULL, OPT_DRY_RUN},
 	{"servo", 0, NULL, OPT_SERVO},
 	{"servo_port", 1, NULL, OPT_SERVO_PORT},
 	{"emulate", 1, NULL, OPT_EMULATE},
@@ -114,6 +116,7 @@ static void print_help(int argc, char *argv[])
 		"    --unpack=DIR    \tExtracts archive to DIR\n"
 		"-p, --programmer=PRG\tChange AP (host) flashrom programmer\n"
 		"    --fast          \tReduce read cycles and do not verify\n"
+		"    --dry-run       \tPrint the blocks to write, but do not write\n"
 		"    --quirks=LIST   \tSpecify the quirks to apply\n"
 		"    --list-quirks   \tPrint all available quirks\n"
 		"-m, --mode=MODE     \tRun updater in the specified mode\n"
@@ -253,6 +256,9 @@ static int do_update(int argc, char *argv[])
 		case OPT_FAST:
 			args.fast_update = 1;
 			break;
+		case OPT_DRY_RUN:
+			args.dry_run = 1;
+			break;
 		case OPT_GBB_FLAGS:
 			args.gbb_flags = strtoul(optarg, &endptr, 0);
 			if (*endptr) {
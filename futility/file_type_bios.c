@@ -17,6 +17,7 @@
 #include "futility.h"
 #include "futility_options.h"
 #include "host_common.h"
+#include "host_sha_mb.h"
 #include "vb1_helper.h"
 
 static const char * const fmap_name[] = {
@@ -241,6 +242,7 @@ int ft_show_bios(const char *name, void *data)
 
 static int write_new_preamble(struct bios_area_s *vblock,
 			      struct bios_area_s *fw_body,
+			      const struct vb2_hash *body_hash,
 			      struct vb2_private_key *signkey,
 			      struct vb2_keyblock *keyblock)
 {
@@ -248,7 +250,8 @@ static int write_new_preamble(struct bios_area_s *vblock,
 	struct vb2_fw_preamble *preamble = NULL;
 	int retval = 1;
 
-	body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len, signkey);
+	body_sig = vb2_create_signature_from_hash(body_hash, fw_body->len,
+						  signkey);
 	if (!body_sig) {
 		ERROR("Error calculating body signature\n");
 		goto end;
@@ -325,6 +328,12 @@ static int sign_bios_at_end(struct bios_state_s *state)
 	struct bios_area_s *vblock_b = &state->area[BIOS_FMAP_VBLOCK_B];
 	struct bios_area_s *fw_a = &state->area[BIOS_FMAP_FW_MAIN_A];
 	struct bios_area_s *fw_b = &state->area[BIOS_FMAP_FW_MAIN_B];
+	bool sign_b = vblock_b->is_valid && fw_b->is_valid;
+	struct vb2_hash body_hash[2];
+	struct vb2_hash_job jobs[2] = {
+		{ fw_a->buf, fw_a->len, &body_hash[0] },
+		{ fw_b->buf, fw_b->len, &body_hash[1] },
+	};
 	int retval = 0;
 
 	if (!vblock_a->is_valid || !fw_a->is_valid) {
@@ -332,11 +341,19 @@ static int sign_bios_at_end(struct bios_state_s *state)
 		return 1;
 	}
 
-	retval |= write_new_preamble(vblock_a, fw_a, sign_option.signprivate,
+	/* Hash the firmware bodies (together, when that is faster). */
+	if (vb2_hash_calculate_multi(sign_option.signprivate->hash_alg, jobs,
+				     sign_b ? 2 : 1) != VB2_SUCCESS) {
+		ERROR("Error calculating body hash\n");
+		return 1;
+	}
+
+	retval |= write_new_preamble(vblock_a, fw_a, &body_hash[0],
+				     sign_option.signprivate,
 				     sign_option.keyblock);
 
-	if (vblock_b->is_valid && fw_b->is_valid)
-		retval |= write_new_preamble(vblock_b, fw_b,
+	if (sign_b)
+		retval |= write_new_preamble(vblock_b, fw_b, &body_hash[1],
 					     sign_option.signprivate,
 					     sign_option.keyblock);
 	else
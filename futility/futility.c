@@ -274,8 +274,12 @@ static int do_version(int argc, char *argv[])
 {
 	if (argc > 1)
 		printf("%s - %s\n", argv[0], ver_help);
-	else
+	else {
 		printf("%s\n", futility_version);
+		printf("SHA-256: %s, SHA-512: %s\n",
+		       vb2_digest_impl_name(VB2_HASH_SHA256),
+		       vb2_digest_impl_name(VB2_HASH_SHA512));
+	}
 	return 0;
 }
 
@@ -54,7 +54,7 @@ int get_system_property(enum system_property_type property_type,
 	prop = &cfg->system_properties[property_type];
 	if (!prop->initialized) {
 		prop->initialized = 1;
-		prop->value = prop->getter();
+		prop->value = prop->getter(cfg);
 	}
 	return prop->value;
 }
@@ -302,12 +302,16 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 		return -1;
 	}
 
-	if (cfg->emulation) {
-		INFO("(emulation) %s slot %s on next boot, try_count=%d.\n",
+	if (cfg->emulation || cfg->dry_run) {
+		INFO("(%s) %s slot %s on next boot, try_count=%d.\n",
+		     cfg->emulation ? "emulation" : "dry run",
 		     has_update ? "Try" : "Keep", slot, tries);
 		return 0;
 	}
 
+	/* NVRAM may live on the flash, written by a flashrom subprocess. */
+	release_system_flash(cfg);
+
 	if (is_vboot2) {
 		if (VbSetSystemPropertyString("fw_try_next", slot)) {
 			ERROR("Failed to set fw_try_next to %s.\n", slot);
@@ -393,7 +397,8 @@ static int write_optional_firmware(struct updater_config *cfg,
 	 */
 	if (check_programmer_wp &&
 	    get_system_property(SYS_PROP_WP_HW, cfg) == WP_ENABLED &&
-	    flashrom_get_wp(image->programmer, -1) == WP_ENABLED) {
+	    flashrom_get_wp(&cfg->flashrom, image->programmer, -1) ==
+	    WP_ENABLED) {
 		ERROR("Target %s is write protected, skip updating.\n",
 		      image->programmer);
 		return 0;
@@ -1485,6 +1490,7 @@ int updater_setup_config(struct updater_config *cfg,
 	cfg->verbosity = arg->verbosity;
 	cfg->use_diff_image = arg->fast_update;
 	cfg->do_verify = !arg->fast_update;
+	cfg->dry_run = arg->dry_run;
 	cfg->factory_update = arg->is_factory;
 	if (arg->force_update)
 		cfg->force_update = 1;
@@ -1690,6 +1696,11 @@ void updater_delete_config(struct updater_config *cfg)
 	free_firmware_image(&cfg->ec_image);
 	free_firmware_image(&cfg->pd_image);
 	remove_all_temp_files(&cfg->tempfiles);
+	if (cfg->flashrom.probes)
+		INFO("Probed flash %d time(s), reused the probed chip %d "
+		     "time(s).\n", cfg->flashrom.probes,
+		     cfg->flashrom.probes_saved);
+	release_system_flash(cfg);
 	if (cfg->archive)
 		archive_close(cfg->archive);
 	free(cfg);
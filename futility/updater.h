@@ -67,6 +67,7 @@ struct updater_config {
 	struct quirk_entry quirks[QUIRK_MAX];
 	struct u_archive *archive;
 	struct tempfile tempfiles;
+	struct flashrom_session flashrom;
 	int try_update;
 	int force_update;
 	int legacy_update;
@@ -74,6 +75,7 @@ struct updater_config {
 	int check_platform;
 	int use_diff_image;
 	int do_verify;
+	int dry_run;
 	int verbosity;
 	const char *emulation;
 	int override_gbb_flags;
@@ -90,6 +92,7 @@ struct updater_config_arguments {
 	char *repack, *unpack;
 	int is_factory, try_update, force_update, do_manifest, host_only;
 	int fast_update;
+	int dry_run;
 	int verbosity;
 	int override_gbb_flags;
 	uint32_t gbb_flags;
@@ -216,12 +219,29 @@ struct u_archive *archive_open(const char *path);
  */
 int archive_close(struct u_archive *ar);
 
+/*
+ * Reopens an archive in a forked child process, so reading from it doesn't
+ * move the file offsets shared with the parent.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+int archive_reopen(struct u_archive *ar);
+
 /*
  * Checks if an entry (either file or directory) exists in archive.
  * Returns 1 if exists, otherwise 0
  */
 int archive_has_entry(struct u_archive *ar, const char *name);
 
+/*
+ * Gets the position of a file in a stream-based archive (e.g., tar.gz), where
+ * going back to an earlier file means decompressing again from the start.
+ * Large files in such archives should be read in the order of positions, by
+ * one process.
+ * Returns the position, or -1 if the file can be read at any time (or from any
+ * process).
+ */
+int archive_stream_position(struct u_archive *ar, const char *name);
+
 /*
  * Reads a file from archive.
  * Returns 0 on success (data and size reflects the file content),
@@ -42,13 +42,18 @@
 
 struct u_archive {
 	void *handle;
+	char *path;
 
 	void * (*open)(const char *name);
 	int (*close)(void *handle);
+	/* Gives a forked child its own handle, or NULL if one isn't needed. */
+	void * (*reopen)(void *handle, const char *name);
 
 	int (*walk)(void *handle, void *arg,
 		    int (*callback)(const char *path, void *arg));
 	int (*has_entry)(void *handle, const char *name);
+	/* Position of a file in a stream-based archive, NULL for others. */
+	int (*position)(void *handle, const char *name);
 	int (*read_file)(void *handle, const char *fname,
 			 uint8_t **data, uint32_t *size, int64_t *mtime);
 	int (*write_file)(void *handle, const char *fname,
@@ -197,48 +202,135 @@ static int archive_fallback_write_file(void *handle, const char *fname,
 #ifdef HAVE_LIBARCHIVE
 
 /*
- * For stream-based archives (e.g., tar+gz) we want to create a cache for
- * storing the names and contents for later processing.
+ * For stream-based archives (e.g., tar+gz) we want an index of the names, so
+ * lookups don't need to go through the stream. The contents are extracted on
+ * demand, and small ones are cached for later processing.
  */
-struct archive_cache {
+struct archive_cache_entry {
 	char *name;
 	uint8_t *data;
 	int64_t mtime;
 	size_t size;
 	int has_data;
-	struct archive_cache *next;
 };
 
-/* Add a new cache node to an existing cache list and return the new head. */
-static struct archive_cache *archive_cache_new(struct archive_cache *cache,
-					       const char *name)
+struct archive_cache {
+	char *path;
+	struct stat st;
+	struct archive_cache_entry *entries;
+	int num, max;
+	/* Entry indices by hash of name, or -1 for empty buckets. */
+	int *buckets;
+	uint32_t num_buckets;
+	/* The stream to extract from, and the entry it will return next. */
+	struct archive *reader;
+	int next;
+};
+
+/* Entries up to this size are kept when the stream goes past them. */
+#define ARCHIVE_CACHE_SMALL_FILE (256 * 1024)
+
+/*
+ * The index is kept in the user's cache directory, named by the device and
+ * inode of the archive, so later runs don't have to decompress the whole
+ * archive to list it.
+ */
+#define ARCHIVE_INDEX_DIR "futility"
+#define ARCHIVE_INDEX_MAGIC "futility-archive-index 2"
+
+static uint32_t archive_cache_hash(const char *name)
 {
-	struct archive_cache *c;
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
 
-	c = (struct archive_cache *)calloc(sizeof(*c), 1);
-	if (!c)
-		return NULL;
+	for (; *name; name++)
+		h = (h ^ (uint8_t)*name) * 16777619u;
+	return h;
+}
 
-	c->name = strdup(name);
-	if (!c->name) {
-		free(c);
-		return NULL;
+/*
+ * Find and return the index of an entry (by name), or -1 if not found.
+ * If the name appears more than once, the last one in the archive is returned.
+ */
+static int archive_cache_find(struct archive_cache *c, const char *name)
+{
+	uint32_t i;
+	int index;
+
+	if (!c->num_buckets)
+		return -1;
+
+	i = archive_cache_hash(name) & (c->num_buckets - 1);
+	for (; (index = c->buckets[i]) >= 0; i = (i + 1) & (c->num_buckets - 1))
+		if (!strcmp(c->entries[index].name, name))
+			return index;
+	return -1;
+}
+
+/* (Re)builds the hash table so it is at most half full. */
+static int archive_cache_rehash(struct archive_cache *c)
+{
+	uint32_t size = 16, i;
+	int index;
+
+	while (size < 2 * (uint32_t)c->max)
+		size *= 2;
+
+	free(c->buckets);
+	c->buckets = malloc(size * sizeof(*c->buckets));
+	if (!c->buckets) {
+		c->num_buckets = 0;
+		return -1;
 	}
+	memset(c->buckets, 0xff, size * sizeof(*c->buckets));
+	c->num_buckets = size;
 
-	c->next = cache;
-	return c;
+	for (index = 0; index < c->num; index++) {
+		const char *name = c->entries[index].name;
+
+		i = archive_cache_hash(name) & (size - 1);
+		while (c->buckets[i] >= 0 &&
+		       strcmp(c->entries[c->buckets[i]].name, name))
+			i = (i + 1) & (size - 1);
+		c->buckets[i] = index;
+	}
+	return 0;
 }
 
-/* Find and return an entry (by name) from the cache. */
-static struct archive_cache *archive_cache_find(struct archive_cache *c,
-						const char *name)
+/* Add a new entry to the cache and return it. */
+static struct archive_cache_entry *archive_cache_new(struct archive_cache *c,
+						     const char *name,
+						     size_t size, int64_t mtime)
 {
-	for (; c; c = c->next) {
-		assert(c->name);
-		if (!strcmp(c->name, name))
-			return c;
+	struct archive_cache_entry *e;
+	uint32_t i;
+
+	if (c->num == c->max) {
+		int max = c->max ? c->max * 2 : 64;
+
+		e = realloc(c->entries, max * sizeof(*e));
+		if (!e)
+			return NULL;
+		c->entries = e;
+		c->max = max;
+		if (archive_cache_rehash(c))
+			return NULL;
 	}
-	return NULL;
+
+	e = &c->entries[c->num];
+	memset(e, 0, sizeof(*e));
+	e->name = strdup(name);
+	if (!e->name)
+		return NULL;
+	e->size = size;
+	e->mtime = mtime;
+
+	/* A later entry with the same name replaces the earlier one. */
+	i = archive_cache_hash(name) & (c->num_buckets - 1);
+	while (c->buckets[i] >= 0 && strcmp(c->entries[c->buckets[i]].name, name))
+		i = (i + 1) & (c->num_buckets - 1);
+	c->buckets[i] = c->num++;
+	return e;
 }
 
 /* Callback for archive_walk to process all entries in the cache. */
@@ -246,26 +338,65 @@ static int archive_cache_walk(
 		struct archive_cache *c, void *arg,
 		int (*callback)(const char *name, void *arg))
 {
-	for (; c; c = c->next) {
-		assert(c->name);
-		if (callback(c->name, arg))
+	int i, num = c->num, r = 0;
+	char **names;
+
+	/*
+	 * Reading a file may find the index out of date and load it again, so
+	 * the names are copied first.
+	 */
+	names = calloc(num, sizeof(*names));
+	if (!names)
+		return -1;
+	for (i = 0; i < num && !r; i++) {
+		/* Skip entries replaced by a later one with the same name. */
+		if (archive_cache_find(c, c->entries[i].name) != i)
+			continue;
+		names[i] = strdup(c->entries[i].name);
+		if (!names[i])
+			r = -1;
+	}
+
+	/* From the last entry in the archive to the first. */
+	for (i = num - 1; i >= 0 && !r; i--) {
+		if (names[i] && callback(names[i], arg))
 			break;
 	}
-	return 0;
+	for (i = 0; i < num; i++)
+		free(names[i]);
+	free(names);
+	return r;
 }
 
-/* Delete all entries in the cache. */
-static void *archive_cache_free(struct archive_cache *c)
+/* Delete all entries in the cache, keeping the cache itself. */
+static void archive_cache_clear(struct archive_cache *c)
 {
-	struct archive_cache *next;
+	int i;
 
-	while (c) {
-		next = c->next;
-		free(c->name);
-		free(c->data);
-		free(c);
-		c = next;
+	for (i = 0; i < c->num; i++) {
+		free(c->entries[i].name);
+		free(c->entries[i].data);
 	}
+	if (c->reader)
+		archive_read_free(c->reader);
+	free(c->entries);
+	free(c->buckets);
+	c->reader = NULL;
+	c->entries = NULL;
+	c->buckets = NULL;
+	c->num = c->max = c->next = 0;
+	c->num_buckets = 0;
+}
+
+/* Delete the cache and all its entries. */
+static void *archive_cache_free(struct archive_cache *c)
+{
+	if (!c)
+		return NULL;
+
+	archive_cache_clear(c);
+	free(c->path);
+	free(c);
 	return NULL;
 }
 
@@ -273,88 +404,322 @@ static void *archive_cache_free(struct archive_cache *c)
  * -- The libarchive driver (multiple formats but very slow). --
  */
 
-enum {
-	FILTER_IGNORE,
-	FILTER_ABORT,
-	FILTER_NAME_ONLY,
-	FILTER_READ_ALL,
-};
-
-static struct archive_cache *libarchive_read_file_entries(
-		const char *fpath, int (*filter)(struct archive_entry *entry))
+/* Opens a stream to read entries from the beginning of an archive. */
+static struct archive *libarchive_open_reader(const char *fpath)
 {
 	struct archive *a = archive_read_new();
-	struct archive_entry *entry;
-	struct archive_cache *c, *cache = NULL;
-	int r;
 
 	assert(a);
 	archive_read_support_filter_all(a);
 	archive_read_support_format_all(a);
-	r = archive_read_open_filename(a, fpath, 10240);
-	if (r != ARCHIVE_OK) {
+	if (archive_read_open_filename(a, fpath, 10240) != ARCHIVE_OK) {
 		ERROR("Failed parsing archive using libarchive: %s\n", fpath);
 		archive_read_free(a);
 		return NULL;
 	}
+	return a;
+}
+
+/* Returns the next regular file in the stream, or NULL at the end. */
+static struct archive_entry *libarchive_next_file(struct archive *a)
+{
+	struct archive_entry *entry;
 
-	WARN("Loading data from archive: %s ", fpath);
 	while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
-		fputc('.', stderr);
-		if (archive_entry_filetype(entry) != AE_IFREG)
-			continue;
-		if (filter)
-			r = filter(entry);
-		else
-			r = FILTER_READ_ALL;
+		if (archive_entry_filetype(entry) == AE_IFREG)
+			return entry;
+	}
+	return NULL;
+}
 
-		if (r == FILTER_ABORT)
-			break;
-		if (r == FILTER_IGNORE)
-			continue;
+/*
+ * Returns the path of the index file for an archive (to be freed by caller),
+ * or NULL if there is no cache directory. If dir is not NULL, it is set to the
+ * directory of the file (also to be freed by caller).
+ */
+static char *libarchive_index_path(const struct stat *st, char **dir)
+{
+	const char *cache = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *index_dir = NULL, *path = NULL;
+
+	if (cache && *cache)
+		ASPRINTF(&index_dir, "%s/" ARCHIVE_INDEX_DIR, cache);
+	else if (home && *home)
+		ASPRINTF(&index_dir, "%s/.cache/" ARCHIVE_INDEX_DIR, home);
+	else
+		return NULL;
+
+	ASPRINTF(&path, "%s/archive-%llx-%llx.index", index_dir,
+		 (unsigned long long)st->st_dev,
+		 (unsigned long long)st->st_ino);
+	if (dir)
+		*dir = index_dir;
+	else
+		free(index_dir);
+	return path;
+}
+
+/* Prints the line that identifies an archive (by its stat) to an index. */
+static void libarchive_print_index_id(FILE *fp, const struct stat *st)
+{
+	fprintf(fp, ARCHIVE_INDEX_MAGIC " %llx %llx %lld %lld.%09ld "
+		"%lld.%09ld\n", (unsigned long long)st->st_dev,
+		(unsigned long long)st->st_ino, (long long)st->st_size,
+		(long long)st->st_mtim.tv_sec, st->st_mtim.tv_nsec,
+		(long long)st->st_ctim.tv_sec, st->st_ctim.tv_nsec);
+}
+
+/*
+ * Loads the index of an archive from the cache directory, if it was created
+ * for the same archive (by device, inode, size, modification and change time).
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int libarchive_load_index(struct archive_cache *c)
+{
+	char *index_path, *id = NULL;
+	uint8_t *data = NULL;
+	uint32_t data_size;
+	char *line, *next;
+	long long size, mtime;
+	size_t id_size;
+	FILE *fp;
+	int pos, r = -1;
+
+	index_path = libarchive_index_path(&c->st, NULL);
+	if (!index_path)
+		return -1;
+	if (vb2_read_file(index_path, &data, &data_size) != VB2_SUCCESS)
+		goto exit;
+
+	fp = open_memstream(&id, &id_size);
+	if (!fp)
+		goto exit;
+	libarchive_print_index_id(fp, &c->st);
+	fclose(fp);
+
+	/* vb2_read_file already has an extra '\0' in the end. */
+	if (strncmp((char *)data, id, id_size))
+		goto exit;
+
+	for (line = (char *)data + id_size; *line; line = next) {
+		next = strchr(line, '\n');
+		if (!next)
+			goto exit;
+		*next++ = '\0';
+		if (sscanf(line, "%lld %lld %n", &size, &mtime, &pos) != 2 ||
+		    !line[pos] || size < 0)
+			goto exit;
+		if (!archive_cache_new(c, line + pos, size, mtime))
+			goto exit;
+	}
+	VB2_DEBUG("Loaded %d entries from %s.\n", c->num, index_path);
+	r = 0;
+exit:
+	free(id);
+	free(data);
+	free(index_path);
+	return r;
+}
+
+/*
+ * Saves the index of an archive to the cache directory, if possible. The file
+ * is written under a temporary name and renamed, so other processes never see
+ * a partial index.
+ */
+static void libarchive_save_index(struct archive_cache *c)
+{
+	char *index_dir = NULL, *index_path, *temp_path = NULL, *p;
+	FILE *fp;
+	int fd, i, r = -1;
+
+	/* Names with a new line can't be indexed. */
+	for (i = 0; i < c->num; i++) {
+		if (strchr(c->entries[i].name, '\n'))
+			return;
+	}
+
+	index_path = libarchive_index_path(&c->st, &index_dir);
+	if (!index_path)
+		return;
 
-		c = archive_cache_new(cache, archive_entry_pathname(entry));
-		if (!c) {
+	/* Create the directories, ignoring the ones that exist. */
+	for (p = strchr(index_dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		mkdir(index_dir, 0700);
+		*p = '/';
+	}
+	mkdir(index_dir, 0700);
+
+	ASPRINTF(&temp_path, "%s.XXXXXX", index_path);
+	fd = mkstemp(temp_path);
+	if (fd < 0) {
+		VB2_DEBUG("Can't save index to %s.\n", index_path);
+		goto exit;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		goto exit;
+	}
+	libarchive_print_index_id(fp, &c->st);
+	for (i = 0; i < c->num; i++)
+		fprintf(fp, "%lld %lld %s\n", (long long)c->entries[i].size,
+			(long long)c->entries[i].mtime, c->entries[i].name);
+	if (fclose(fp) == 0 && rename(temp_path, index_path) == 0) {
+		VB2_DEBUG("Saved index to %s.\n", index_path);
+		r = 0;
+	}
+exit:
+	if (r && fd >= 0)
+		unlink(temp_path);
+	free(temp_path);
+	free(index_path);
+	free(index_dir);
+}
+
+/* Reads the contents of the next entry in the stream into the cache. */
+static int libarchive_read_data(struct archive *a,
+				struct archive_cache_entry *e)
+{
+	free(e->data);
+	e->data = (uint8_t *)calloc(1, e->size + 1);
+	if (!e->data) {
+		WARN("Out of memory when loading: %s\n", e->name);
+		return -1;
+	}
+	if (archive_read_data(a, e->data, e->size) != e->size) {
+		WARN("Failed reading from archive: %s\n", e->name);
+		free(e->data);
+		e->data = NULL;
+		return -1;
+	}
+	e->has_data = 1;
+	return 0;
+}
+
+/*
+ * Builds the index of an archive by reading all entry headers, and caches the
+ * contents of small entries on the way.
+ */
+static int libarchive_scan_index(struct archive_cache *c)
+{
+	struct archive *a = libarchive_open_reader(c->path);
+	struct archive_cache_entry *e;
+	struct archive_entry *entry;
+
+	if (!a)
+		return -1;
+
+	WARN("Loading index from archive: %s ", c->path);
+	while ((entry = libarchive_next_file(a)) != NULL) {
+		fputc('.', stderr);
+		e = archive_cache_new(c, archive_entry_pathname(entry),
+				      archive_entry_size(entry),
+				      archive_entry_mtime(entry));
+		if (!e) {
 			ERROR("Internal error: out of memory.\n");
-			archive_cache_free(cache);
 			archive_read_free(a);
-			return NULL;
+			return -1;
 		}
-		cache = c;
+		if (e->size <= ARCHIVE_CACHE_SMALL_FILE)
+			libarchive_read_data(a, e);
+	}
+	fputs("\r\n", stderr);  /* Flush the '.' */
+	VB2_DEBUG("Finished loading index from archive: %s.\n", c->path);
 
-		if (r == FILTER_NAME_ONLY)
-			continue;
+	archive_read_free(a);
+	return 0;
+}
 
-		assert(r == FILTER_READ_ALL);
-		c->size = archive_entry_size(entry);
-		c->mtime = archive_entry_mtime(entry);
-		c->data = (uint8_t *)calloc(1, c->size + 1);
-		if (!c->data) {
-			WARN("Out of memory when loading: %s\n", c->name);
-			continue;
+/*
+ * Builds the index of an archive again, for example after the archive was
+ * replaced, and saves it to the cache directory.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int libarchive_rebuild_index(struct archive_cache *c)
+{
+	archive_cache_clear(c);
+	if (stat(c->path, &c->st) != 0 || libarchive_scan_index(c))
+		return -1;
+	libarchive_save_index(c);
+	return 0;
+}
+
+/*
+ * Extracts the contents of an entry, going forward in the stream if the entry
+ * is ahead, or from the beginning if not. Small entries on the way are
+ * cached too, so reading configs out of order doesn't restart the stream.
+ * Large entries should be read in the order of archive_stream_position().
+ * Returns 0 on success, 1 if the archive no longer matches the index,
+ * otherwise -1.
+ */
+static int libarchive_extract(struct archive_cache *c, int index)
+{
+	struct archive_cache_entry *e;
+	struct archive_entry *entry;
+
+	if (c->reader && c->next > index) {
+		archive_read_free(c->reader);
+		c->reader = NULL;
+	}
+	if (!c->reader) {
+		VB2_DEBUG("Extracting from the start of %s.\n", c->path);
+		c->reader = libarchive_open_reader(c->path);
+		c->next = 0;
+		if (!c->reader)
+			return -1;
+	}
+
+	for (; c->next <= index; c->next++) {
+		e = &c->entries[c->next];
+		entry = libarchive_next_file(c->reader);
+		if (!entry || strcmp(archive_entry_pathname(entry), e->name) ||
+		    archive_entry_size(entry) != (int64_t)e->size) {
+			archive_read_free(c->reader);
+			c->reader = NULL;
+			return 1;
 		}
-		if (archive_read_data(a, c->data, c->size) != c->size) {
-			WARN("Failed reading from archive: %s\n", c->name);
+		if (e->has_data)
 			continue;
-		}
-		c->has_data = 1;
+		if (c->next != index && e->size > ARCHIVE_CACHE_SMALL_FILE)
+			continue;
+		if (libarchive_read_data(c->reader, e) && c->next == index)
+			return -1;
 	}
-	fputs("\r\n", stderr);  /* Flush the '.' */
-	VB2_DEBUG("Finished loading from archive: %s.\n", fpath);
+	return 0;
+}
 
-	archive_read_free(a);
-	return cache;
+/* Creates an empty cache for the archive. */
+static struct archive_cache *archive_cache_create(const char *path)
+{
+	struct archive_cache *c;
+
+	c = (struct archive_cache *)calloc(sizeof(*c), 1);
+	if (!c)
+		return NULL;
+	c->path = strdup(path);
+	if (!c->path)
+		return archive_cache_free(c);
+	return c;
 }
 
 /* Callback for archive_open on an ARCHIVE file. */
 static void *archive_libarchive_open(const char *name)
 {
-	/*
-	 * The firmware archives today can usually all load into memory
-	 * so we are using a NULL filter. Change that to a specific list in
-	 * future if the /build/$BOARD/firmware archive becomes too large.
-	 */
-	return libarchive_read_file_entries(name, NULL);
+	struct archive_cache *c;
+
+	/* Only the names are read now, and contents are extracted later. */
+	c = archive_cache_create(name);
+	if (!c || stat(name, &c->st) != 0)
+		return archive_cache_free(c);
+	if (libarchive_load_index(c) == 0)
+		return c;
+
+	/* A partially loaded index must be discarded. */
+	if (libarchive_rebuild_index(c))
+		return archive_cache_free(c);
+	return c;
 }
 
 /* Callback for archive_close on an ARCHIVE file. */
@@ -367,7 +732,13 @@ static int archive_libarchive_close(void *handle)
 /* Callback for archive_has_entry on an ARCHIVE file. */
 static int archive_libarchive_has_entry(void *handle, const char *fname)
 {
-	return archive_cache_find(handle, fname) != NULL;
+	return archive_cache_find(handle, fname) >= 0;
+}
+
+/* Callback for archive_stream_position on an ARCHIVE file. */
+static int archive_libarchive_position(void *handle, const char *fname)
+{
+	return archive_cache_find(handle, fname);
 }
 
 /* Callback for archive_walk on an ARCHIVE file. */
@@ -383,14 +754,30 @@ static int archive_libarchive_read_file(
 		void *handle, const char *fname, uint8_t **data,
 		uint32_t *size, int64_t *mtime)
 {
-	struct archive_cache *c = archive_cache_find(handle, fname);
+	struct archive_cache *cache = handle;
+	struct archive_cache_entry *c;
+	int index = archive_cache_find(cache, fname);
+	int r;
 
-	if (!c)
+	if (index < 0)
 		return 1;
 
-	if (!c->has_data) {
-		/* TODO(hungte) Re-read. */
-		ERROR("Not in the cache: %s\n", fname);
+	c = &cache->entries[index];
+	r = c->has_data ? 0 : libarchive_extract(cache, index);
+	if (r > 0) {
+		/* The archive was replaced (or the saved index is stale). */
+		WARN("Index of %s is out of date, loading it again.\n",
+		     cache->path);
+		index = -1;
+		if (libarchive_rebuild_index(cache) == 0)
+			index = archive_cache_find(cache, fname);
+		if (index < 0)
+			return 1;
+		c = &cache->entries[index];
+		r = c->has_data ? 0 : libarchive_extract(cache, index);
+	}
+	if (r) {
+		ERROR("Failed to extract: %s\n", fname);
 		return 1;
 	}
 
@@ -398,6 +785,15 @@ static int archive_libarchive_read_file(
 		*mtime = c->mtime;
 	if (size)
 		*size = c->size;
+
+	/* Large entries are not kept, so just hand over the data. */
+	if (c->size > ARCHIVE_CACHE_SMALL_FILE) {
+		*data = c->data;
+		c->data = NULL;
+		c->has_data = 0;
+		return 0;
+	}
+
 	*data = (uint8_t *)malloc(c->size + 1);
 	if (!*data) {
 		ERROR("Out of memory when reading: %s\n", c->name);
@@ -440,6 +836,14 @@ static int archive_zip_close(void *handle)
 	return 0;
 }
 
+/* Callback for archive_reopen on a ZIP file. */
+static void *archive_zip_reopen(void *handle, const char *name)
+{
+	/* Discard the parent's copy without writing anything. */
+	zip_discard((struct zip *)handle);
+	return archive_zip_open(name);
+}
+
 /* Callback for archive_has_entry on a ZIP file. */
 static int archive_zip_has_entry(void *handle, const char *fname)
 {
@@ -583,6 +987,7 @@ struct u_archive *archive_open(const char *path)
 			VB2_DEBUG("Found a ZIP file: %s\n", path);
 			ar->open = archive_zip_open;
 			ar->close = archive_zip_close;
+			ar->reopen = archive_zip_reopen;
 			ar->walk = archive_zip_walk;
 			ar->has_entry = archive_zip_has_entry;
 			ar->read_file = archive_zip_read_file;
@@ -599,6 +1004,7 @@ struct u_archive *archive_open(const char *path)
 		ar->close = archive_libarchive_close;
 		ar->walk = archive_libarchive_walk;
 		ar->has_entry = archive_libarchive_has_entry;
+		ar->position = archive_libarchive_position;
 		ar->read_file = archive_libarchive_read_file;
 		ar->write_file = archive_libarchive_write_file;
 	}
@@ -619,6 +1025,7 @@ struct u_archive *archive_open(const char *path)
 		free(ar);
 		return NULL;
 	}
+	ar->path = strdup(path);
 	return ar;
 }
 
@@ -629,10 +1036,32 @@ struct u_archive *archive_open(const char *path)
 int archive_close(struct u_archive *ar)
 {
 	int r = ar->close(ar->handle);
+	free(ar->path);
 	free(ar);
 	return r;
 }
 
+/*
+ * Reopens an archive in a forked child process, so reading from it doesn't
+ * move the file offsets shared with the parent.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+int archive_reopen(struct u_archive *ar)
+{
+	void *handle;
+
+	if (!ar || !ar->reopen)
+		return 0;
+
+	handle = ar->reopen(ar->handle, ar->path);
+	if (!handle) {
+		ERROR("Failed to reopen archive: %s\n", ar->path);
+		return -1;
+	}
+	ar->handle = handle;
+	return 0;
+}
+
 /*
  * Checks if an entry (either file or directory) exists in archive.
  * If entry name (fname) is an absolute path (/file), always check
@@ -646,6 +1075,17 @@ int archive_has_entry(struct u_archive *ar, const char *name)
 	return ar->has_entry(ar->handle, name);
 }
 
+/*
+ * Returns the position of a file in a stream-based archive, or -1 if the file
+ * can be read at any time.
+ */
+int archive_stream_position(struct u_archive *ar, const char *name)
+{
+	if (!ar || *name == '/' || !ar->position)
+		return -1;
+	return ar->position(ar->handle, name);
+}
+
 /*
  * Traverses all files within archive (directories are ignored).
  * For every entry, the path (relative the archive root) will be passed to
@@ -6,9 +6,12 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #if defined(__OpenBSD__)
 #include <sys/types.h>
 #endif
+#include <sys/wait.h>
+#include <unistd.h>
 
 #ifdef HAVE_CROSID
 #include <crosid.h>
@@ -823,68 +826,399 @@ static const char *get_gbb_key_hash(const struct vb2_gbb_header *gbb,
 	return packed_key_sha1_string(key);
 }
 
+/*
+ * Multi-model archives often use the same image file for many models. Each
+ * process printing models keeps what it parsed from every image file, so each
+ * file is loaded and parsed only once. Only the parsed fields are kept; the
+ * image data is released as soon as it is parsed.
+ */
+struct manifest_image {
+	char *file_name;
+	int is_loaded;	/* 0 if the file failed to load. */
+	char *ro_version;
+	char *rw_version;
+	/* Hashes of the GBB keys, NULL if the image has no GBB. */
+	char *root_key_hash;
+	char *recovery_key_hash;
+};
+
+struct manifest_images {
+	struct manifest_image *images;
+	int num;
+};
+
+/* Fills in the parsed fields of a manifest image from a loaded image. */
+static int parse_manifest_image(struct manifest_image *image,
+				const struct firmware_image *loaded)
+{
+	const struct vb2_gbb_header *gbb = find_gbb(loaded);
+
+	image->ro_version = strdup(loaded->ro_version);
+	image->rw_version = strdup(loaded->rw_version_a);
+	if (gbb) {
+		image->root_key_hash = strdup(get_gbb_key_hash(
+				gbb, gbb->rootkey_offset, gbb->rootkey_size));
+		image->recovery_key_hash = strdup(get_gbb_key_hash(
+				gbb, gbb->recovery_key_offset,
+				gbb->recovery_key_size));
+	}
+	if (!image->ro_version || !image->rw_version ||
+	    (gbb && (!image->root_key_hash || !image->recovery_key_hash)))
+		return -1;
+	return 0;
+}
+
+/*
+ * Gets the parsed image of file name in archive, loading and parsing it only
+ * if the file was not seen before.
+ * Returns the image, or NULL if the file couldn't be loaded.
+ */
+static const struct manifest_image *manifest_get_image(
+		struct manifest_images *images, struct u_archive *archive,
+		const char *name)
+{
+	struct manifest_image *image, *new_images;
+	struct firmware_image loaded = {0};
+	int i;
+
+	for (i = 0; i < images->num; i++) {
+		image = &images->images[i];
+		if (!strcmp(image->file_name, name))
+			return image->is_loaded ? image : NULL;
+	}
+
+	new_images = realloc(images->images, (images->num + 1) *
+			     sizeof(*images->images));
+	if (!new_images)
+		return NULL;
+	images->images = new_images;
+	image = &images->images[images->num];
+	memset(image, 0, sizeof(*image));
+	image->file_name = strdup(name);
+	if (!image->file_name)
+		return NULL;
+	images->num++;
+
+	if (!load_firmware_image(&loaded, name, archive) &&
+	    !parse_manifest_image(image, &loaded))
+		image->is_loaded = 1;
+	free_firmware_image(&loaded);
+	return image->is_loaded ? image : NULL;
+}
+
+/* Releases all images. */
+static void manifest_release_images(struct manifest_images *images)
+{
+	struct manifest_image *image;
+	int i;
+
+	for (i = 0; i < images->num; i++) {
+		image = &images->images[i];
+		free(image->file_name);
+		free(image->ro_version);
+		free(image->rw_version);
+		free(image->root_key_hash);
+		free(image->recovery_key_hash);
+	}
+	free(images->images);
+	memset(images, 0, sizeof(*images));
+}
+
+struct manifest_image_file {
+	const char *name;
+	int position;
+};
+
+static int compare_image_file(const void *a, const void *b)
+{
+	const struct manifest_image_file *x = a, *y = b;
+
+	if (x->position != y->position)
+		return x->position < y->position ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Loads the images of all models in a stream-based archive, in the order they
+ * are in the stream, so the archive is decompressed only once.
+ * Returns 1 if the archive is stream-based, otherwise 0 (and nothing loaded).
+ */
+static int manifest_load_stream_images(const struct manifest *manifest,
+				       struct manifest_images *images)
+{
+	struct manifest_image_file *files;
+	const char *name;
+	int i, j, k, num = 0;
+
+	files = calloc(manifest->num * 3, sizeof(*files));
+	if (!files)
+		return 0;
+	for (i = 0; i < manifest->num; i++) {
+		const struct model_config *m = &manifest->models[i];
+		const char * const names[] = {m->image, m->ec_image,
+					      m->pd_image};
+
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			name = names[j];
+			if (!name)
+				continue;
+			for (k = 0; k < num && strcmp(files[k].name, name); k++)
+				;
+			if (k < num)
+				continue;
+			files[num].name = name;
+			files[num].position = archive_stream_position(
+					manifest->archive, name);
+			num++;
+		}
+	}
+
+	for (i = 0; i < num && files[i].position < 0; i++)
+		;
+	if (i == num) {
+		free(files);
+		return 0;
+	}
+
+	qsort(files, num, sizeof(*files), compare_image_file);
+	for (i = 0; i < num; i++)
+		manifest_get_image(images, manifest->archive, files[i].name);
+	free(files);
+	return 1;
+}
+
+/*
+ * Prints the keys of the host image of a model with key patches. The keys are
+ * patched into the image, so it is loaded again for this model.
+ */
+static void print_json_patched_keys(FILE *fp, const char *fpath,
+				    struct model_config *m,
+				    struct u_archive *archive, int indent)
+{
+	struct firmware_image image = {0};
+	const struct vb2_gbb_header *gbb = NULL;
+
+	if (load_firmware_image(&image, fpath, archive) ||
+	    patch_image_by_model(&image, m, archive))
+		ERROR("Failed to patch images by model: %s\n", m->name);
+	else
+		gbb = find_gbb(&image);
+	if (gbb != NULL) {
+		fprintf(fp, "\n%*s\"keys\": { \"root\": \"%s\", ",
+			indent, "",
+			get_gbb_key_hash(gbb, gbb->rootkey_offset,
+					 gbb->rootkey_size));
+		fprintf(fp, "\"recovery\": \"%s\" },",
+			get_gbb_key_hash(gbb, gbb->recovery_key_offset,
+					 gbb->recovery_key_size));
+	}
+	free_firmware_image(&image);
+}
+
 /* Prints the information of given image file in JSON format. */
 static void print_json_image(
-		const char *name, const char *fpath, struct model_config *m,
+		FILE *fp, const char *name, const char *fpath,
+		struct manifest_images *images, struct model_config *m,
 		struct u_archive *archive, int indent, int is_host)
 {
-	struct firmware_image image = {0};
-	const struct vb2_gbb_header *gbb = NULL;
+	const struct manifest_image *image;
+
 	if (!fpath)
 		return;
-	if (load_firmware_image(&image, fpath, archive))
+	image = manifest_get_image(images, archive, fpath);
+	if (!image)
 		return;
 	if (!is_host)
-		printf(",\n");
-	printf("%*s\"%s\": { \"versions\": { \"ro\": \"%s\", \"rw\": \"%s\" },",
-	       indent, "", name, image.ro_version, image.rw_version_a);
+		fprintf(fp, ",\n");
+	fprintf(fp, "%*s\"%s\": { \"versions\": { \"ro\": \"%s\", "
+		"\"rw\": \"%s\" },",
+		indent, "", name, image->ro_version, image->rw_version);
 	indent += 2;
-	if (is_host) {
-		if (patch_image_by_model(&image, m, archive))
-			ERROR("Failed to patch images by model: %s\n", m->name);
-		else
-			gbb = find_gbb(&image);
+	if (is_host && (m->patches.rootkey || m->patches.vblock_a ||
+			m->patches.vblock_b)) {
+		print_json_patched_keys(fp, fpath, m, archive, indent);
+	} else if (is_host && image->root_key_hash) {
+		fprintf(fp, "\n%*s\"keys\": { \"root\": \"%s\", ",
+			indent, "", image->root_key_hash);
+		fprintf(fp, "\"recovery\": \"%s\" },",
+			image->recovery_key_hash);
 	}
-	if (gbb != NULL) {
-		printf("\n%*s\"keys\": { \"root\": \"%s\", ",
-		       indent, "",
-		       get_gbb_key_hash(gbb, gbb->rootkey_offset,
-					gbb->rootkey_size));
-		printf("\"recovery\": \"%s\" },",
-		       get_gbb_key_hash(gbb, gbb->recovery_key_offset,
-					gbb->recovery_key_size));
-	}
-	printf("\n%*s\"image\": \"%s\" }", indent, "", fpath);
-	free_firmware_image(&image);
+	fprintf(fp, "\n%*s\"image\": \"%s\" }", indent, "", fpath);
 }
 
-/* Prints the information of objects in manifest (models and images) in JSON. */
-void print_json_manifest(const struct manifest *manifest)
+/* Prints the information of a model (the i'th in manifest) in JSON. */
+static void print_json_model(FILE *fp, const struct manifest *manifest, int i,
+			     struct manifest_images *images)
 {
-	int i, indent;
+	struct model_config *m = &manifest->models[i];
 	struct u_archive *ar = manifest->archive;
+	int indent = 2;
+
+	fprintf(fp, "%s%*s\"%s\": {\n", i ? ",\n" : "", indent, "", m->name);
+	indent += 2;
+	print_json_image(fp, "host", m->image, images, m, ar, indent, 1);
+	print_json_image(fp, "ec", m->ec_image, images, m, ar, indent, 0);
+	print_json_image(fp, "pd", m->pd_image, images, m, ar, indent, 0);
+	if (m->patches.rootkey) {
+		struct patch_config *p = &m->patches;
+		fprintf(fp, ",\n%*s\"patches\": { \"rootkey\": \"%s\", "
+			"\"vblock_a\": \"%s\", \"vblock_b\": \"%s\" }",
+			indent, "", p->rootkey, p->vblock_a, p->vblock_b);
+	}
+	if (m->signature_id)
+		fprintf(fp, ",\n%*s\"signature_id\": \"%s\"", indent, "",
+			m->signature_id);
+	fprintf(fp, "\n  }");
+}
+
+/*
+ * Loading and parsing the images of a model (and patching its keys) takes much
+ * longer than forking, so large manifests are printed by several
+ * processes, each with a contiguous range of models. Small ones aren't worth
+ * it.
+ */
+#define MANIFEST_MODELS_PER_JOB 4
+
+/*
+ * Prints models [start, end) of manifest in a child process.
+ * Returns the pid of the child, and the read end of its output in *out_fd, or
+ * -1 on failure.
+ */
+static pid_t fork_json_models(const struct manifest *manifest, int start,
+			      int end, int *out_fd)
+{
+	struct manifest_images images = {0};
+	int fds[2], i;
+	pid_t pid;
+	FILE *fp;
+
+	if (pipe(fds) < 0)
+		return -1;
+
+	pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	if (pid > 0) {
+		close(fds[1]);
+		*out_fd = fds[0];
+		return pid;
+	}
+
+	close(fds[0]);
+	fp = fdopen(fds[1], "w");
+	if (!fp || archive_reopen(manifest->archive))
+		_exit(1);
+	for (i = start; i < end; i++)
+		print_json_model(fp, manifest, i, &images);
+	manifest_release_images(&images);
+	_exit(fclose(fp) ? 1 : 0);
+}
 
-	printf("{\n");
-	for (i = 0, indent = 2; i < manifest->num; i++) {
-		struct model_config *m = &manifest->models[i];
-		printf("%s%*s\"%s\": {\n", i ? ",\n" : "", indent, "", m->name);
-		indent += 2;
-		print_json_image("host", m->image, m, ar, indent, 1);
-		print_json_image("ec", m->ec_image, m, ar, indent, 0);
-		print_json_image("pd", m->pd_image, m, ar, indent, 0);
-		if (m->patches.rootkey) {
-			struct patch_config *p = &m->patches;
-			printf(",\n%*s\"patches\": { \"rootkey\": \"%s\", "
-			       "\"vblock_a\": \"%s\", \"vblock_b\": \"%s\" }",
-			       indent, "", p->rootkey, p->vblock_a,
-			       p->vblock_b);
+/*
+ * Reads all output of a child from fd, and returns it (with *size) only if the
+ * child succeeded. Returns NULL on failure.
+ */
+static char *collect_json_models(pid_t pid, int fd, size_t *size)
+{
+	char *buf = NULL, *new_buf;
+	size_t len = 0, max = 0;
+	ssize_t r = -1;
+	int status;
+
+	for (;;) {
+		if (len == max) {
+			max = max ? max * 2 : 4096;
+			new_buf = realloc(buf, max);
+			if (!new_buf)
+				break;
+			buf = new_buf;
+		}
+		r = read(fd, buf + len, max - len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		len += r;
+	}
+	close(fd);
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) || r < 0) {
+		free(buf);
+		return NULL;
+	}
+	*size = len;
+	return buf;
+}
+
+/* Prints the information of objects in manifest (models and images) in JSON. */
+static int write_json_manifest(FILE *fp, const struct manifest *manifest)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int jobs = manifest->num / MANIFEST_MODELS_PER_JOB;
+	struct manifest_images images = {0};
+	pid_t pids[64];
+	int fds[64];
+	int i, j, start, end;
+	char *buf;
+	size_t size;
+
+	if (jobs > ARRAY_SIZE(pids))
+		jobs = ARRAY_SIZE(pids);
+	if (jobs > cpus)
+		jobs = cpus;
+	if (jobs < 2)
+		jobs = 0;
+
+	/*
+	 * Stream-based archives must be read in order, by one process: a
+	 * worker would have to decompress the stream again from the start.
+	 */
+	if (manifest_load_stream_images(manifest, &images))
+		jobs = 0;
+
+	fprintf(fp, "{\n");
+	/* Children must not print what is still buffered here. */
+	fflush(fp);
+	for (j = 0; j < jobs; j++) {
+		start = manifest->num * j / jobs;
+		end = manifest->num * (j + 1) / jobs;
+		pids[j] = fork_json_models(manifest, start, end, &fds[j]);
+	}
+
+	/*
+	 * Merge the outputs in model order. A range whose child failed (or
+	 * couldn't start) is printed here instead.
+	 */
+	for (j = 0, i = 0; i < manifest->num; j++) {
+		start = jobs ? manifest->num * j / jobs : 0;
+		end = jobs ? manifest->num * (j + 1) / jobs : manifest->num;
+		buf = NULL;
+		if (jobs && pids[j] > 0)
+			buf = collect_json_models(pids[j], fds[j], &size);
+		if (buf) {
+			fwrite(buf, 1, size, fp);
+			free(buf);
+		} else {
+			if (jobs)
+				VB2_DEBUG("Printing models %d-%d serially.\n",
+					  start, end - 1);
+			for (i = start; i < end; i++)
+				print_json_model(fp, manifest, i, &images);
 		}
-		if (m->signature_id)
-			printf(",\n%*s\"signature_id\": \"%s\"", indent, "",
-			       m->signature_id);
-		printf("\n  }");
-		indent -= 2;
-		assert(indent == 2);
-	}
-	printf("\n}\n");
+		i = end;
+	}
+	fprintf(fp, "\n}\n");
+
+	manifest_release_images(&images);
+	return fflush(fp) ? -1 : 0;
+}
+
+/* Prints the information of objects in manifest (models and images) in JSON. */
+void print_json_manifest(const struct manifest *manifest)
+{
+	write_json_manifest(stdout, manifest);
 }
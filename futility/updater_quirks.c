@@ -156,6 +156,7 @@ static int ec_ro_software_sync(struct updater_config *cfg)
 		      "update by EC RO software sync.\n");
 		return 1;
 	}
+	release_system_flash(cfg);
 	VbSetSystemPropertyInt("try_ro_sync", 1);
 	return 0;
 }
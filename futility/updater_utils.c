@@ -205,6 +205,8 @@ static int parse_firmware_image(struct firmware_image *image)
  * Loads a firmware image from file.
  * If archive is provided and file_name is a relative path, read the file from
  * archive.
+ * The file is copied into memory rather than mapped, so changing or truncating
+ * the file after the image was checked can't change what is written to flash.
  * Returns IMAGE_LOAD_SUCCESS on success, IMAGE_READ_FAILURE on file I/O
  * failure, or IMAGE_PARSE_FAILURE for non-vboot images.
  */
@@ -394,7 +396,7 @@ char *host_shell(const char *command)
 
 
 /* An helper function to return "mainfw_act" system property.  */
-static int host_get_mainfw_act(void)
+static int host_get_mainfw_act(struct updater_config *cfg)
 {
 	char buf[VB_MAX_STRING_PROPERTY];
 
@@ -410,26 +412,26 @@ static int host_get_mainfw_act(void)
 }
 
 /* A helper function to return the "tpm_fwver" system property. */
-static int host_get_tpm_fwver(void)
+static int host_get_tpm_fwver(struct updater_config *cfg)
 {
 	return VbGetSystemPropertyInt("tpm_fwver");
 }
 
 /* A helper function to return the "hardware write protection" status. */
-static int host_get_wp_hw(void)
+static int host_get_wp_hw(struct updater_config *cfg)
 {
 	/* wpsw refers to write protection 'switch', not 'software'. */
 	return VbGetSystemPropertyInt("wpsw_cur") ? WP_ENABLED : WP_DISABLED;
 }
 
 /* A helper function to return "fw_vboot2" system property. */
-static int host_get_fw_vboot2(void)
+static int host_get_fw_vboot2(struct updater_config *cfg)
 {
 	return VbGetSystemPropertyInt("fw_vboot2");
 }
 
 /* A help function to get $(mosys platform version). */
-static int host_get_platform_version(void)
+static int host_get_platform_version(struct updater_config *cfg)
 {
 	char *result = host_shell("mosys platform version");
 	long rev = -1;
@@ -614,15 +616,145 @@ static char *get_flashrom_command(enum flash_command flash_cmd,
 	return cmd;
 }
 
+/*
+ * The smallest erase block of SPI flash chips. Flashrom erases bigger blocks
+ * when it can, so writing only the changed 4K blocks also skips the erases of
+ * unchanged 64K blocks.
+ */
+#define DELTA_BLOCK_SIZE 0x1000
+
+struct delta_area {
+	uint32_t offset;
+	uint32_t size;
+};
+
+static int compare_delta_area(const void *a, const void *b)
+{
+	const struct delta_area *x = a, *y = b;
+
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Finds which erase blocks of the sections (or the whole image if sections is
+ * NULL) differ between the image to write and the current flash contents, and
+ * merges the changed parts of adjacent blocks into ranges.
+ * The ranges are clipped to the sections, so nothing else is written.
+ * Returns the number of ranges (and *ranges must be freed), or -1 on error.
+ * *total is set to the number of bytes in the sections.
+ */
+static int plan_delta_write(const struct firmware_image *current,
+			    const struct firmware_image *image,
+			    const char * const sections[],
+			    struct flashrom_range **ranges, uint32_t *total)
+{
+	struct delta_area *areas;
+	struct flashrom_range *out;
+	struct firmware_section section;
+	uint32_t start, end, block_end, covered = 0;
+	int num_areas = 0, num = 0, i;
+
+	*ranges = NULL;
+	*total = 0;
+	if (current->size != image->size) {
+		ERROR("Image size is different (%s:%d != %s:%d)\n",
+		      image->file_name, image->size, current->file_name,
+		      current->size);
+		return -1;
+	}
+
+	for (i = 0; sections && sections[i]; i++)
+		num_areas++;
+	areas = calloc(sections ? num_areas : 1, sizeof(*areas));
+	if (!areas)
+		return -1;
+
+	if (!sections) {
+		areas[0].size = image->size;
+		num_areas = 1;
+	}
+	for (i = 0; i < num_areas && sections; i++) {
+		if (find_firmware_section(&section, image, sections[i])) {
+			ERROR("Failed to find section %s in %s.\n",
+			      sections[i], image->file_name);
+			free(areas);
+			return -1;
+		}
+		areas[i].offset = section.data - image->data;
+		areas[i].size = section.size;
+	}
+	qsort(areas, num_areas, sizeof(*areas), compare_delta_area);
+
+	/* There can't be more ranges than blocks, plus one per area. */
+	out = calloc(image->size / DELTA_BLOCK_SIZE + num_areas + 1,
+		     sizeof(*out));
+	if (!out) {
+		free(areas);
+		return -1;
+	}
+
+	for (i = 0; i < num_areas; i++) {
+		/* Sections may overlap, so skip what has been planned. */
+		start = VB2_MAX(areas[i].offset, covered);
+		end = areas[i].offset + areas[i].size;
+		if (start >= end)
+			continue;
+		*total += end - start;
+		covered = end;
+
+		for (; start < end; start = block_end) {
+			block_end = VB2_MIN(end, (start / DELTA_BLOCK_SIZE + 1) *
+					    DELTA_BLOCK_SIZE);
+			if (!memcmp(current->data + start, image->data + start,
+				    block_end - start))
+				continue;
+			if (num && out[num - 1].offset + out[num - 1].size ==
+			    start) {
+				out[num - 1].size += block_end - start;
+				continue;
+			}
+			out[num].offset = start;
+			out[num].size = block_end - start;
+			num++;
+		}
+	}
+
+	free(areas);
+	*ranges = out;
+	return num;
+}
+
+/* Prints what plan_delta_write() found, and the ranges if dry_run is set. */
+static void print_delta_plan(const struct flashrom_range *ranges, int num,
+			     uint32_t total, bool dry_run)
+{
+	uint32_t changed = 0;
+	int i;
+
+	for (i = 0; i < num; i++)
+		changed += ranges[i].size;
+
+	INFO("%s %u of %u bytes in %d range(s), skipping %u unchanged "
+	     "bytes.\n", dry_run ? "Would write" : "Writing", changed, total,
+	     num, total - changed);
+	for (i = 0; dry_run && i < num; i++)
+		printf("  %#010x-%#010x (%u bytes)\n", ranges[i].offset,
+		       ranges[i].offset + ranges[i].size - 1, ranges[i].size);
+}
+
 /*
  * Emulates writing a firmware image to the system.
  * Returns 0 if success, non-zero if error.
  */
 static int emulate_write_firmware(const char *filename,
 				  const struct firmware_image *image,
-				  const char * const sections[])
+				  const char * const sections[], bool dry_run)
 {
-	int i, errorcnt = 0;
+	int i, num, errorcnt = 0;
+	uint32_t total;
+	struct flashrom_range *ranges;
 	struct firmware_image to_image = {0};
 
 	INFO("Writing from %s to %s (emu=%s).\n",
@@ -641,6 +773,13 @@ static int emulate_write_firmware(const char *filename,
 		goto exit;
 	}
 
+	num = plan_delta_write(&to_image, image, sections, &ranges, &total);
+	if (num >= 0)
+		print_delta_plan(ranges, num, total, dry_run);
+	free(ranges);
+	if (dry_run)
+		goto exit;
+
 	if (!sections) {
 		VB2_DEBUG(" - write the whole image.\n");
 		memmove(to_image.data, image->data, image->size);
@@ -717,13 +856,22 @@ static int external_flashrom(enum flash_command flash_cmd,
 	return r;
 }
 
+void release_system_flash(struct updater_config *cfg)
+{
+	if (flashrom_session_close(&cfg->flashrom))
+		WARN("Failed to shut down the flash programmer.\n");
+}
+
 static int read_flash(struct flashrom_params *params,
 		      struct updater_config *cfg)
 {
-	if (get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg))
+	if (get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg)) {
+		release_system_flash(cfg);
 		return external_flashrom(FLASH_READ, params, &cfg->tempfiles);
+	}
 
-	return flashrom_read_image(params->image, NULL, params->verbose);
+	return flashrom_read_image(&cfg->flashrom, params->image, NULL,
+				   params->verbose);
 }
 
 static int write_flash(struct flashrom_params *params,
@@ -731,14 +879,26 @@ static int write_flash(struct flashrom_params *params,
 {
 	int r;
 
-	if (get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg))
+	if (get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg)) {
+		release_system_flash(cfg);
 		return external_flashrom(FLASH_WRITE, params, &cfg->tempfiles);
+	}
 
-	r = flashrom_write_image(params->image,
-				 params->regions,
-				 params->flash_contents,
-				 !params->noverify,
-				 params->verbose);
+	if (params->ranges)
+		r = flashrom_write_ranges(&cfg->flashrom,
+					  params->image,
+					  params->ranges,
+					  params->num_ranges,
+					  params->flash_contents,
+					  !params->noverify,
+					  params->verbose);
+	else
+		r = flashrom_write_image(&cfg->flashrom,
+					 params->image,
+					 params->regions,
+					 params->flash_contents,
+					 !params->noverify,
+					 params->verbose);
 	/*
 	 * Force a newline to flush stdout in case if
 	 * flashrom_write_image left some messages in the buffer.
@@ -776,52 +936,133 @@ int load_system_firmware(struct updater_config *cfg,
 	return r;
 }
 
+/*
+ * Reads the sections of the current system firmware image again, since the
+ * flash may have changed after it was loaded. The sections are found by the
+ * FMAP of the new image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int reload_current_sections(struct updater_config *cfg,
+				   struct firmware_image *current,
+				   const struct firmware_image *image,
+				   const char * const sections[], int verbose)
+{
+	struct flashrom_regions regions;
+	struct firmware_section section;
+	const uint8_t *data;
+	uint32_t offset;
+	int i, r;
+
+	r = flashrom_read_regions(&cfg->flashrom, current->programmer,
+				  sections, &regions, verbose);
+	if (r)
+		return r;
+	if (regions.flash_size != current->size)
+		r = -1;
+	for (i = 0; !r && sections[i]; i++) {
+		/* This fails if the FMAP on the flash moved the section. */
+		data = NULL;
+		if (!find_firmware_section(&section, image, sections[i])) {
+			offset = section.data - image->data;
+			data = flashrom_regions_get(&regions, offset,
+						    section.size);
+		}
+		if (!data) {
+			r = -1;
+			break;
+		}
+		memcpy(current->data + offset, data, section.size);
+	}
+	flashrom_free_regions(&regions);
+	return r;
+}
+
 /*
  * Writes sections from a given firmware image to the system firmware.
  * Regions should be NULL for writing the whole image, or a list of
  * FMAP section names (and ended with a NULL).
+ * With use_diff_image (--fast) or dry_run, the erase blocks that changed are
+ * found first, and only those are written (or printed). The sections are read
+ * again for that, while whole images are compared with the current image
+ * already loaded. Otherwise the sections are written as a whole.
  * Returns 0 if success, non-zero if error.
  */
 int write_system_firmware(struct updater_config *cfg,
 			  const struct firmware_image *image,
 			  const char * const sections[])
 {
-	int r = 0, i;
+	int r = 0, i, num = -1;
+	uint32_t total;
 	char *cmd;
 	const int tries = 1 + get_config_quirk(QUIRK_EXTRA_RETRIES, cfg);
 	struct flashrom_params params = {0};
-	struct firmware_image *flash_contents = NULL;
+	struct firmware_image *current = NULL;
+	struct flashrom_range *ranges = NULL;
 
 	if (cfg->emulation)
-		return emulate_write_firmware(cfg->emulation, image, sections);
+		return emulate_write_firmware(cfg->emulation, image, sections,
+					      cfg->dry_run);
 
-	if (cfg->use_diff_image && cfg->image_current.data &&
+	if (cfg->image_current.data &&
 	    is_the_same_programmer(&cfg->image_current, image))
-		flash_contents = &cfg->image_current;
+		current = &cfg->image_current;
 
 	params.image = (struct firmware_image *)image;
-	params.flash_contents = flash_contents;
+	params.flash_contents = cfg->use_diff_image ? current : NULL;
 	params.regions = sections;
 	params.noverify = !cfg->do_verify;
 	params.noverify_all = true;
 	params.verbose = cfg->verbosity + 1; /* libflashrom verbose 1 = WARN. */
 
+	/* The delta is only worth planning when it decides what to write. */
+	if ((!cfg->use_diff_image && !cfg->dry_run) ||
+	    get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg))
+		current = NULL;
+
+	if (current && sections &&
+	    reload_current_sections(cfg, current, image, sections,
+				    params.verbose)) {
+		WARN("Failed to read the flash again, writing all sections.\n");
+		current = NULL;
+	}
+
+	if (current) {
+		num = plan_delta_write(current, image, sections, &ranges,
+				       &total);
+		if (num < 0)
+			return -1;
+		print_delta_plan(ranges, num, total, cfg->dry_run);
+		params.ranges = ranges;
+		params.num_ranges = num;
+	}
+
 	cmd = get_flashrom_command(FLASH_WRITE, &params, NULL, NULL);
 	INFO("%s\n", cmd);
 	free(cmd);
 
+	if (cfg->dry_run || num == 0) {
+		free(ranges);
+		return 0;
+	}
+
 	for (i = 1, r = -1; i <= tries && r != 0; i++, params.verbose++) {
 		if (i > 1)
 			WARN("Retry writing firmware (%d/%d)...\n", i, tries);
 		r = write_flash(&params, cfg);
 	}
+
+	/* Keep the current contents in sync for the next delta. */
+	for (i = 0; !r && i < num; i++)
+		memcpy(current->data + ranges[i].offset,
+		       image->data + ranges[i].offset, ranges[i].size);
+	free(ranges);
 	return r;
 }
 
 /* Helper function to return host software write protection status. */
-static int host_get_wp_sw(void)
+static int host_get_wp_sw(struct updater_config *cfg)
 {
-	return flashrom_get_wp(PROG_HOST, -1);
+	return flashrom_get_wp(&cfg->flashrom, PROG_HOST, -1);
 }
 
 /* Helper function to configure all properties. */
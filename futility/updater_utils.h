@@ -66,6 +66,9 @@ struct flashrom_params {
 	bool noverify; /* -n: don't auto-verify */
 	bool noverify_all; /* -N: verify included regions only */
 	int verbose; /* -V: more verbose output */
+	/* Only write these ranges instead of the regions (libflashrom only). */
+	const struct flashrom_range *ranges;
+	int num_ranges;
 	/* Supported by libflashrom but no exported by flashrom_drv:
 	 *  - force
 	 *  - noverify_all
@@ -101,6 +104,13 @@ struct updater_config;
 int load_system_firmware(struct updater_config *cfg,
 			 struct firmware_image *image);
 
+/*
+ * Shuts down the flash programmer kept open by the updater, so another
+ * flashrom process (for example crossystem writing NVRAM on the flash) can
+ * access the chip.  The next flash access opens it again.
+ */
+void release_system_flash(struct updater_config *cfg);
+
 /* Frees the allocated resource from a firmware image object. */
 void free_firmware_image(struct firmware_image *image);
 
@@ -212,7 +222,7 @@ const char *cbfs_extract_file(const char *image_file,
 
 /* Utilities for accessing system properties */
 struct system_property {
-	int (*getter)(void);
+	int (*getter)(struct updater_config *cfg);
 	int value;
 	int initialized;
 };
@@ -121,6 +121,10 @@ typedef struct CgptFindParams {
 	 * need to print the device name. so this parameter is here to properly
 	 * show the correct device name in that special case. */
 	CgptFindShowFn show_fn;
+	/* Search several devices at once, in child processes which print
+	 * to stdout.  Only for the cgpt command, since a caller's show_fn
+	 * would run in a child too. */
+	int parallel;
 } CgptFindParams;
 
 enum {
@@ -45,6 +45,33 @@ int VbSetSystemPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetSystemPropertyString(const char* name, const char* value);
 
+/* A property for VbSetSystemProperties() to set. */
+typedef struct VbSystemProperty {
+	const char *name;
+	const char *str;	/* Value of a string property, or NULL */
+	int value;		/* Value of an integer property, if no str */
+} VbSystemProperty;
+
+/* Sets several system properties at once, in order, stopping at the first
+ * one which can't be set.
+ *
+ * The crossystem lock is taken only once, and the changes to the NV storage
+ * are all written together at the end.
+ *
+ * Returns the number of properties set (count if all of them were set), or
+ * -1 if error writing them. */
+int VbSetSystemProperties(const VbSystemProperty *props, int count);
+
+/* Starts a snapshot of the system properties.
+ *
+ * Until VbSystemPropertySnapshotEnd(), VbSharedData is read only once, and
+ * each property only the first time it is got; later gets return the same
+ * value from memory.  Setting a property forgets the values got so far. */
+void VbSystemPropertySnapshotBegin(void);
+
+/* Ends the snapshot and frees what it holds. */
+void VbSystemPropertySnapshotEnd(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,8 @@ int CgptGetNumNonEmptyPartitions(CgptShowParams *params);
 int CgptRepair(CgptRepairParams *params);
 int CgptPrioritize(CgptPrioritizeParams *params);
 void CgptFind(CgptFindParams *params);
+void CgptFindDrives(CgptFindParams *params, char *const drive_names[],
+		    int num_drives);
 int CgptLegacy(CgptLegacyParams *params);
 
 /* GUID conversion functions. Accepted format:
@@ -83,6 +83,107 @@ static const char *default_boot[] = {"disk", "usb", "altfw"};
  * makes it too easy to accidentally corrupt other sub-fields. */
 #define KERN_NV_CURRENTLY_UNUSED    0xFFC0
 
+/* A property value remembered by the snapshot */
+struct snapshot_value {
+	char *name;
+	int is_string;
+	int value;	/* Integer value, or 0 if the string is NULL */
+	char *str;	/* String value */
+};
+
+/* State of VbSystemPropertySnapshotBegin() */
+static struct {
+	int active;
+	int shared_data_read;
+	VbSharedDataHeader *shared_data;
+	struct snapshot_value *values;
+	int num_values;
+} snapshot;
+
+/* Return VbSharedData, which must be released with SharedDataPut(). */
+static VbSharedDataHeader *SharedDataGet(void)
+{
+	if (!snapshot.active)
+		return VbSharedDataRead();
+
+	if (!snapshot.shared_data_read) {
+		snapshot.shared_data = VbSharedDataRead();
+		snapshot.shared_data_read = 1;
+	}
+	return snapshot.shared_data;
+}
+
+static void SharedDataPut(VbSharedDataHeader *sh)
+{
+	if (!snapshot.active)
+		free(sh);
+}
+
+/* Forget the property values remembered by the snapshot. */
+static void SnapshotClearValues(void)
+{
+	int i;
+
+	for (i = 0; i < snapshot.num_values; i++) {
+		free(snapshot.values[i].name);
+		free(snapshot.values[i].str);
+	}
+	free(snapshot.values);
+	snapshot.values = NULL;
+	snapshot.num_values = 0;
+}
+
+static const struct snapshot_value *SnapshotFind(const char *name,
+						 int is_string)
+{
+	int i;
+
+	for (i = 0; i < snapshot.num_values; i++) {
+		const struct snapshot_value *v = &snapshot.values[i];
+		if (v->is_string == is_string && !strcasecmp(v->name, name))
+			return v;
+	}
+	return NULL;
+}
+
+/* Remember a property value; it's fine if there isn't memory for it. */
+static void SnapshotAdd(const char *name, int is_string, int value,
+			const char *str)
+{
+	struct snapshot_value *values, *v;
+
+	values = realloc(snapshot.values,
+			 (snapshot.num_values + 1) * sizeof(*values));
+	if (!values)
+		return;
+	snapshot.values = values;
+
+	v = &values[snapshot.num_values];
+	v->name = strdup(name);
+	v->is_string = is_string;
+	v->value = value;
+	v->str = str ? strdup(str) : NULL;
+	if (!v->name || (str && !v->str)) {
+		free(v->name);
+		free(v->str);
+		return;
+	}
+	snapshot.num_values++;
+}
+
+void VbSystemPropertySnapshotBegin(void)
+{
+	VbSystemPropertySnapshotEnd();
+	snapshot.active = 1;
+}
+
+void VbSystemPropertySnapshotEnd(void)
+{
+	SnapshotClearValues();
+	free(snapshot.shared_data);
+	memset(&snapshot, 0, sizeof(snapshot));
+}
+
 /* Return true if the FWID starts with the specified string. */
 int FwidStartsWith(const char *start)
 {
@@ -135,9 +236,12 @@ static struct vb2_context *get_fake_context(void)
 
 static int vnc_read;
 
+/* Nonzero while VbSetSystemProperties() holds back NV storage writes */
+static int vnc_batch;
+
 int vb2_get_nv_storage(enum vb2_nv_param param)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = SharedDataGet();
 	struct vb2_context *ctx = get_fake_context();
 
 	if (!sh)
@@ -148,7 +252,7 @@ int vb2_get_nv_storage(enum vb2_nv_param param)
 		if (sh && sh->flags & VBSD_NVDATA_V2)
 			ctx->flags |= VB2_CONTEXT_NVDATA_V2;
 		if (0 != vb2_read_nv_storage(ctx)) {
-			free(sh);
+			SharedDataPut(sh);
 			return -1;
 		}
 		vb2_nv_init(ctx);
@@ -159,41 +263,75 @@ int vb2_get_nv_storage(enum vb2_nv_param param)
 		vnc_read = 1;
 	}
 
-	free(sh);
+	SharedDataPut(sh);
 	return (int)vb2_nv_get(ctx, param);
 }
 
 int vb2_set_nv_storage(enum vb2_nv_param param, int value)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = SharedDataGet();
 	struct vb2_context *ctx = get_fake_context();
 
 	if (!sh)
 		return -1;
 
 	/* TODO: locking around NV access */
-	if (sh && sh->flags & VBSD_NVDATA_V2)
-		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-	if (0 != vb2_read_nv_storage(ctx)) {
-		free(sh);
-		return -1;
+	if (!vnc_batch || !vnc_read) {
+		if (sh && sh->flags & VBSD_NVDATA_V2)
+			ctx->flags |= VB2_CONTEXT_NVDATA_V2;
+		if (0 != vb2_read_nv_storage(ctx)) {
+			SharedDataPut(sh);
+			return -1;
+		}
+		vb2_nv_init(ctx);
 	}
-	vb2_nv_init(ctx);
 	vb2_nv_set(ctx, param, (uint32_t)value);
 
-	if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
+	if (vnc_batch) {
+		/* Keep the change for VbNvBatchEnd(), and let gets see it */
+		vnc_read = 1;
+	} else if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
 		vnc_read = 0;
 		if (0 != vb2_write_nv_storage(ctx)) {
-			free(sh);
+			SharedDataPut(sh);
 			return -1;
 		}
 	}
 
 	/* Success */
-	free(sh);
+	SharedDataPut(sh);
 	return 0;
 }
 
+/* Hold back NV storage writes until VbNvBatchEnd(). */
+static void VbNvBatchBegin(void)
+{
+	struct vb2_context *ctx = get_fake_context();
+
+	/* Read again before the first change, in case it changed */
+	vnc_read = 0;
+	vnc_batch = 1;
+	ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+}
+
+/* Write the NV storage changes held back since VbNvBatchBegin(), if any.
+ *
+ * Returns 0 if success, -1 if error. */
+static int VbNvBatchEnd(void)
+{
+	struct vb2_context *ctx = get_fake_context();
+	int retval = 0;
+
+	vnc_batch = 0;
+	if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
+		vnc_read = 0;
+		if (0 != vb2_write_nv_storage(ctx))
+			retval = -1;
+		ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+	}
+	return retval;
+}
+
 /*
  * Set a param value, and try to flag it for persistent backup.  It's okay if
  * backup isn't supported (which it isn't, in current designs). It's
@@ -281,7 +419,7 @@ static char *GetVdatLoadFirmwareDebug(char *dest, int size,
 
 static char *GetVdatString(char *dest, int size, VdatStringField field)
 {
-	VbSharedDataHeader *sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = SharedDataGet();
 	char *value = dest;
 
 	if (!sh)
@@ -313,13 +451,13 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			break;
 	}
 
-	free(sh);
+	SharedDataPut(sh);
 	return value;
 }
 
 static int GetVdatInt(VdatIntField field)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = SharedDataGet();
 	int value = -1;
 
 	if (!sh)
@@ -375,7 +513,7 @@ static int GetVdatInt(VdatIntField field)
 		}
 	}
 
-	free(sh);
+	SharedDataPut(sh);
 	return value;
 }
 
@@ -385,7 +523,7 @@ int VbSharedDataVersion(void)
 	return GetVdatInt(VDAT_INT_HEADER_VERSION);
 }
 
-int VbGetSystemPropertyInt(const char *name)
+static int GetSystemPropertyInt(const char *name)
 {
 	int value = -1;
 
@@ -512,7 +650,8 @@ int VbGetSystemPropertyInt(const char *name)
 	return value;
 }
 
-const char *VbGetSystemPropertyString(const char *name, char *dest, size_t size)
+static const char *GetSystemPropertyString(const char *name, char *dest,
+					   size_t size)
 {
 	/* Check for HWID override via cros_config */
 	if (!strcasecmp(name, "hwid")) {
@@ -575,6 +714,45 @@ const char *VbGetSystemPropertyString(const char *name, char *dest, size_t size)
 	return NULL;
 }
 
+int VbGetSystemPropertyInt(const char *name)
+{
+	const struct snapshot_value *v;
+	int value;
+
+	if (!snapshot.active)
+		return GetSystemPropertyInt(name);
+
+	v = SnapshotFind(name, 0);
+	if (v)
+		return v->value;
+
+	value = GetSystemPropertyInt(name);
+	SnapshotAdd(name, 0, value, NULL);
+	return value;
+}
+
+const char *VbGetSystemPropertyString(const char *name, char *dest, size_t size)
+{
+	const struct snapshot_value *v;
+	char buf[VB_MAX_STRING_PROPERTY];
+	const char *value;
+
+	if (!snapshot.active)
+		return GetSystemPropertyString(name, dest, size);
+
+	/* Remember the whole value, whatever the size of this caller's dest */
+	v = SnapshotFind(name, 1);
+	if (v) {
+		value = v->str;
+	} else {
+		value = GetSystemPropertyString(name, buf, sizeof(buf));
+		SnapshotAdd(name, 1, 0, value);
+	}
+	if (!value)
+		return NULL;
+	return StrCopy(dest, value, size);
+}
+
 static int VbSetSystemPropertyIntInternal(const char *name, int value)
 {
 	/* Check architecture-dependent properties first */
@@ -702,6 +880,7 @@ int VbSetSystemPropertyInt(const char *name, int value)
 		return -1;
 
 	result = VbSetSystemPropertyIntInternal(name, value);
+	SnapshotClearValues();
 
 	if (ReleaseCrossystemLock(lock_fd) < 0)
 		return -1;
@@ -772,6 +951,7 @@ int VbSetSystemPropertyString(const char *name, const char *value)
 		return -1;
 
 	result = VbSetSystemPropertyStringInternal(name, value);
+	SnapshotClearValues();
 
 	if (ReleaseCrossystemLock(lock_fd) < 0)
 		return -1;
@@ -779,6 +959,37 @@ int VbSetSystemPropertyString(const char *name, const char *value)
 	return result;
 }
 
+int VbSetSystemProperties(const VbSystemProperty *props, int count)
+{
+	int lock_fd;
+	int i;
+
+	lock_fd = AcquireCrossystemLock();
+	if (lock_fd < 0)
+		return -1;
+
+	VbNvBatchBegin();
+	for (i = 0; i < count; i++) {
+		const VbSystemProperty *p = &props[i];
+		int rv;
+
+		if (p->str)
+			rv = VbSetSystemPropertyStringInternal(p->name, p->str);
+		else
+			rv = VbSetSystemPropertyIntInternal(p->name, p->value);
+		if (rv)
+			break;
+	}
+	SnapshotClearValues();
+	if (0 != VbNvBatchEnd())
+		i = -1;
+
+	if (ReleaseCrossystemLock(lock_fd) < 0)
+		return -1;
+
+	return i;
+}
+
 /**
  * Get index of the last valid VBNV entry in an EEPROM.
  *
@@ -791,7 +1002,8 @@ int VbSetSystemPropertyString(const char *name, const char *value)
  */
 static int vb2_nv_index(const uint8_t *buf, uint32_t buf_sz, int vbnv_size)
 {
-	int index;
+	int low = 0;
+	int high = buf_sz / vbnv_size;
 	uint8_t blank[VB2_NVDATA_SIZE_V2];
 
 	/* The size of the buffer should be an even multiple of the
@@ -802,18 +1014,27 @@ static int vb2_nv_index(const uint8_t *buf, uint32_t buf_sz, int vbnv_size)
 			"firmware bug.\n", buf_sz, vbnv_size);
 	}
 
+	/*
+	 * Entries are appended in order and the region is erased when it
+	 * wraps, so every entry after the first blank one is blank as well.
+	 * Binary search for the first blank entry.
+	 */
 	memset(blank, 0xff, sizeof(blank));
-	for (index = 0; index < buf_sz / vbnv_size; index++) {
-		if (!memcmp(blank, &buf[index * vbnv_size], vbnv_size))
-			break;
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+
+		if (!memcmp(blank, &buf[mid * vbnv_size], vbnv_size))
+			high = mid;
+		else
+			low = mid + 1;
 	}
 
-	if (!index) {
+	if (!low) {
 		fprintf(stderr, "VBNV is uninitialized.\n");
 		return -1;
 	}
 
-	return index - 1;
+	return low - 1;
 }
 
 #define VBNV_FMAP_REGION "RW_NVRAM"
@@ -835,6 +1056,12 @@ int vb2_read_nv_storage_flashrom(struct vb2_context *ctx)
 		return -1;
 	}
 
+	/*
+	 * Like the firmware, use the last entry even if its CRC is bad (for
+	 * example, its write was torn by a power loss), and let vb2_nv_init()
+	 * reset it. Falling back to an older entry here would make crossystem
+	 * and the firmware disagree on the settings.
+	 */
 	memcpy(ctx->nvdata, &image.data[index * vbnv_size], vbnv_size);
 	free(image.data);
 	return 0;
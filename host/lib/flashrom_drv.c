@@ -6,6 +6,7 @@
  */
 
 #include <libflashrom.h>
+#include <sys/mman.h>
 
 #include "2common.h"
 #include "crossystem.h"
@@ -46,57 +47,149 @@ static char *flashrom_extract_params(const char *str, char **prog, char **params
 	return tmp;
 }
 
-int flashrom_read_image(struct firmware_image *image, const char *region,
-			int verbosity)
+int flashrom_session_close(struct flashrom_session *session)
 {
 	int r = 0;
-	size_t len = 0;
+
+	if (session->flashctx)
+		flashrom_flash_release(session->flashctx);
+	if (session->prog)
+		r = flashrom_programmer_shutdown(session->prog);
+
+	free(session->programmer);
+	free(session->params_buf);
+	session->programmer = NULL;
+	session->params_buf = NULL;
+	session->prog = NULL;
+	session->flashctx = NULL;
+	return r;
+}
+
+/*
+ * Return the chip for the programmer, probing it unless the session already
+ * has it open.  Returns 0 on success, otherwise -1.
+ */
+static int flashrom_session_open(struct flashrom_session *session,
+				 const char *programmer, int verbosity,
+				 struct flashrom_flashctx **flashctx)
+{
+	char *prog_name, *params;
 
 	g_verbose_screen = (verbosity == -1) ? FLASHROM_MSG_INFO : verbosity;
 
-	char *programmer, *params;
-	char *tmp = flashrom_extract_params(image->programmer, &programmer, &params);
+	if (session->flashctx && !strcmp(session->programmer, programmer)) {
+		session->probes_saved++;
+		*flashctx = session->flashctx;
+		return 0;
+	}
 
-	struct flashrom_programmer *prog = NULL;
-	struct flashrom_flashctx *flashctx = NULL;
-	struct flashrom_layout *layout = NULL;
+	/* Only one programmer can be open at a time */
+	if (flashrom_session_close(session))
+		WARN("failed to shut down programmer\n");
+
+	session->params_buf = flashrom_extract_params(programmer, &prog_name,
+						      &params);
 
 	flashrom_set_log_callback((flashrom_log_callback *)&flashrom_print_cb);
 
 	if (flashrom_init(1)
-		|| flashrom_programmer_init(&prog, programmer, params)) {
-		r = -1;
-		goto err_init;
+		|| flashrom_programmer_init(&session->prog, prog_name, params)) {
+		session->prog = NULL;
+		flashrom_session_close(session);
+		return -1;
 	}
-	if (flashrom_flash_probe(&flashctx, prog, NULL)) {
-		r = -1;
-		goto err_probe;
+	if (flashrom_flash_probe(&session->flashctx, session->prog, NULL)) {
+		session->flashctx = NULL;
+		flashrom_session_close(session);
+		return -1;
 	}
 
-	len = flashrom_flash_getsize(flashctx);
+	session->probes++;
+	session->programmer = strdup(programmer);
+	*flashctx = session->flashctx;
+	return 0;
+}
 
-	if (region) {
+/*
+ * Finish a call that opened the chip with flashrom_session_open().  A
+ * temporary session is closed, and so is a session whose call failed, in
+ * case the chip needs probing again before a retry.
+ */
+static int flashrom_session_done(struct flashrom_session *session,
+				 struct flashrom_session *tmp_session, int r)
+{
+	if (session == tmp_session || r)
+		r |= flashrom_session_close(session);
+	return r;
+}
+
+/*
+ * Build a layout that includes the named FMAP areas, from the FMAP in the
+ * image if there is one, or else from the FMAP on the chip.
+ * Returns 0 on success, otherwise -1.
+ */
+static int flashrom_include_regions(struct flashrom_layout **layout,
+				    struct flashrom_flashctx *flashctx,
+				    const struct firmware_image *image,
+				    size_t len, const char * const regions[])
+{
+	int r = 1;
+	int i;
+
+	if (image && image->data)
 		r = flashrom_layout_read_fmap_from_buffer(
-			&layout, flashctx, (const uint8_t *)image->data,
+			layout, flashctx, (const uint8_t *)image->data,
 			image->size);
-		if (r > 0) {
+	if (r > 0) {
+		if (image && image->data)
 			WARN("could not read fmap from image, r=%d, "
 				"falling back to read from rom\n", r);
-			r = flashrom_layout_read_fmap_from_rom(
-				&layout, flashctx, 0, len);
-			if (r > 0) {
-				ERROR("could not read fmap from rom, r=%d\n", r);
-				r = -1;
-				goto err_cleanup;
-			}
+		r = flashrom_layout_read_fmap_from_rom(
+			layout, flashctx, 0, len);
+		if (r > 0) {
+			ERROR("could not read fmap from rom, r=%d\n", r);
+			return -1;
 		}
+	}
+	for (i = 0; regions[i]; i++) {
 		// empty region causes seg fault in API.
-		r |= flashrom_layout_include_region(layout, region);
+		r |= flashrom_layout_include_region(*layout, regions[i]);
 		if (r > 0) {
-			ERROR("could not include region = '%s'\n", region);
-			r = -1;
-			goto err_cleanup;
+			ERROR("could not include region = '%s'\n",
+			      regions[i]);
+			return -1;
 		}
+	}
+	return 0;
+}
+
+int flashrom_read_image(struct flashrom_session *session,
+			struct firmware_image *image, const char *region,
+			int verbosity)
+{
+	int r = 0;
+	size_t len = 0;
+
+	struct flashrom_session tmp_session = {0};
+	struct flashrom_flashctx *flashctx = NULL;
+	struct flashrom_layout *layout = NULL;
+
+	if (!session)
+		session = &tmp_session;
+
+	if (flashrom_session_open(session, image->programmer, verbosity,
+				  &flashctx))
+		return -1;
+
+	len = flashrom_flash_getsize(flashctx);
+
+	if (region) {
+		const char * const regions[] = {region, NULL};
+
+		r = flashrom_include_regions(&layout, flashctx, image, len,
+					     regions);
+		if (r)
+			goto err_cleanup;
 		flashrom_layout_set(flashctx, layout);
 	}
 
@@ -107,18 +200,16 @@ int flashrom_read_image(struct firmware_image *image, const char *region,
 	r |= flashrom_image_read(flashctx, image->data, len);
 
 err_cleanup:
+	/* The chip may be used again, so don't leave our layout on it */
+	if (layout)
+		flashrom_layout_set(flashctx, NULL);
 	flashrom_layout_release(layout);
-	flashrom_flash_release(flashctx);
-
-err_probe:
-	r |= flashrom_programmer_shutdown(prog);
 
-err_init:
-	free(tmp);
-	return r;
+	return flashrom_session_done(session, &tmp_session, r);
 }
 
-int flashrom_write_image(const struct firmware_image *image,
+int flashrom_write_image(struct flashrom_session *session,
+			const struct firmware_image *image,
 			const char * const regions[],
 			const struct firmware_image *diff_image,
 			int do_verify, int verbosity)
@@ -126,26 +217,16 @@ int flashrom_write_image(const struct firmware_image *image,
 	int r = 0;
 	size_t len = 0;
 
-	g_verbose_screen = (verbosity == -1) ? FLASHROM_MSG_INFO : verbosity;
-
-	char *programmer, *params;
-	char *tmp = flashrom_extract_params(image->programmer, &programmer, &params);
-
-	struct flashrom_programmer *prog = NULL;
+	struct flashrom_session tmp_session = {0};
 	struct flashrom_flashctx *flashctx = NULL;
 	struct flashrom_layout *layout = NULL;
 
-	flashrom_set_log_callback((flashrom_log_callback *)&flashrom_print_cb);
+	if (!session)
+		session = &tmp_session;
 
-	if (flashrom_init(1)
-		|| flashrom_programmer_init(&prog, programmer, params)) {
-		r = -1;
-		goto err_init;
-	}
-	if (flashrom_flash_probe(&flashctx, prog, NULL)) {
-		r = -1;
-		goto err_probe;
-	}
+	if (flashrom_session_open(session, image->programmer, verbosity,
+				  &flashctx))
+		return -1;
 
 	len = flashrom_flash_getsize(flashctx);
 	if (len == 0) {
@@ -163,31 +244,10 @@ int flashrom_write_image(const struct firmware_image *image,
 	}
 
 	if (regions) {
-		int i;
-		r = flashrom_layout_read_fmap_from_buffer(
-			&layout, flashctx, (const uint8_t *)image->data,
-			image->size);
-		if (r > 0) {
-			WARN("could not read fmap from image, r=%d, "
-				"falling back to read from rom\n", r);
-			r = flashrom_layout_read_fmap_from_rom(
-				&layout, flashctx, 0, len);
-			if (r > 0) {
-				ERROR("could not read fmap from rom, r=%d\n", r);
-				r = -1;
-				goto err_cleanup;
-			}
-		}
-		for (i = 0; regions[i]; i++) {
-			// empty region causes seg fault in API.
-			r |= flashrom_layout_include_region(layout, regions[i]);
-			if (r > 0) {
-				ERROR("could not include region = '%s'\n",
-				      regions[i]);
-				r = -1;
-				goto err_cleanup;
-			}
-		}
+		r = flashrom_include_regions(&layout, flashctx, image, len,
+					     regions);
+		if (r)
+			goto err_cleanup;
 		flashrom_layout_set(flashctx, layout);
 	} else if (image->size != len) {
 		r = -1;
@@ -202,40 +262,233 @@ int flashrom_write_image(const struct firmware_image *image,
 				  diff_image ? diff_image->data : NULL);
 
 err_cleanup:
+	/* The chip may be used again, so don't leave our layout on it */
+	if (layout)
+		flashrom_layout_set(flashctx, NULL);
 	flashrom_layout_release(layout);
-	flashrom_flash_release(flashctx);
 
-err_probe:
-	r |= flashrom_programmer_shutdown(prog);
+	return flashrom_session_done(session, &tmp_session, r);
+}
+
+int flashrom_write_ranges(struct flashrom_session *session,
+			  const struct firmware_image *image,
+			  const struct flashrom_range *ranges, int num_ranges,
+			  const struct firmware_image *diff_image,
+			  int do_verify, int verbosity)
+{
+	int r = 0;
+	int i;
+	size_t len = 0;
+	char name[32];
+
+	struct flashrom_session tmp_session = {0};
+	struct flashrom_flashctx *flashctx = NULL;
+	struct flashrom_layout *layout = NULL;
+
+	if (!session)
+		session = &tmp_session;
+
+	if (flashrom_session_open(session, image->programmer, verbosity,
+				  &flashctx))
+		return -1;
+
+	len = flashrom_flash_getsize(flashctx);
+	if (len == 0 || image->size != len) {
+		ERROR("Image size (%u) does not match flash size (%zu).\n",
+		      image->size, len);
+		r = -1;
+		goto err_cleanup;
+	}
 
-err_init:
-	free(tmp);
+	if (diff_image && diff_image->size != image->size) {
+		ERROR("diff_image->size != image->size");
+		r = -1;
+		goto err_cleanup;
+	}
+
+	r = flashrom_layout_new(&layout);
+	if (r)
+		goto err_cleanup;
+
+	for (i = 0; i < num_ranges; i++) {
+		const struct flashrom_range *range = &ranges[i];
+
+		if (!range->size || range->offset > len ||
+		    range->size > len - range->offset) {
+			ERROR("Invalid range %#x+%#x.\n", range->offset,
+			      range->size);
+			r = -1;
+			goto err_cleanup;
+		}
+		snprintf(name, sizeof(name), "range%d", i);
+		r = flashrom_layout_add_region(layout, range->offset,
+					       range->offset + range->size - 1,
+					       name);
+		if (!r)
+			r = flashrom_layout_include_region(layout, name);
+		if (r) {
+			ERROR("Failed to add range %#x+%#x to the layout.\n",
+			      range->offset, range->size);
+			goto err_cleanup;
+		}
+	}
+	flashrom_layout_set(flashctx, layout);
+
+	flashrom_flag_set(flashctx, FLASHROM_FLAG_VERIFY_WHOLE_CHIP, false);
+	flashrom_flag_set(flashctx, FLASHROM_FLAG_VERIFY_AFTER_WRITE,
+			  do_verify);
+
+	r |= flashrom_image_write(flashctx, image->data, image->size,
+				  diff_image ? diff_image->data : NULL);
+
+err_cleanup:
+	/* The chip may be used again, so don't leave our layout on it */
+	if (layout)
+		flashrom_layout_set(flashctx, NULL);
+	flashrom_layout_release(layout);
+
+	return flashrom_session_done(session, &tmp_session, r);
+}
+
+int flashrom_read_regions(struct flashrom_session *session,
+			  const char *programmer,
+			  const char * const names[],
+			  struct flashrom_regions *regions, int verbosity)
+{
+	int r = 0;
+	int i, num;
+	size_t len = 0;
+	uint8_t *scratch = MAP_FAILED;
+
+	struct flashrom_session tmp_session = {0};
+	struct flashrom_flashctx *flashctx = NULL;
+	struct flashrom_layout *layout = NULL;
+
+	memset(regions, 0, sizeof(*regions));
+	for (num = 0; names[num]; num++)
+		;
+
+	if (!session)
+		session = &tmp_session;
+
+	if (flashrom_session_open(session, programmer, verbosity, &flashctx))
+		return -1;
+
+	len = flashrom_flash_getsize(flashctx);
+	regions->flash_size = len;
+
+	r = flashrom_include_regions(&layout, flashctx, NULL, len, names);
+	if (r)
+		goto err_cleanup;
+
+	regions->regions = calloc(num, sizeof(*regions->regions));
+	if (!regions->regions) {
+		r = -1;
+		goto err_cleanup;
+	}
+	for (i = 0; i < num; i++) {
+		struct flashrom_region *region = &regions->regions[i];
+		unsigned int start, size;
+
+		if (flashrom_layout_get_region_range(layout, names[i],
+						     &start, &size) ||
+		    start + size > len) {
+			ERROR("could not find region = '%s'\n", names[i]);
+			r = -1;
+			goto err_cleanup;
+		}
+		region->name = strdup(names[i]);
+		region->offset = start;
+		region->size = size;
+		region->data = malloc(size);
+		regions->num++;
+		if (!region->name || !region->data) {
+			r = -1;
+			goto err_cleanup;
+		}
+	}
+
+	/*
+	 * libflashrom only reads into a buffer for the whole chip.  Only the
+	 * pages under the included areas are written, so only those use any
+	 * memory.
+	 */
+	scratch = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (scratch == MAP_FAILED) {
+		ERROR("could not map %zu bytes\n", len);
+		r = -1;
+		goto err_cleanup;
+	}
+
+	flashrom_layout_set(flashctx, layout);
+	r = flashrom_image_read(flashctx, scratch, len);
+	if (!r) {
+		for (i = 0; i < num; i++) {
+			struct flashrom_region *region = &regions->regions[i];
+			memcpy(region->data, scratch + region->offset,
+			       region->size);
+		}
+	}
+
+err_cleanup:
+	if (scratch != MAP_FAILED)
+		munmap(scratch, len);
+	/* The chip may be used again, so don't leave our layout on it */
+	if (layout)
+		flashrom_layout_set(flashctx, NULL);
+	flashrom_layout_release(layout);
+
+	r = flashrom_session_done(session, &tmp_session, r);
+	if (r)
+		flashrom_free_regions(regions);
 	return r;
 }
 
-enum wp_state flashrom_get_wp(const char *programmer, int verbosity)
+const uint8_t *flashrom_regions_get(const struct flashrom_regions *regions,
+				    uint32_t offset, uint32_t size)
 {
-	enum wp_state r = WP_ERROR;
+	int i;
 
-	g_verbose_screen = (verbosity == -1) ? FLASHROM_MSG_INFO : verbosity;
+	for (i = 0; i < regions->num; i++) {
+		const struct flashrom_region *region = &regions->regions[i];
 
-	struct flashrom_programmer *prog = NULL;
-	struct flashrom_flashctx *flashctx = NULL;
+		if (offset >= region->offset &&
+		    offset - region->offset <= region->size &&
+		    size <= region->size - (offset - region->offset))
+			return region->data + (offset - region->offset);
+	}
+	return NULL;
+}
 
-	struct flashrom_wp_cfg *cfg = NULL;
+void flashrom_free_regions(struct flashrom_regions *regions)
+{
+	int i;
+
+	for (i = 0; i < regions->num; i++) {
+		free(regions->regions[i].name);
+		free(regions->regions[i].data);
+	}
+	free(regions->regions);
+	regions->regions = NULL;
+	regions->num = 0;
+}
 
-	char *tmp_programmer, *params;
-	char *tmp = flashrom_extract_params(programmer, &tmp_programmer,
-					    &params);
+enum wp_state flashrom_get_wp(struct flashrom_session *session,
+			      const char *programmer, int verbosity)
+{
+	enum wp_state r = WP_ERROR;
 
-	flashrom_set_log_callback((flashrom_log_callback *)&flashrom_print_cb);
+	struct flashrom_session tmp_session = {0};
+	struct flashrom_flashctx *flashctx = NULL;
 
-	if (flashrom_init(1)
-		|| flashrom_programmer_init(&prog, programmer, params))
-		goto err_init;
+	struct flashrom_wp_cfg *cfg = NULL;
+
+	if (!session)
+		session = &tmp_session;
 
-	if (flashrom_flash_probe(&flashctx, prog, NULL))
-		goto err_probe;
+	if (flashrom_session_open(session, programmer, verbosity, &flashctx))
+		return WP_ERROR;
 
 	if (flashrom_wp_cfg_new(&cfg) != FLASHROM_WP_OK)
 		goto err_cleanup;
@@ -252,14 +505,8 @@ err_read_cfg:
 	flashrom_wp_cfg_release(cfg);
 
 err_cleanup:
-	flashrom_flash_release(flashctx);
-
-err_probe:
-	if (flashrom_programmer_shutdown(prog))
+	if (flashrom_session_done(session, &tmp_session, r == WP_ERROR))
 		r = WP_ERROR;
 
-err_init:
-	free(tmp);
-
 	return r;
 }
@@ -78,19 +78,13 @@ struct vb2_keyblock *vb2_create_keyblock(
 	return h;
 }
 
-/* TODO(gauravsh): This could easily be integrated into the function above
- * since the code is almost a mirror - I have kept it as such to avoid changing
- * the existing interface. */
-struct vb2_keyblock *vb2_create_keyblock_external(
+/* Allocate a keyblock for [data_key] with its hash filled in, and room for a
+ * signature from [algorithm].  Returns NULL if error. */
+static struct vb2_keyblock *alloc_keyblock_external(
 		const struct vb2_packed_key *data_key,
-		const char *signing_key_pem_file,
 		uint32_t algorithm,
-		uint32_t flags,
-		const char *external_signer)
+		uint32_t flags)
 {
-	if (!signing_key_pem_file || !data_key || !external_signer)
-		return NULL;
-
 	uint32_t signed_size = sizeof(struct vb2_keyblock) + data_key->key_size;
 	uint32_t sig_data_size = vb2_rsa_sig_size(vb2_crypto_to_signature(algorithm));
 	uint32_t block_size =
@@ -127,11 +121,37 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 	vb2_copy_signature(&h->keyblock_hash, chk);
 	free(chk);
 
+	return h;
+}
+
+/* TODO(gauravsh): This could easily be integrated into the function above
+ * since the code is almost a mirror - I have kept it as such to avoid changing
+ * the existing interface. */
+struct vb2_keyblock *vb2_create_keyblock_external(
+		const struct vb2_packed_key *data_key,
+		const char *signing_key_pem_file,
+		uint32_t algorithm,
+		uint32_t flags,
+		const char *external_signer)
+{
+	if (!signing_key_pem_file || !data_key || !external_signer)
+		return NULL;
+
+	struct vb2_keyblock *h =
+		alloc_keyblock_external(data_key, algorithm, flags);
+	if (!h)
+		return NULL;
+
 	/* Calculate signature */
 	struct vb2_signature *sigtmp =
-		vb2_external_signature((uint8_t*)h, signed_size,
+		vb2_external_signature((uint8_t*)h,
+				       h->keyblock_signature.data_size,
 				       signing_key_pem_file, algorithm,
 				       external_signer);
+	if (!sigtmp) {
+		free(h);
+		return NULL;
+	}
 	vb2_copy_signature(&h->keyblock_signature, sigtmp);
 	free(sigtmp);
 
@@ -139,6 +159,47 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 	return h;
 }
 
+struct vb2_keyblock *vb2_start_keyblock_external(
+		const struct vb2_packed_key *data_key,
+		const char *signing_key_pem_file,
+		uint32_t algorithm,
+		uint32_t flags,
+		const char *external_signer,
+		int *id)
+{
+	if (!signing_key_pem_file || !data_key || !external_signer)
+		return NULL;
+
+	struct vb2_keyblock *h =
+		alloc_keyblock_external(data_key, algorithm, flags);
+	if (!h)
+		return NULL;
+
+	*id = vb2_external_signature_submit((uint8_t*)h,
+					    h->keyblock_signature.data_size,
+					    signing_key_pem_file, algorithm,
+					    external_signer);
+	if (*id < 0) {
+		free(h);
+		return NULL;
+	}
+
+	return h;
+}
+
+int vb2_finish_keyblock_external(struct vb2_keyblock *keyblock, int id)
+{
+	struct vb2_signature *sigtmp = vb2_external_signature_collect(id);
+	int rv;
+
+	if (!sigtmp)
+		return VB2_ERROR_UNKNOWN;
+
+	rv = vb2_copy_signature(&keyblock->keyblock_signature, sigtmp);
+	free(sigtmp);
+	return rv;
+}
+
 struct vb2_keyblock *vb2_read_keyblock(const char *filename)
 {
 	uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
@@ -0,0 +1,329 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host-side multi-buffer SHA-256/SHA-512.
+ *
+ * Each of the VB2_SHA_MB_LANES lanes of a vector holds the state of a
+ * different message, so one pass of the compression function advances
+ * every message by one block. Messages are fed into lanes as they become
+ * free, so buffers of very different sizes are handled efficiently.
+ */
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+#include "host_sha_mb.h"
+
+/*
+ * The GCC vector extensions are lowered to whatever the target supports. On
+ * x86-64 build AVX-512 and AVX2 variants as well and pick one at run time.
+ */
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define SHA_MB_TARGETS __attribute__((target_clones("avx512f", "avx2", \
+						    "default")))
+#endif
+#endif
+#ifndef SHA_MB_TARGETS
+#define SHA_MB_TARGETS
+#endif
+
+typedef uint32_t vb2_u32xl
+	__attribute__((vector_size(sizeof(uint32_t) * VB2_SHA_MB_LANES)));
+typedef uint64_t vb2_u64xl
+	__attribute__((vector_size(sizeof(uint64_t) * VB2_SHA_MB_LANES)));
+
+#define SHFR(x, n)    ((x) >> (n))
+#define ROTR32(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SHA256_F1(x) (ROTR32(x,  2) ^ ROTR32(x, 13) ^ ROTR32(x, 22))
+#define SHA256_F2(x) (ROTR32(x,  6) ^ ROTR32(x, 11) ^ ROTR32(x, 25))
+#define SHA256_F3(x) (ROTR32(x,  7) ^ ROTR32(x, 18) ^ SHFR(x,  3))
+#define SHA256_F4(x) (ROTR32(x, 17) ^ ROTR32(x, 19) ^ SHFR(x, 10))
+
+#define SHA512_F1(x) (ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
+#define SHA512_F2(x) (ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
+#define SHA512_F3(x) (ROTR64(x,  1) ^ ROTR64(x,  8) ^ SHFR(x,  7))
+#define SHA512_F4(x) (ROTR64(x, 19) ^ ROTR64(x, 61) ^ SHFR(x,  6))
+
+/* Per-lane hash state; element i of each vector belongs to lane i. */
+union sha_mb_state {
+	vb2_u32xl h256[8];
+	vb2_u64xl h512[8];
+};
+
+/* Message currently assigned to a lane. */
+struct sha_mb_lane {
+	/* Job being hashed, or NULL if the lane is idle */
+	struct vb2_hash_job *job;
+	/* Next full block of the message */
+	const uint8_t *data;
+	/* Number of full blocks left at |data| */
+	uint32_t blocks;
+	/* Number of padded final blocks in |tail|, and how many are done */
+	uint32_t tail_blocks;
+	uint32_t tail_done;
+	/* Partial last block of the message plus padding and length */
+	uint8_t tail[2 * VB2_SHA512_BLOCK_SIZE];
+};
+
+SHA_MB_TARGETS
+static void sha256_mb_transform(union sha_mb_state *state,
+				const uint8_t *const *blocks)
+{
+	vb2_u32xl w[64];
+	vb2_u32xl wv[8];
+	vb2_u32xl t1, t2;
+	int i, j;
+
+	for (j = 0; j < 16; j++) {
+		for (i = 0; i < VB2_SHA_MB_LANES; i++) {
+			uint32_t x;
+			PACK32(&blocks[i][j << 2], &x);
+			w[j][i] = x;
+		}
+	}
+
+	for (j = 16; j < 64; j++)
+		w[j] = SHA256_F4(w[j - 2]) + w[j - 7] +
+			SHA256_F3(w[j - 15]) + w[j - 16];
+
+	for (j = 0; j < 8; j++)
+		wv[j] = state->h256[j];
+
+	for (j = 0; j < 64; j++) {
+		t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
+			+ vb2_sha256_k[j] + w[j];
+		t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
+		wv[7] = wv[6];
+		wv[6] = wv[5];
+		wv[5] = wv[4];
+		wv[4] = wv[3] + t1;
+		wv[3] = wv[2];
+		wv[2] = wv[1];
+		wv[1] = wv[0];
+		wv[0] = t1 + t2;
+	}
+
+	for (j = 0; j < 8; j++)
+		state->h256[j] += wv[j];
+}
+
+SHA_MB_TARGETS
+static void sha512_mb_transform(union sha_mb_state *state,
+				const uint8_t *const *blocks)
+{
+	vb2_u64xl w[80];
+	vb2_u64xl wv[8];
+	vb2_u64xl t1, t2;
+	int i, j;
+
+	for (j = 0; j < 16; j++) {
+		for (i = 0; i < VB2_SHA_MB_LANES; i++) {
+			uint64_t x;
+			PACK64(&blocks[i][j << 3], &x);
+			w[j][i] = x;
+		}
+	}
+
+	for (j = 16; j < 80; j++)
+		w[j] = SHA512_F4(w[j - 2]) + w[j - 7] +
+			SHA512_F3(w[j - 15]) + w[j - 16];
+
+	for (j = 0; j < 8; j++)
+		wv[j] = state->h512[j];
+
+	for (j = 0; j < 80; j++) {
+		t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
+			+ vb2_sha512_k[j] + w[j];
+		t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
+		wv[7] = wv[6];
+		wv[6] = wv[5];
+		wv[5] = wv[4];
+		wv[4] = wv[3] + t1;
+		wv[3] = wv[2];
+		wv[2] = wv[1];
+		wv[1] = wv[0];
+		wv[0] = t1 + t2;
+	}
+
+	for (j = 0; j < 8; j++)
+		state->h512[j] += wv[j];
+}
+
+/* Assign a job to a lane and load the initial hash value into it. */
+static void sha_mb_lane_start(struct sha_mb_lane *lane, int index,
+			      union sha_mb_state *state,
+			      struct vb2_hash_job *job,
+			      enum vb2_hash_algorithm algo,
+			      uint32_t block_size)
+{
+	/* The message length field is 8 bytes for SHA-256, 16 for SHA-512 */
+	uint32_t length_size = block_size / 8;
+	uint32_t rem = job->size % block_size;
+	uint64_t bits = (uint64_t)job->size << 3;
+	uint8_t *end;
+	int i;
+
+	lane->job = job;
+	lane->data = job->buf;
+	lane->blocks = job->size / block_size;
+	lane->tail_blocks = rem + 1 + length_size > block_size ? 2 : 1;
+	lane->tail_done = 0;
+
+	memset(lane->tail, 0, lane->tail_blocks * block_size);
+	memcpy(lane->tail, lane->data + lane->blocks * block_size, rem);
+	lane->tail[rem] = SHA256_PAD_BEGIN;
+	end = lane->tail + lane->tail_blocks * block_size;
+	for (i = 1; i <= sizeof(bits); i++, bits >>= 8)
+		end[-i] = (uint8_t)bits;
+
+	if (block_size == VB2_SHA256_BLOCK_SIZE) {
+		struct vb2_sha256_context ctx;
+		vb2_sha256_init(&ctx, algo);
+		for (i = 0; i < 8; i++)
+			state->h256[i][index] = ctx.h[i];
+	} else {
+		struct vb2_sha512_context ctx;
+		vb2_sha512_init(&ctx, algo);
+		for (i = 0; i < 8; i++)
+			state->h512[i][index] = ctx.h[i];
+	}
+}
+
+/* Return the next block of a lane's message. */
+static const uint8_t *sha_mb_lane_next(struct sha_mb_lane *lane,
+				       uint32_t block_size)
+{
+	const uint8_t *block;
+
+	if (lane->blocks) {
+		block = lane->data;
+		lane->data += block_size;
+		lane->blocks--;
+		return block;
+	}
+
+	return lane->tail + block_size * lane->tail_done++;
+}
+
+/* Store the digest of a lane whose message has been fully hashed. */
+static void sha_mb_lane_finish(struct sha_mb_lane *lane, int index,
+			       const union sha_mb_state *state,
+			       enum vb2_hash_algorithm algo,
+			       uint32_t block_size)
+{
+	struct vb2_hash *hash = lane->job->hash;
+	int words;
+	int i;
+
+	hash->algo = algo;
+	if (block_size == VB2_SHA256_BLOCK_SIZE) {
+		words = vb2_digest_size(algo) / sizeof(uint32_t);
+		for (i = 0; i < words; i++)
+			UNPACK32(state->h256[i][index], &hash->raw[i << 2]);
+	} else {
+		words = vb2_digest_size(algo) / sizeof(uint64_t);
+		for (i = 0; i < words; i++)
+			UNPACK64(state->h512[i][index], &hash->raw[i << 3]);
+	}
+
+	lane->job = NULL;
+}
+
+/*
+ * Whether the single-buffer code is faster for this algorithm. The SHA
+ * extension hashes one message faster than the vectors hash eight.
+ */
+static bool sha_mb_single_is_faster(enum vb2_hash_algorithm algo)
+{
+#ifdef X86_SHA_DISPATCH
+	const char *name = vb2_sha_x86_impl_name(algo);
+
+	return name && !strcmp(name, "sha-ni");
+#else
+	return false;
+#endif
+}
+
+vb2_error_t vb2_hash_calculate_multi(enum vb2_hash_algorithm algo,
+				     struct vb2_hash_job *jobs, size_t count)
+{
+	static const uint8_t idle_block[VB2_SHA512_BLOCK_SIZE];
+	struct sha_mb_lane lanes[VB2_SHA_MB_LANES];
+	const uint8_t *blocks[VB2_SHA_MB_LANES];
+	union sha_mb_state state;
+	uint32_t block_size;
+	size_t next = 0;
+	int active = 0;
+	int i;
+
+	switch (algo) {
+	case VB2_HASH_SHA224:
+	case VB2_HASH_SHA256:
+		block_size = VB2_SHA256_BLOCK_SIZE;
+		break;
+	case VB2_HASH_SHA384:
+	case VB2_HASH_SHA512:
+		block_size = VB2_SHA512_BLOCK_SIZE;
+		break;
+	default:
+		block_size = 0;
+		break;
+	}
+
+	/*
+	 * Idle lanes cost as much as busy ones, so fewer messages than lanes
+	 * are hashed one by one too.
+	 */
+	if (!block_size || count < VB2_SHA_MB_LANES ||
+	    sha_mb_single_is_faster(algo)) {
+		for (next = 0; next < count; next++)
+			VB2_TRY(vb2_hash_calculate(false, jobs[next].buf,
+						   jobs[next].size, algo,
+						   jobs[next].hash));
+		return VB2_SUCCESS;
+	}
+
+	memset(lanes, 0, sizeof(lanes));
+	memset(&state, 0, sizeof(state));
+
+	for (;;) {
+		/* Hand waiting messages to idle lanes */
+		for (i = 0; i < VB2_SHA_MB_LANES && next < count; i++) {
+			if (lanes[i].job)
+				continue;
+			sha_mb_lane_start(&lanes[i], i, &state, &jobs[next++],
+					  algo, block_size);
+			active++;
+		}
+
+		if (!active)
+			return VB2_SUCCESS;
+
+		for (i = 0; i < VB2_SHA_MB_LANES; i++)
+			blocks[i] = lanes[i].job ?
+				sha_mb_lane_next(&lanes[i], block_size) :
+				idle_block;
+
+		if (block_size == VB2_SHA256_BLOCK_SIZE)
+			sha256_mb_transform(&state, blocks);
+		else
+			sha512_mb_transform(&state, blocks);
+
+		/* Retire lanes whose last block was just consumed */
+		for (i = 0; i < VB2_SHA_MB_LANES; i++) {
+			struct sha_mb_lane *lane = &lanes[i];
+			if (!lane->job || lane->blocks ||
+			    lane->tail_done != lane->tail_blocks)
+				continue;
+			sha_mb_lane_finish(lane, i, &state, algo, block_size);
+			active--;
+		}
+	}
+}
@@ -9,8 +9,11 @@
 
 #include <openssl/rsa.h>
 
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -108,12 +111,17 @@ static int sign_external(uint32_t size, const uint8_t *inbuf, uint8_t *outbuf,
 	return rv;
 }
 
-struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
-					     const char *key_file,
-					     uint32_t key_algorithm,
-					     const char *external_signer)
+/* Return the DigestInfo to sign for [data], or NULL if error.  Caller must
+ * free() it.
+ */
+static uint8_t *signature_digest(const uint8_t *data, uint32_t size,
+				 uint32_t key_algorithm, uint32_t *out_size)
 {
 	struct vb2_hash hash;
+	const uint8_t *digest_info = NULL;
+	uint32_t digest_info_size = 0;
+	uint32_t digest_size;
+	uint8_t *digest;
 
 	/* Calculate the digest */
 	if (VB2_SUCCESS != vb2_hash_calculate(false, data, size,
@@ -121,43 +129,420 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
 					      &hash))
 		return NULL;
 
-	uint32_t digest_info_size = 0;
-	const uint8_t *digest_info = NULL;
 	if (VB2_SUCCESS != vb2_digest_info(hash.algo,
 					   &digest_info, &digest_info_size))
 		return NULL;
 
-	int digest_size = vb2_digest_size(hash.algo);
-	uint8_t *signature_digest;
-	uint64_t signature_digest_len = digest_size + digest_info_size;
+	/* Prepend the digest info to the digest */
+	digest_size = vb2_digest_size(hash.algo);
+	digest = calloc(digest_info_size + digest_size, 1);
+	if (!digest)
+		return NULL;
 
-	int rv;
+	memcpy(digest, digest_info, digest_info_size);
+	memcpy(digest + digest_info_size, hash.raw, digest_size);
+	*out_size = digest_info_size + digest_size;
+	return digest;
+}
 
-	/* Prepend the digest info to the digest */
-	signature_digest = calloc(signature_digest_len, 1);
-	if (!signature_digest)
+/* Most requests sent to a persistent external signer and not yet answered.
+ * This keeps the requests and signatures waiting in the socket well under the
+ * size of its buffers, so neither side can block the other.
+ */
+#define SIGNER_MAX_IN_FLIGHT 16
+
+enum signer_request_state {
+	SIGNER_REQUEST_SENT,
+	SIGNER_REQUEST_DONE,
+	SIGNER_REQUEST_FAILED,
+};
+
+struct signer_request {
+	int id;
+	enum signer_request_state state;
+	struct vb2_signature *sig;
+	struct signer_request *next;
+};
+
+struct vb2_external_signer {
+	char *program;
+	pid_t pid;
+	pid_t owner;			/* Process which started the signer */
+	int fd;				/* Signer's stdin and stdout */
+	FILE *from_signer;
+	int in_flight;
+	bool broken;			/* Stopped following the protocol */
+	struct signer_request *requests;
+};
+
+/* Signer used by vb2_external_signature(), if persistent */
+static bool persist_signers;
+static struct vb2_external_signer *persistent_signer;
+
+/* Request IDs are never reused, even by a restarted signer, so a request
+ * can't be mistaken for one sent to an earlier signer. */
+static int next_request_id;
+
+struct vb2_external_signer *vb2_external_signer_open(
+	const char *external_signer)
+{
+	struct vb2_external_signer *signer;
+	int sv[2];  /* socket descriptors */
+	pid_t pid;
+
+	VB2_DEBUG("Starting persistent external signer \"%s\".\n",
+		  external_signer);
+
+	/* A socket rather than pipes, so writing to a signer which has exited
+	 * is an error instead of SIGPIPE.  Close-on-exec, so other children
+	 * don't hold the signer's socket open; dup2() clears the flag on the
+	 * signer's stdin and stdout. */
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+		VB2_DEBUG("socketpair() error\n");
+		return NULL;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		VB2_DEBUG("fork() error\n");
+		close(sv[0]);
+		close(sv[1]);
+		return NULL;
+	}
+	if (pid == 0) {  /* Child. */
+		if (dup2(sv[1], STDIN_FILENO) < 0 ||
+		    dup2(sv[1], STDOUT_FILENO) < 0)
+			_exit(127);
+		execl(external_signer, external_signer, (char *)0);
+		VB2_DEBUG("execl() of external signer failed\n");
+		_exit(127);
+	}
+
+	/* Parent. */
+	close(sv[1]);
+
+	signer = calloc(1, sizeof(*signer));
+	if (signer) {
+		signer->program = strdup(external_signer);
+		signer->pid = pid;
+		signer->owner = getpid();
+		signer->fd = sv[0];
+		signer->from_signer = fdopen(sv[0], "r");
+	}
+	if (!signer || !signer->program || !signer->from_signer) {
+		VB2_DEBUG("Can't allocate external signer\n");
+		if (signer && signer->from_signer)
+			fclose(signer->from_signer);
+		else
+			close(sv[0]);
+		waitpid(pid, NULL, 0);
+		if (signer)
+			free(signer->program);
+		free(signer);
+		return NULL;
+	}
+
+	return signer;
+}
+
+void vb2_external_signer_close(struct vb2_external_signer *signer)
+{
+	struct signer_request *req;
+
+	if (!signer)
+		return;
+
+	/* A forked copy of the signer isn't ours to stop or wait for. */
+	if (signer->owner == getpid()) {
+		/* End of file on its stdin tells the signer to exit. */
+		shutdown(signer->fd, SHUT_WR);
+		fclose(signer->from_signer);
+		if (waitpid(signer->pid, NULL, 0) < 0)
+			VB2_DEBUG("waitpid() error\n");
+	} else {
+		fclose(signer->from_signer);
+	}
+
+	while ((req = signer->requests)) {
+		signer->requests = req->next;
+		free(req->sig);
+		free(req);
+	}
+	free(signer->program);
+	free(signer);
+}
+
+/* Give up on a signer, failing every request still waiting for a
+ * signature.
+ */
+static void signer_fail_all(struct vb2_external_signer *signer)
+{
+	struct signer_request *req;
+
+	signer->broken = true;
+
+	for (req = signer->requests; req; req = req->next) {
+		if (req->state == SIGNER_REQUEST_SENT)
+			req->state = SIGNER_REQUEST_FAILED;
+	}
+	signer->in_flight = 0;
+}
+
+/* Read one response from the signer.  Returns 0 on success, -1 if the signer
+ * broke the protocol, in which case nothing more can be read from it.
+ */
+static int signer_read_response(struct vb2_external_signer *signer)
+{
+	struct signer_request *req;
+	char line[80];
+	char status[4];
+	uint32_t size = 0;
+	int id;
+
+	if (!fgets(line, sizeof(line), signer->from_signer)) {
+		VB2_DEBUG("External signer exited\n");
+		return -1;
+	}
+
+	if (sscanf(line, "%3s %d %u", status, &id, &size) < 2) {
+		VB2_DEBUG("Bad response from external signer: %s", line);
+		return -1;
+	}
+
+	for (req = signer->requests; req; req = req->next) {
+		if (req->id == id && req->state == SIGNER_REQUEST_SENT)
+			break;
+	}
+	if (!req) {
+		VB2_DEBUG("Response to unknown request %d\n", id);
+		return -1;
+	}
+	signer->in_flight--;
+
+	if (strcmp(status, "OK")) {
+		VB2_DEBUG("External signer failed request %d\n", id);
+		req->state = SIGNER_REQUEST_FAILED;
+		return 0;
+	}
+
+	/* The signature must be exactly the size of the key's signatures */
+	if (size != req->sig->sig_size) {
+		VB2_DEBUG("Signature %d is %u bytes; expected %u\n",
+			  id, size, req->sig->sig_size);
+		return -1;
+	}
+	if (fread(vb2_signature_data_mutable(req->sig), 1, size,
+		  signer->from_signer) != size) {
+		VB2_DEBUG("read() error\n");
+		return -1;
+	}
+
+	req->state = SIGNER_REQUEST_DONE;
+	return 0;
+}
+
+/* Write all of [buf] to the signer.  Returns 0 on success, -1 on error. */
+static int send_all(int fd, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (size) {
+		n = send(fd, p, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+int vb2_external_signer_submit(struct vb2_external_signer *signer,
+			       const uint8_t *data, uint32_t size,
+			       const char *key_file, uint32_t key_algorithm)
+{
+	struct signer_request *req, **tail;
+	uint32_t digest_size, sig_size;
+	char header[PATH_MAX + 64];
+	int header_size;
+	uint8_t *digest;
+	int ok;
+
+	if (signer->broken)
+		return -1;
+
+	/* Make room in the socket */
+	while (signer->in_flight >= SIGNER_MAX_IN_FLIGHT) {
+		if (signer_read_response(signer)) {
+			signer_fail_all(signer);
+			return -1;
+		}
+	}
+
+	req = calloc(1, sizeof(*req));
+	if (!req)
+		return -1;
+
+	sig_size = vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
+	req->sig = vb2_alloc_signature(sig_size, size);
+	digest = signature_digest(data, size, key_algorithm, &digest_size);
+	if (!req->sig || !digest) {
+		free(digest);
+		free(req->sig);
+		free(req);
+		return -1;
+	}
+
+	req->id = next_request_id++;
+	header_size = snprintf(header, sizeof(header), "SIGN %d %u %s\n",
+			       req->id, digest_size, key_file);
+	ok = header_size < sizeof(header) &&
+		!send_all(signer->fd, header, header_size) &&
+		!send_all(signer->fd, digest, digest_size);
+	free(digest);
+	if (!ok) {
+		VB2_DEBUG("write() error\n");
+		free(req->sig);
+		free(req);
+		return -1;
+	}
+
+	req->state = SIGNER_REQUEST_SENT;
+	for (tail = &signer->requests; *tail; tail = &(*tail)->next)
+		;
+	*tail = req;
+	signer->in_flight++;
+
+	return req->id;
+}
+
+struct vb2_signature *vb2_external_signer_collect(
+	struct vb2_external_signer *signer, int id)
+{
+	struct signer_request *req, **prev;
+	struct vb2_signature *sig = NULL;
+
+	for (prev = &signer->requests; *prev; prev = &(*prev)->next) {
+		if ((*prev)->id == id)
+			break;
+	}
+	req = *prev;
+	if (!req)
 		return NULL;
 
-	memcpy(signature_digest, digest_info, digest_info_size);
-	memcpy(signature_digest + digest_info_size, hash.raw, digest_size);
+	while (req->state == SIGNER_REQUEST_SENT) {
+		if (signer_read_response(signer))
+			signer_fail_all(signer);
+	}
+
+	if (req->state == SIGNER_REQUEST_DONE)
+		sig = req->sig;
+	else
+		free(req->sig);
+	*prev = req->next;
+	free(req);
+
+	return sig;
+}
+
+void vb2_external_signer_persist(bool enable)
+{
+	persist_signers = enable;
+	if (!enable) {
+		vb2_external_signer_close(persistent_signer);
+		persistent_signer = NULL;
+	}
+}
+
+/* Return the persistent signer for [external_signer], starting it if
+ * needed.  Returns NULL if error.
+ */
+static struct vb2_external_signer *get_persistent_signer(
+	const char *external_signer)
+{
+	struct vb2_external_signer *signer = persistent_signer;
+
+	/* A signer started by another process, before it forked us, is still
+	 * talking to that process.  A broken signer is restarted. */
+	if (signer && (signer->owner != getpid() || signer->broken ||
+		       strcmp(signer->program, external_signer))) {
+		vb2_external_signer_close(signer);
+		signer = NULL;
+	}
+
+	if (!signer)
+		signer = vb2_external_signer_open(external_signer);
+
+	persistent_signer = signer;
+	return signer;
+}
+
+int vb2_external_signature_submit(const uint8_t *data, uint32_t size,
+				  const char *key_file, uint32_t key_algorithm,
+				  const char *external_signer)
+{
+	struct vb2_external_signer *signer;
+
+	if (!persist_signers)
+		return -1;
+
+	signer = get_persistent_signer(external_signer);
+	if (!signer)
+		return -1;
+
+	return vb2_external_signer_submit(signer, data, size, key_file,
+					  key_algorithm);
+}
+
+struct vb2_signature *vb2_external_signature_collect(int id)
+{
+	if (!persistent_signer)
+		return NULL;
+
+	return vb2_external_signer_collect(persistent_signer, id);
+}
+
+struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
+					     const char *key_file,
+					     uint32_t key_algorithm,
+					     const char *external_signer)
+{
+	uint8_t *digest;
+	uint32_t digest_size;
+	int rv;
+
+	if (persist_signers) {
+		rv = vb2_external_signature_submit(data, size, key_file,
+						   key_algorithm,
+						   external_signer);
+		if (rv < 0)
+			return NULL;
+		return vb2_external_signature_collect(rv);
+	}
+
+	digest = signature_digest(data, size, key_algorithm, &digest_size);
+	if (!digest)
+		return NULL;
 
 	/* Allocate output signature */
 	uint32_t sig_size =
 		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
 	struct vb2_signature *sig = vb2_alloc_signature(sig_size, size);
 	if (!sig) {
-		free(signature_digest);
+		free(digest);
 		return NULL;
 	}
 
 	/* Sign the signature_digest into our output buffer */
-	rv = sign_external(signature_digest_len,    /* Input length */
-			   signature_digest,        /* Input data */
+	rv = sign_external(digest_size,             /* Input length */
+			   digest,                  /* Input data */
 			   vb2_signature_data_mutable(sig),  /* Output sig */
 			   sig_size,                /* Max Output sig size */
 			   key_file,                /* Key file to use */
 			   external_signer);        /* External cmd to invoke */
-	free(signature_digest);
+	free(digest);
 
 	if (-1 == rv) {
 		VB2_DEBUG("RSA_private_encrypt() failed.\n");
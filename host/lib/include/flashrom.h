@@ -29,6 +29,34 @@ struct firmware_image {
 	FmapHeader *fmap_header;
 };
 
+struct flashrom_programmer;
+struct flashrom_flashctx;
+
+/*
+ * A flash chip kept open across several flashrom_*_image() and
+ * flashrom_get_wp() calls, so the programmer is only initialized and the chip
+ * is only probed once.  Zero-initialize before the first use, and close with
+ * flashrom_session_close().
+ */
+struct flashrom_session {
+	char *programmer;	/* Programmer the chip was probed with */
+	char *params_buf;	/* Buffer for programmer name and params */
+	struct flashrom_programmer *prog;
+	struct flashrom_flashctx *flashctx;
+	int probes;		/* Number of times a chip was probed */
+	int probes_saved;	/* Calls that reused the already probed chip */
+};
+
+/**
+ * Shut down the programmer opened by a flashrom session.  The session can be
+ * used again afterwards.
+ *
+ * @param session	The session to close.
+ *
+ * @return 0 on success, or non-zero if shutting down the programmer failed.
+ */
+int flashrom_session_close(struct flashrom_session *session);
+
 /**
  * Read using flashrom into an allocated buffer.
  *
@@ -40,8 +68,66 @@ struct firmware_image {
  * @return VB2_SUCCESS on success, or a relevant error.
  */
 vb2_error_t flashrom_read(struct firmware_image *image, const char *region);
-int flashrom_read_image(struct firmware_image *image, const char *region,
-			 int verbosity);
+
+/*
+ * The libflashrom versions take a session which keeps the chip open for the
+ * next call, or NULL to open and close the chip in this call.
+ */
+int flashrom_read_image(struct flashrom_session *session,
+			struct firmware_image *image, const char *region,
+			int verbosity);
+
+/* An FMAP area read from a flash chip by flashrom_read_regions(). */
+struct flashrom_region {
+	char *name;
+	uint32_t offset;	/* Where the area starts on the flash chip */
+	uint32_t size;
+	uint8_t *data;		/* Contents of the area */
+};
+
+/* Some FMAP areas of a flash chip, without the rest of its contents. */
+struct flashrom_regions {
+	uint32_t flash_size;	/* Size of the whole flash chip */
+	int num;
+	struct flashrom_region *regions;
+};
+
+/**
+ * Read only some FMAP areas of a flash chip, into buffers sized for them.
+ *
+ * @param session	Session to keep the chip open, or NULL.
+ * @param programmer	The name of the programmer to use.
+ * @param names		The names of the FMAP areas to read, ended with a NULL
+ *			pointer.
+ * @param regions	Returns the areas read, in the order of names.  Free
+ *			with flashrom_free_regions().
+ * @param verbosity	libflashrom verbosity, or -1 for the default.
+ *
+ * @return 0 on success, or non-zero if error.
+ */
+int flashrom_read_regions(struct flashrom_session *session,
+			  const char *programmer,
+			  const char * const names[],
+			  struct flashrom_regions *regions, int verbosity);
+
+/**
+ * Find data in the areas read by flashrom_read_regions().
+ *
+ * @param regions	The areas read.
+ * @param offset	Offset of the data on the flash chip.
+ * @param size		Size of the data.
+ *
+ * @return The data, or NULL if it is not all inside one area that was read.
+ */
+const uint8_t *flashrom_regions_get(const struct flashrom_regions *regions,
+				    uint32_t offset, uint32_t size);
+
+/**
+ * Free the areas read by flashrom_read_regions().
+ *
+ * @param regions	The areas to free.
+ */
+void flashrom_free_regions(struct flashrom_regions *regions);
 
 /**
  * Write using flashrom from a buffer.
@@ -55,11 +141,38 @@ int flashrom_read_image(struct firmware_image *image, const char *region,
  * @return VB2_SUCCESS on success, or a relevant error.
  */
 vb2_error_t flashrom_write(struct firmware_image *image, const char *region);
-int flashrom_write_image(const struct firmware_image *image,
+int flashrom_write_image(struct flashrom_session *session,
+			const struct firmware_image *image,
 			const char * const regions[],
 			const struct firmware_image *diff_image,
 			int do_verify, int verbosity);
 
+/* A range of bytes on a flash chip, for flashrom_write_ranges(). */
+struct flashrom_range {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/**
+ * Write only some ranges of bytes of an image, instead of FMAP areas.
+ *
+ * @param session	Session to keep the chip open, or NULL.
+ * @param image		The image to write, the same size as the flash chip.
+ * @param ranges	The ranges of the image to write.
+ * @param num_ranges	Number of ranges.
+ * @param diff_image	The current contents of the chip, or NULL to read
+ *			them.
+ * @param do_verify	Verify the ranges after writing.
+ * @param verbosity	libflashrom verbosity, or -1 for the default.
+ *
+ * @return 0 on success, or non-zero if error.
+ */
+int flashrom_write_ranges(struct flashrom_session *session,
+			  const struct firmware_image *image,
+			  const struct flashrom_range *ranges, int num_ranges,
+			  const struct firmware_image *diff_image,
+			  int do_verify, int verbosity);
+
 enum wp_state {
 	WP_ERROR = -1,
 	WP_DISABLED = 0,
@@ -74,4 +187,5 @@ enum wp_state {
  *
  * @return WP_DISABLED, WP_ENABLED, ot a relevant error.
  */
-enum wp_state flashrom_get_wp(const char *programmer, int verbosity);
+enum wp_state flashrom_get_wp(struct flashrom_session *session,
+			      const char *programmer, int verbosity);
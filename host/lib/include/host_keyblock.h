@@ -47,6 +47,40 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 		uint32_t flags,
 		const char *external_signer);
 
+/**
+ * Start creating a keyblock with the persistent external signer, which must
+ * be enabled with vb2_external_signer_persist().  The signature is filled in
+ * by vb2_finish_keyblock_external(), so the signer can work on many keyblocks
+ * at once.
+ *
+ * @param data_key		Data key to store in keyblock
+ * @param signing_key_pem_file	Filename of private key
+ * @param algorithm		Signing algorithm index
+ * @param flags			Keyblock flags
+ * @param external_signer	Path to external signer program
+ * @param id			Set to the ID of the signature request
+ *
+ * @return The unsigned keyblock, or NULL if error.  Caller must free() it.
+ */
+struct vb2_keyblock *vb2_start_keyblock_external(
+		const struct vb2_packed_key *data_key,
+		const char *signing_key_pem_file,
+		uint32_t algorithm,
+		uint32_t flags,
+		const char *external_signer,
+		int *id);
+
+/**
+ * Wait for the signature of a keyblock from vb2_start_keyblock_external(),
+ * and fill it in.
+ *
+ * @param keyblock	Keyblock to sign
+ * @param id		Signature request ID
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_finish_keyblock_external(struct vb2_keyblock *keyblock, int id);
+
 /**
  * Read a keyblock from a .keyblock file.
  *
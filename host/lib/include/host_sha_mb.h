@@ -0,0 +1,43 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host-side multi-buffer hashing: computes the digests of many independent
+ * buffers at once by running one message per SIMD lane.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_SHA_MB_H_
+#define VBOOT_REFERENCE_HOST_SHA_MB_H_
+
+#include "2sha.h"
+
+/* Number of messages hashed in parallel. */
+#define VB2_SHA_MB_LANES 8
+
+/* One independent message to hash. */
+struct vb2_hash_job {
+	/* Data to hash */
+	const void *buf;
+	/* Size of |buf| in bytes */
+	uint32_t size;
+	/* Filled with the digest of |buf| (and the algorithm) on success */
+	struct vb2_hash *hash;
+};
+
+/**
+ * Fill the vb2_hash structure of every job with the hash of its buffer.
+ *
+ * The result for each job is identical to calling vb2_hash_calculate() on it
+ * with HW crypto forbidden. SHA-224/256 and SHA-384/512 messages are hashed
+ * VB2_SHA_MB_LANES at a time; other algorithms, fewer messages than lanes, and
+ * SHA-256 on CPUs with the SHA extension are hashed one by one.
+ *
+ * @param algo		The hash algorithm to use (and store in each hash)
+ * @param jobs		Array of messages to hash
+ * @param count		Number of entries in |jobs|
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+vb2_error_t vb2_hash_calculate_multi(enum vb2_hash_algorithm algo,
+				     struct vb2_hash_job *jobs, size_t count);
+
+#endif  /* VBOOT_REFERENCE_HOST_SHA_MB_H_ */
@@ -11,6 +11,7 @@
 #include "host_key.h"
 #include "vboot_struct.h"
 
+struct vb2_hash;
 struct vb2_private_key;
 struct vb2_signature;
 
@@ -69,6 +70,19 @@ struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size);
 struct vb2_signature *vb2_calculate_signature(
 	const uint8_t *data, uint32_t size, const struct vb2_private_key *key);
 
+/**
+ * Calculate a signature for data that has already been hashed.
+ *
+ * @param hash		Hash of the data; must use the hash algorithm of |key|
+ * @param size		Length of the hashed data in bytes
+ * @param key		Private key to use to sign data
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_create_signature_from_hash(
+	const struct vb2_hash *hash, uint32_t size,
+	const struct vb2_private_key *key);
+
 /**
  * Calculate a signature for the data using an external signer.
  *
@@ -85,4 +99,98 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
 					     uint32_t key_algorithm,
 					     const char *external_signer);
 
+/*
+ * A persistent external signer is started once, with no arguments, and signs
+ * any number of requests.  Each request it reads from stdin is the line
+ *
+ *   SIGN <id> <size> <key_file>
+ *
+ * followed by <size> bytes of DigestInfo to sign with the private key in
+ * <key_file>.  For each request it writes the line "OK <id> <size>" followed by
+ * <size> bytes of signature, or the line "ERR <id>", to stdout.  Requests may
+ * be answered in any order.  The signer exits when stdin is closed.
+ */
+struct vb2_external_signer;
+
+/**
+ * Start a persistent external signer.
+ *
+ * @param external_signer	Path to external signer program
+ *
+ * @return The signer, or NULL if error.  Caller must close it with
+ * vb2_external_signer_close().
+ */
+struct vb2_external_signer *vb2_external_signer_open(
+	const char *external_signer);
+
+/**
+ * Send a request to a persistent external signer, without waiting for the
+ * signature.  Many requests may be in flight at once.
+ *
+ * @param signer		Signer from vb2_external_signer_open()
+ * @param data			Pointer to data to sign
+ * @param size			Length of data in bytes
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ *
+ * @return The request ID, or -1 if error.
+ */
+int vb2_external_signer_submit(struct vb2_external_signer *signer,
+			       const uint8_t *data, uint32_t size,
+			       const char *key_file, uint32_t key_algorithm);
+
+/**
+ * Wait for the signature for a request to a persistent external signer.
+ *
+ * @param signer		Signer from vb2_external_signer_open()
+ * @param id			Request ID from vb2_external_signer_submit()
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_external_signer_collect(
+	struct vb2_external_signer *signer, int id);
+
+/**
+ * Stop a persistent external signer, dropping any uncollected signatures.
+ *
+ * @param signer		Signer from vb2_external_signer_open(), or NULL
+ */
+void vb2_external_signer_close(struct vb2_external_signer *signer);
+
+/**
+ * Make vb2_external_signature() send its requests to a persistent external
+ * signer, which is started the first time it is needed and then kept running.
+ * Disabling this stops the signer.
+ *
+ * @param enable		Use persistent external signers
+ */
+void vb2_external_signer_persist(bool enable);
+
+/**
+ * Send a request for a signature to the persistent external signer used by
+ * vb2_external_signature(), without waiting for the signature.  Only works
+ * while vb2_external_signer_persist() is enabled.  Submitting many requests
+ * before collecting any keeps the signer busy.
+ *
+ * @param data			Pointer to data to sign
+ * @param size			Length of data in bytes
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ * @param external_signer	Path to external signer program
+ *
+ * @return The request ID, or -1 if error.
+ */
+int vb2_external_signature_submit(const uint8_t *data, uint32_t size,
+				  const char *key_file, uint32_t key_algorithm,
+				  const char *external_signer);
+
+/**
+ * Wait for the signature for a request from vb2_external_signature_submit().
+ *
+ * @param id			Request ID
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_external_signature_collect(int id);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
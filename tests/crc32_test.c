@@ -45,3 +45,39 @@ int TestCrc32TestVectors(void) {
 	}
 	return TEST_OK;
 }
+
+int TestCrc32Implementations(void) {
+	/* A full 128-entry partition array, plus room to shift it around */
+	static uint8_t buf[128 * 128 + 64];
+	const uint32_t size = sizeof(buf);
+	uint32_t len, offset, expect;
+	int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (uint8_t)(i * 31 + (i >> 9));
+
+	/* Short buffers hit only the tails; long ones every folding path */
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len < 300; len++) {
+			expect = Crc32Bytewise(buf + offset, len);
+			EXPECT(Crc32Slice8(buf + offset, len) == expect);
+			EXPECT(Crc32(buf + offset, len) == expect);
+		}
+		len = size - 64 - offset;
+		expect = Crc32Bytewise(buf + offset, len);
+		EXPECT(Crc32Slice8(buf + offset, len) == expect);
+		EXPECT(Crc32(buf + offset, len) == expect);
+	}
+
+#ifdef X86_CRC32_DISPATCH
+	if (Crc32PclmulSupported()) {
+		for (len = CRC32_FOLD_MIN_LEN; len < 1024;
+		     len += CRC32_FOLD_ALIGN) {
+			expect = Crc32Bytewise(buf + 3, len);
+			EXPECT(~Crc32PclmulFold(~0U, buf + 3, len) == expect);
+		}
+	}
+#endif
+
+	return TEST_OK;
+}
@@ -0,0 +1,225 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the crossystem property snapshot and utility.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2nvstorage.h"
+#include "common/tests.h"
+#include "crossystem.h"
+#include "crossystem_arch.h"
+#include "host_misc.h"
+
+/* The utility, with its main() renamed so the tests can run it. */
+int crossystem_main(int argc, char *argv[]);
+#define main crossystem_main
+#include "../utility/crossystem.c"
+#undef main
+
+/* The NV storage, and what the mocks were asked to do with it */
+static uint8_t mock_nvdata[VB2_NVDATA_SIZE];
+static int mock_nv_writes;
+static int mock_shared_data_reads;
+static const char *mock_fwid;
+
+static void reset_mocks(void)
+{
+	struct vb2_context ctx = {0};
+
+	/* Start from the defaults, with a valid CRC. */
+	memset(ctx.nvdata, 0, sizeof(ctx.nvdata));
+	vb2_nv_init(&ctx);
+	memcpy(mock_nvdata, ctx.nvdata, sizeof(mock_nvdata));
+	mock_nv_writes = 0;
+	mock_shared_data_reads = 0;
+	mock_fwid = NULL;
+}
+
+/* Mocked architecture functions */
+VbSharedDataHeader *VbSharedDataRead(void)
+{
+	mock_shared_data_reads++;
+	return calloc(1, sizeof(VbSharedDataHeader));
+}
+
+int vb2_read_nv_storage(struct vb2_context *ctx)
+{
+	memcpy(ctx->nvdata, mock_nvdata, sizeof(mock_nvdata));
+	return 0;
+}
+
+int vb2_write_nv_storage(struct vb2_context *ctx)
+{
+	if (!(ctx->flags & VB2_CONTEXT_NVDATA_CHANGED))
+		return 0;
+
+	mock_nv_writes++;
+	memcpy(mock_nvdata, ctx->nvdata, sizeof(mock_nvdata));
+	return 0;
+}
+
+int VbGetArchPropertyInt(const char *name)
+{
+	return -1;
+}
+
+const char *VbGetArchPropertyString(const char *name, char *dest, size_t size)
+{
+	if (mock_fwid && !strcasecmp(name, "fwid"))
+		return StrCopy(dest, mock_fwid, size);
+	return NULL;
+}
+
+int VbSetArchPropertyInt(const char *name, int value)
+{
+	return -1;
+}
+
+int VbSetArchPropertyString(const char *name, const char *value)
+{
+	return -1;
+}
+
+/*
+ * Runs the crossystem utility with the arguments, and returns its exit code.
+ * What it prints is saved in output (to be freed by the caller), if not NULL.
+ */
+static int run_crossystem(char **output, const char *args, ...)
+{
+	char *argv[8] = { NULL };
+	const char *arg;
+	va_list ap;
+	FILE *fp = tmpfile();
+	int argc = 0, saved_stdout, rv, i;
+	long size;
+
+	/* crossystem modifies its arguments, so pass copies. */
+	argv[argc++] = strdup("crossystem");
+	va_start(ap, args);
+	for (arg = args; arg && argc < ARRAY_SIZE(argv) - 1;
+	     arg = va_arg(ap, const char *))
+		argv[argc++] = strdup(arg);
+	va_end(ap);
+
+	fflush(stdout);
+	saved_stdout = dup(STDOUT_FILENO);
+	dup2(fileno(fp), STDOUT_FILENO);
+	rv = crossystem_main(argc, argv);
+	fflush(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+
+	if (output) {
+		size = ftell(fp);
+		*output = calloc(1, size + 1);
+		rewind(fp);
+		if (fread(*output, 1, size, fp) != size)
+			(*output)[0] = '\0';
+	}
+	fclose(fp);
+	for (i = 0; i < argc; i++)
+		free(argv[i]);
+	VbSystemPropertySnapshotEnd();
+	return rv;
+}
+
+static void test_snapshot(void)
+{
+	reset_mocks();
+	VbSystemPropertySnapshotBegin();
+	TEST_EQ(VbGetSystemPropertyInt("dbg_reset"), 0, "Snapshot get");
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 0, "Snapshot get");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 0, "Snapshot get");
+	TEST_EQ(mock_shared_data_reads, 1, "  VbSharedData read once");
+
+	/* Setting a property forgets the values got so far. */
+	TEST_EQ(VbSetSystemPropertyInt("dbg_reset", 1), 0, "Snapshot set");
+	TEST_EQ(mock_nv_writes, 1, "  NV storage written");
+	TEST_EQ(VbGetSystemPropertyInt("dbg_reset"), 1,
+		"  Get after set returns the new value");
+	VbSystemPropertySnapshotEnd();
+
+	/* Same for setting several at once. */
+	VbSystemPropertySnapshotBegin();
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 0, "Snapshot get");
+	TEST_EQ(VbSetSystemProperties(&(VbSystemProperty){
+			.name = "loc_idx", .value = 2 }, 1), 1,
+		"Snapshot set several");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 2,
+		"  Get after set returns the new value");
+	VbSystemPropertySnapshotEnd();
+}
+
+static void test_set_and_check(void)
+{
+	reset_mocks();
+	TEST_EQ(run_crossystem(NULL, "loc_idx=1", "loc_idx?1", NULL), 0,
+		"crossystem a=1 a?1");
+	TEST_NEQ(run_crossystem(NULL, "loc_idx=2", "loc_idx?1", NULL), 0,
+		 "crossystem a=2 a?1");
+	TEST_EQ(run_crossystem(NULL, "loc_idx?2", NULL), 0,
+		"crossystem a?2");
+}
+
+static void test_flush_params(void)
+{
+	reset_mocks();
+	TEST_EQ(run_crossystem(NULL, "loc_idx=3", "fw_try_count=2",
+			       "fw_try_next=B", NULL), 0,
+		"crossystem a=1 b=1 c=1");
+	TEST_EQ(mock_nv_writes, 1, "  NV storage written once");
+	TEST_EQ(run_crossystem(NULL, "loc_idx?3", "fw_try_count?2",
+			       "fw_try_next?B", NULL), 0,
+		"  All values set");
+
+	/* A check in between needs the values set before it. */
+	reset_mocks();
+	TEST_EQ(run_crossystem(NULL, "loc_idx=4", "loc_idx?4", "fw_try_count=3",
+			       NULL), 0,
+		"crossystem a=1 a?1 b=1");
+	TEST_EQ(mock_nv_writes, 2, "  NV storage written before the check");
+}
+
+static void test_json(void)
+{
+	char *output = NULL;
+
+	reset_mocks();
+	mock_fwid = "a\"b\\c\nd\001e/f";
+	TEST_EQ(run_crossystem(&output, "--json", NULL), 0, "crossystem --json");
+	TEST_EQ(output[0], '{', "  Starts an object");
+	TEST_PTR_NEQ(strstr(output, "\n}\n"), NULL, "  Ends the object");
+	TEST_PTR_NEQ(strstr(output, "\n  \"fwid\": \"a\\\"b\\\\c\\nd\\u0001e/f\""),
+		     NULL, "  Strings are escaped");
+	TEST_PTR_NEQ(strstr(output, "\n  \"devsw_cur\": null,"), NULL,
+		     "  Unreadable integers are null");
+	TEST_PTR_NEQ(strstr(output, "\n  \"ecfw_act\": null,"), NULL,
+		     "  Unreadable strings are null");
+	TEST_PTR_NEQ(strstr(output, "\n  \"dbg_reset\": 0,"), NULL,
+		     "  Integers are printed");
+	TEST_PTR_NEQ(strstr(output, "\n  \"fw_try_next\": \"A\","), NULL,
+		     "  Strings are printed");
+	TEST_PTR_NEQ(strstr(output, "\n  \"kern_nv\": 0,"), NULL,
+		     "  Hex integers are printed in decimal");
+	TEST_EQ(mock_shared_data_reads, 1, "  VbSharedData read once");
+	free(output);
+}
+
+int main(int argc, char *argv[])
+{
+	test_snapshot();
+	test_set_and_check();
+	test_flush_params();
+	test_json();
+
+	return gTestSuccess ? 0 : 255;
+}
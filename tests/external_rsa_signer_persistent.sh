@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Copyright 2026 The ChromiumOS Authors.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+# Persistent external signer, for testing.  Reads requests from stdin until
+# it's closed, and answers each one on stdout:
+#
+#   SIGN <id> <size> <private_key_pem_file>   followed by <size> bytes
+#   OK <id> <size>                            followed by <size> bytes
+#   ERR <id>
+#
+# If EXTERNAL_SIGNER_LOG is set, each start and request is logged there.
+
+if [ $# -ne 0 ]; then
+  echo "Usage: $0"
+  echo "Reads signing requests from stdin, signatures are output to stdout"
+  exit 1
+fi
+
+log() {
+  if [ -n "${EXTERNAL_SIGNER_LOG:-}" ]; then
+    echo "$*" >> "${EXTERNAL_SIGNER_LOG}"
+  fi
+}
+
+tmp="$(mktemp -d)"
+trap 'rm -rf "${tmp}"' EXIT
+
+log "start $$"
+while read -r cmd id size key; do
+  if [ "${cmd}" != "SIGN" ]; then
+    exit 1
+  fi
+  log "sign ${id}"
+  # Read exactly the request, leaving the next one on stdin
+  dd bs=1 count="${size}" of="${tmp}/in" 2>/dev/null
+  # pkeyutl adds the DigestInfo itself, so pass it just the digest
+  case "${size}" in
+    35) digest=sha1 ; hash_size=20 ;;
+    51) digest=sha256 ; hash_size=32 ;;
+    67) digest=sha384 ; hash_size=48 ;;
+    83) digest=sha512 ; hash_size=64 ;;
+    *) digest= ;;
+  esac
+  if [ -n "${digest}" ] &&
+      tail -c "${hash_size}" "${tmp}/in" > "${tmp}/digest" &&
+      openssl pkeyutl -sign -inkey "${key}" -in "${tmp}/digest" \
+      -pkeyopt "digest:${digest}" -out "${tmp}/out" 2>/dev/null; then
+    echo "OK ${id} $(stat -c %s "${tmp}/out")"
+    cat "${tmp}/out"
+  else
+    echo "ERR ${id}"
+  fi
+done
@@ -22,6 +22,7 @@ TESTS="
 ${SCRIPT_DIR}/futility/test_create.sh
 ${SCRIPT_DIR}/futility/test_dump_fmap.sh
 ${SCRIPT_DIR}/futility/test_gbb_utility.sh
+${SCRIPT_DIR}/futility/test_gscvd.sh
 ${SCRIPT_DIR}/futility/test_load_fmap.sh
 ${SCRIPT_DIR}/futility/test_main.sh
 ${SCRIPT_DIR}/futility/test_rwsig.sh
@@ -29,6 +30,7 @@ ${SCRIPT_DIR}/futility/test_show_contents.sh
 ${SCRIPT_DIR}/futility/test_show_kernel.sh
 ${SCRIPT_DIR}/futility/test_show_vs_verify.sh
 ${SCRIPT_DIR}/futility/test_show_usbpd1.sh
+${SCRIPT_DIR}/futility/test_sign_batch.sh
 ${SCRIPT_DIR}/futility/test_sign_firmware.sh
 ${SCRIPT_DIR}/futility/test_sign_fw_main.sh
 ${SCRIPT_DIR}/futility/test_sign_kernel.sh
@@ -0,0 +1,108 @@
+#!/bin/bash -eux
+# Copyright 2026 The ChromiumOS Authors
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+KEYDIR="${SRCDIR}/tests/devkeys"
+ROOT_PUBK="${KEYDIR}/arv_root.vbpubk"
+KEYBLOCK="${KEYDIR}/arv_platform.keyblock"
+PLAT_PRIVK="${KEYDIR}/arv_platform.vbprivk"
+
+set -o pipefail
+
+# Prints a little endian number of $2 bytes.
+le() {
+  local i
+  for ((i = 0; i < $2; i++)); do
+    # shellcheck disable=SC2059
+    printf "\\x$(printf %02x $((($1 >> (8 * i)) & 0xff)))"
+  done
+}
+
+# Prints a NUL padded FMAP name.
+fmap_name() {
+  printf "%s" "$1"
+  head -c $((32 - ${#1})) /dev/zero
+}
+
+# Prints an FMAP area: offset, size, name.
+fmap_area() {
+  le "$1" 4
+  le "$2" 4
+  fmap_name "$3"
+  le 0 2
+}
+
+# A 128K image with the FMAP at the start of WP_RO, and RO_GSCVD inside it.
+IMAGE="${TMP}.bin"
+head -c $((0x20000)) /dev/urandom >"${IMAGE}"
+{
+  printf "__FMAP__"
+  le 1 1
+  le 1 1
+  le 0 8
+  le $((0x20000)) 4
+  fmap_name "FMAP"
+  le 4 2
+  fmap_area 0 $((0x10000)) "WP_RO"
+  fmap_area 0 $((0x200)) "FMAP"
+  fmap_area $((0x8000)) $((0x2000)) "RO_GSCVD"
+  fmap_area $((0x10000)) $((0x10000)) "RW_SECTION_A"
+} | dd of="${IMAGE}" conv=notrunc status=none
+cp "${IMAGE}" "${TMP}.orig"
+RANGES="0:8000,a000:6000"
+
+gscvd() {
+  "${FUTILITY}" gscvd --ranges "${RANGES}" --root_pub_key "${ROOT_PUBK}" \
+    --keyblock "${KEYBLOCK}" --platform_priv "${PLAT_PRIVK}" "$@"
+}
+
+# Sign for each Board ID alone, then for all of them at once.
+gscvd --board_id XYZZ --outfile "${TMP}.58595a5a" "${IMAGE}" \
+  | tee "${TMP}.single.out"
+gscvd --board_id 1234abcd --outfile "${TMP}.1234abcd" "${IMAGE}"
+gscvd --board_id XYZZ,1234abcd --outfile "${TMP}.multi" "${IMAGE}"
+for bid in 58595a5a 1234abcd; do
+  cmp "${TMP}.multi.${bid}" "${TMP}.${bid}"
+done
+# The input image is not changed, and --outfile is required.
+cmp "${IMAGE}" "${TMP}.orig"
+[ ! -e "${TMP}.multi" ]
+if gscvd --board_id XYZZ,1234abcd "${IMAGE}"; then false; fi
+
+# Validate several images, with and without the root key hash.
+ROOT_HASH="$(tail -1 "${TMP}.single.out")"
+"${FUTILITY}" gscvd "${TMP}.58595a5a" "${TMP}.1234abcd"
+"${FUTILITY}" gscvd "${TMP}.58595a5a" "${TMP}.1234abcd" "${ROOT_HASH}"
+BAD_HASH="$(echo "${ROOT_HASH}" | tr 0-9a-f 1-9a-f0)"
+if "${FUTILITY}" gscvd "${TMP}.58595a5a" "${BAD_HASH}"; then false; fi
+# A missing file is not taken as the root key hash.
+if "${FUTILITY}" gscvd "${TMP}.58595a5a" "${TMP}.missing"; then false; fi
+
+# An image following a good one with the same keys must still be checked.
+# gsc_flags is in the signed part of the GVD.
+cp "${TMP}.1234abcd" "${TMP}.bad_gvd"
+le 1 4 | dd of="${TMP}.bad_gvd" bs=1 seek=$((0x8000 + 16)) conv=notrunc \
+  status=none
+if "${FUTILITY}" gscvd "${TMP}.58595a5a" "${TMP}.bad_gvd" \
+  2>"${TMP}.bad_gvd.err"; then false; fi
+grep "GVD not signed by platform key" "${TMP}.bad_gvd.err"
+grep "Validation failed: ${TMP}.bad_gvd" "${TMP}.bad_gvd.err"
+
+cp "${TMP}.1234abcd" "${TMP}.bad_range"
+head -c 16 /dev/zero | dd of="${TMP}.bad_range" bs=1 seek=$((0xb000)) \
+  conv=notrunc status=none
+if "${FUTILITY}" gscvd "${TMP}.58595a5a" "${TMP}.bad_range" \
+  2>"${TMP}.bad_range.err"; then false; fi
+grep "Ranges digest mismatch" "${TMP}.bad_range.err"
+grep "Validation failed: ${TMP}.bad_range" "${TMP}.bad_range.err"
+
+# cleanup
+rm -rf "${TMP}"*
+exit 0
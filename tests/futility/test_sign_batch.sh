@@ -0,0 +1,77 @@
+#!/bin/bash -eux
+# Copyright 2026 The ChromiumOS Authors.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+KEYDIR="${SRCDIR}/tests/devkeys"
+
+# Some firmware blobs, signed one at a time
+: > "${TMP}.batch"
+for i in 1 2 3 4 5; do
+  dd bs=1024 count=16 if=/dev/urandom of="${TMP}.fw_main.$i"
+  "${FUTILITY}" sign \
+    --keyset "${KEYDIR}" \
+    --version "$i" \
+    --fv "${TMP}.fw_main.$i" \
+    "${TMP}.vblock.$i"
+  echo "--version $i --fv ${TMP}.fw_main.$i ${TMP}.vblock.batch.$i" \
+    >> "${TMP}.batch"
+done
+
+# Keyblocks too, with the signing key given on each line
+"${FUTILITY}" sign \
+  --datapubkey "${KEYDIR}/firmware_data_key.vbpubk" \
+  --flags 23 \
+  --signprivate "${KEYDIR}/root_key.vbprivk" \
+  --outfile "${TMP}.keyblock"
+cat >> "${TMP}.batch" <<EOF
+
+# Comments and blank lines are skipped
+  --flags 23 --signprivate ${KEYDIR}/root_key.vbprivk --datapubkey ${KEYDIR}/firmware_data_key.vbpubk ${TMP}.keyblock.batch
+EOF
+
+check_batch() {
+  for i in 1 2 3 4 5; do
+    cmp "${TMP}.vblock.$i" "${TMP}.vblock.batch.$i"
+  done
+  cmp "${TMP}.keyblock" "${TMP}.keyblock.batch"
+  cmp "${KEYDIR}/firmware.keyblock" "${TMP}.keyblock.batch"
+  rm -f "${TMP}".*.batch*
+}
+
+# One process
+"${FUTILITY}" sign --keyset "${KEYDIR}" --batch "${TMP}.batch"
+check_batch
+
+# Several processes
+"${FUTILITY}" sign --keyset "${KEYDIR}" --batch "${TMP}.batch" --jobs 3
+check_batch
+
+# From stdin
+"${FUTILITY}" sign --keyset "${KEYDIR}" --batch - < "${TMP}.batch"
+check_batch
+
+# A bad job fails the batch, but the others still get signed
+echo "--version 1 --fv ${TMP}.nonexistent ${TMP}.vblock.bad" >> "${TMP}.batch"
+if "${FUTILITY}" sign --keyset "${KEYDIR}" --batch "${TMP}.batch" \
+    --jobs 2 2> "${TMP}.err"; then
+  false
+fi
+grep -q "1 of 7 batch jobs failed" "${TMP}.err"
+check_batch
+
+# Files to sign only go in the batch file
+if "${FUTILITY}" sign --keyset "${KEYDIR}" --batch "${TMP}.batch" \
+    "${TMP}.fw_main.1"; then
+  false
+fi
+
+# cleanup
+rm -rf "${TMP}"*
+exit 0
@@ -13,6 +13,7 @@ cd "$OUTDIR"
 DEVKEYS=${SRCDIR}/tests/devkeys
 TESTKEYS=${SRCDIR}/tests/testkeys
 SIGNER=${SRCDIR}/tests/external_rsa_signer.sh
+PERSISTENT_SIGNER=${SRCDIR}/tests/external_rsa_signer_persistent.sh
 
 
 # Create a copy of an existing keyblock, using the old way
@@ -104,6 +105,44 @@ cmp "${TMP}.keyblock2" "${TMP}.keyblock3"
 
 cmp "${TMP}.keyblock4" "${TMP}.keyblock5"
 
+# persistent external signer
+export EXTERNAL_SIGNER_LOG="${TMP}.signer.log"
+"${FUTILITY}" --debug sign \
+  --pem_signpriv "${TESTKEYS}/key_rsa4096.pem" \
+  --pem_algo 8 \
+  --pem_external "${PERSISTENT_SIGNER}" \
+  --pem_persistent \
+  --flags 19 \
+  "${DEVKEYS}/firmware_data_key.vbpubk" \
+  "${TMP}.keyblock6"
+
+cmp "${TMP}.keyblock4" "${TMP}.keyblock6"
+
+# a whole batch is signed by one signer, with a bad key failing only its job
+rm -f "${EXTERNAL_SIGNER_LOG}"
+for i in 1 2 3 4 5 6; do
+  echo "${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.keyblock.batch.$i"
+done > "${TMP}.batch"
+echo "--pem_signpriv ${TMP}.nonexistent.pem" \
+  "${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.keyblock.batch.bad" \
+  >> "${TMP}.batch"
+if "${FUTILITY}" sign \
+    --pem_signpriv "${TESTKEYS}/key_rsa4096.pem" \
+    --pem_algo 8 \
+    --pem_external "${PERSISTENT_SIGNER}" \
+    --pem_persistent \
+    --flags 19 \
+    --batch "${TMP}.batch" 2> "${TMP}.err"; then
+  false
+fi
+grep -q "1 of 7 batch jobs failed" "${TMP}.err"
+for i in 1 2 3 4 5 6; do
+  cmp "${TMP}.keyblock4" "${TMP}.keyblock.batch.$i"
+done
+[ "$(grep -c start "${EXTERNAL_SIGNER_LOG}")" = 1 ]
+[ "$(grep -c sign "${EXTERNAL_SIGNER_LOG}")" = 7 ]
+unset EXTERNAL_SIGNER_LOG
+
 
 # cleanup
 rm -rf "${TMP}"*
@@ -265,6 +265,13 @@ test_update "RW update (TPM Anti-rollback: kernel key)" \
 	"${FROM_IMAGE}" "!Firmware version rollback detected (5->4)" \
 	-i "${TO_IMAGE}" --wp=1 --sys_props 1,0x10005,1
 
+# Test --dry-run: the plan is printed but nothing gets written.
+test_update "RW update (--dry-run)" \
+	"${FROM_IMAGE}" "${FROM_IMAGE}" \
+	-i "${TO_IMAGE}" --wp=1 --sys_props 0,0x10001,1 --dry-run
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=1 \
+	--sys_props 0,0x10001,1 --dry-run 2>&1 | grep -q "Would write"
+
 # Test Try-RW update (vboot2).
 test_update "RW update (A->B)" \
 	"${FROM_IMAGE}" "${TMP}.expected.b" \
@@ -455,6 +462,84 @@ mkdir -p "${A}/images"
 mv "${A}/image.bin" "${A}/images/bios_coral.bin"
 cp -f "${PEPPY_BIOS}" "${A}/images/bios_peppy.bin"
 cp -f "${LINK_BIOS}" "${A}/images/bios_link.bin"
+
+echo "TEST: Manifest (--manifest, images with same contents)"
+mkdir -p "${A}/models/link2"
+sed 's/bios_link/bios_link2/' "${A}/models/link/setvars.sh" \
+	>"${A}/models/link2/setvars.sh"
+cp -f "${LINK_BIOS}" "${A}/images/bios_link2.bin"
+"${FUTILITY}" update -a "${A}" --manifest >"${TMP}.json.out"
+sed -n '/^  "link": {/,/^  }/{s/^  "link"/  "link2"/;s/bios_link/bios_link2/;
+	s/^  },$/  }/;p}' "${TMP}.json.out" >"${TMP}.json.link"
+sed -n '/^  "link2": {/,/^  }/{s/^  },$/  }/;p}' "${TMP}.json.out" \
+	>"${TMP}.json.link2"
+cmp "${TMP}.json.link" "${TMP}.json.link2"
+rm -rf "${A}/models/link2" "${A}/images/bios_link2.bin"
+
+echo "TEST: Manifest (--manifest, many models)"
+# Enough models for worker processes (with several CPUs), compared with a
+# serial run of one.
+M="${TMP}.models"
+mkdir -p "${M}/models/link" "${M}/images"
+cp -f "${LINK_BIOS}" "${M}/images/bios_link.bin"
+cp -f "${SCRIPT_DIR}/futility/models/link/setvars.sh" "${M}/models/link/"
+"${FUTILITY}" update -a "${M}" --manifest >"${TMP}.json.serial"
+for n in $(seq 9); do
+	cp -r "${M}/models/link" "${M}/models/link${n}"
+done
+rm -rf "${M}/models/link"
+"${FUTILITY}" update -a "${M}" --manifest >"${TMP}.json.out"
+# Models are listed in directory order, so follow the order printed.
+echo "{" >"${TMP}.json.expected"
+for model in $(sed -n 's/^  "\(link[0-9]\)": {$/\1/p' "${TMP}.json.out"); do
+	[ "$(wc -l <"${TMP}.json.expected")" = 1 ] ||
+		sed -i '$s/$/,/' "${TMP}.json.expected"
+	sed -n "/^  \"link\": {/,/^  }\$/{s/^  \"link\"/  \"${model}\"/;p}" \
+		"${TMP}.json.serial" >>"${TMP}.json.expected"
+done
+echo "}" >>"${TMP}.json.expected"
+[ "$(grep -c '^  "link[0-9]": {$' "${TMP}.json.out")" = 9 ]
+cmp "${TMP}.json.out" "${TMP}.json.expected"
+
+echo "TEST: Manifest (--manifest, tar archive)"
+T="${TMP}.models.tar"
+tar -C "${M}" --sort=name -cf "${T}" models images
+if ! XDG_CACHE_HOME="${TMP}.cache" "${FUTILITY}" update -a "${T}" \
+	--manifest >"${TMP}.json.out" 2>"${TMP}.json.err"; then
+	# Only ZIP works without libarchive.
+	grep "no drivers were selected" "${TMP}.json.err"
+else
+	# Models are listed from the last one in the archive to the first.
+	echo "{" >"${TMP}.json.expected"
+	for n in $(seq 9 -1 1); do
+		[ "${n}" = 9 ] || sed -i '$s/$/,/' "${TMP}.json.expected"
+		sed -n "/^  \"link\": {/,/^  }\$/{s/^  \"link\"/  \"link${n}\"/;p}" \
+			"${TMP}.json.serial" >>"${TMP}.json.expected"
+	done
+	echo "}" >>"${TMP}.json.expected"
+	cmp "${TMP}.json.out" "${TMP}.json.expected"
+
+	# The index is kept in the cache directory for the next run.
+	[ ! -e "${T}.index" ]
+	ls "${TMP}.cache/futility/"*.index
+	XDG_CACHE_HOME="${TMP}.cache" "${FUTILITY}" update -a "${T}" \
+		--manifest >"${TMP}.json.out" 2>"${TMP}.json.err"
+	test -z "$(grep "Loading index" "${TMP}.json.err" || true)"
+	cmp "${TMP}.json.out" "${TMP}.json.expected"
+
+	# A later file with the same name replaces the earlier one.
+	mkdir -p "${TMP}.dup/models/link1"
+	sed 's/^SIGNATURE_ID=.*/SIGNATURE_ID="dup"/' \
+		"${M}/models/link1/setvars.sh" \
+		>"${TMP}.dup/models/link1/setvars.sh"
+	tar -C "${TMP}.dup" -rf "${T}" models/link1/setvars.sh
+	XDG_CACHE_HOME="${TMP}.cache" "${FUTILITY}" update -a "${T}" \
+		--manifest >"${TMP}.json.out"
+	[ "$(grep -c '^  "link[0-9]": {$' "${TMP}.json.out")" = 9 ]
+	sed -n '/^  "link1": {/,/^  }/p' "${TMP}.json.out" |
+		grep '"signature_id": "dup"'
+fi
+
 cp -f "${TMP}.to/rootkey" "${A}/keyset/rootkey.customtip-cl"
 cp -f "${TMP}.to/VBLOCK_A" "${A}/keyset/vblock_A.customtip-cl"
 cp -f "${TMP}.to/VBLOCK_B" "${A}/keyset/vblock_B.customtip-cl"
@@ -181,6 +181,31 @@ X=$("${CGPT}" boot "${MTD[@]}" ${DEV})
 Y=$("${CGPT}" show "${MTD[@]}" -u -i $KERN_NUM $DEV)
 [ "$X" = "$Y" ] || error
 
+echo "Apply many commands in one batch..."
+BATCH_DEV=batch_dev.bin
+cp ${DEV} ${BATCH_DEV}
+cat > batch_script.txt <<EOF
+# Same as the commands below
+add -i ${DATA_NUM} -l "batch data"
+
+add -i ${KERN_NUM} -P 2 -T 5 -S 0
+edit -u ${RANDOM_DRIVE_GUID}
+boot -i ${DATA_NUM}
+prioritize -i ${KERN_NUM}
+EOF
+"${CGPT}" add "${MTD[@]}" -i ${DATA_NUM} -l "batch data" ${DEV}
+"${CGPT}" add "${MTD[@]}" -i ${KERN_NUM} -P 2 -T 5 -S 0 ${DEV}
+"${CGPT}" edit "${MTD[@]}" -u ${RANDOM_DRIVE_GUID} ${DEV}
+"${CGPT}" boot "${MTD[@]}" -i ${DATA_NUM} ${DEV} >/dev/null
+"${CGPT}" prioritize "${MTD[@]}" -i ${KERN_NUM} ${DEV}
+"${CGPT}" batch "${MTD[@]}" batch_script.txt ${BATCH_DEV} >/dev/null
+cmp ${DEV} ${BATCH_DEV} || error
+
+# A failing command leaves the drive unchanged.
+printf 'add -i 1 -l changed\nadd -i 1000 -P 1\n' | \
+  assert_fail "${CGPT}" batch "${MTD[@]}" - ${BATCH_DEV}
+cmp ${DEV} ${BATCH_DEV} || error
+
 # Input: sequence of priorities
 # Output: ${DEV} has kernel partitions with the given priorities
 make_pri() {
@@ -303,6 +328,32 @@ run_prioritize_tests() {
 }
 run_prioritize_tests
 
+echo "Test cgpt find on many devices..."
+# More devices than cgpt searches at once, with kernels on every third one.
+FIND_DEVS=()
+FIND_EXPECTED=""
+for n in $(seq 20); do
+  FIND_DEV="find_dev_${n}.bin"
+  dd if=/dev/zero of=${FIND_DEV} bs=512 count=${NUM_SECTORS} 2>/dev/null
+  "${CGPT}" create "${MTD[@]}" ${FIND_DEV}
+  if [ $((n % 3)) -eq 0 ]; then
+    "${CGPT}" add "${MTD[@]}" -t kernel -l "kern${n}" -b 100 -s 1 ${FIND_DEV}
+    "${CGPT}" add "${MTD[@]}" -t kernel -l "kern${n}b" -b 102 -s 1 ${FIND_DEV}
+    FIND_EXPECTED+="${FIND_DEV}1 ${FIND_DEV}2 "
+  fi
+  FIND_DEVS+=("${FIND_DEV}")
+done
+# Matches come out in the order of the devices given
+X=$("${CGPT}" find "${MTD[@]}" -t kernel "${FIND_DEVS[@]}" | tr '\n' ' ')
+[ "$X" = "${FIND_EXPECTED}" ] || error
+X=$("${CGPT}" find "${MTD[@]}" -l kern12b "${FIND_DEVS[@]}")
+[ "$X" = "find_dev_12.bin2" ] || error
+X=$("${CGPT}" find "${MTD[@]}" -n -1 -l kern12b "${FIND_DEVS[@]}")
+[ "$X" = "2" ] || error
+assert_fail "${CGPT}" find "${MTD[@]}" -1 -t kernel "${FIND_DEVS[@]}"
+assert_fail "${CGPT}" find "${MTD[@]}" -t rootfs "${FIND_DEVS[@]}"
+rm -f "${FIND_DEVS[@]}"
+
 echo "Test cgpt repair command"
 "${CGPT}" repair "${MTD[@]}" ${DEV}
 ("${CGPT}" show "${MTD[@]}" ${DEV} | grep -q INVALID) && error
@@ -515,6 +515,21 @@ static void GetSpaceInfoTest(void)
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_GetCapability, "  cmd");
 	TEST_EQ(attributes, TPM_NV_PER_WRITEDEFINE, "  attributes");
 
+	/* The read lock changes the space info, so isn't served cached. */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	calls[0].rsp = calls[2].rsp = response;
+	calls[0].rsp_size = calls[2].rsp_size = sizeof(response);
+	TEST_EQ(TlclGetPermissions(0x20000004, &attributes),
+		TPM_SUCCESS, "GetPermissions cached");
+	TEST_EQ(TlclReadLock(0x20000004), TPM_SUCCESS, "  ReadLock");
+	TEST_EQ(calls[1].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
+	TEST_EQ(TlclGetPermissions(0x20000004, &attributes),
+		TPM_SUCCESS, "  GetPermissions after ReadLock");
+	TEST_EQ(ncalls, 3, "  sent");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_GetCapability, "  cmd");
+	TlclEnableResponseCache(0);
+
 	/* Test whether a short response gets detected. */
 	ResetMocks();
 	calls[0].rsp = response;
@@ -577,6 +592,95 @@ static void FlagsTest(void)
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_GetCapability, "  cmd");
 }
 
+/**
+ * Test the response cache and round trip counters
+ */
+static void CacheTest(void)
+{
+	TPM_PERMANENT_FLAGS pflags;
+	TPM_STCLEAR_FLAGS vflags;
+	struct tlcl_stats before, after;
+	uint8_t response[kTpmResponseHeaderLength + sizeof(uint32_t) +
+			 sizeof(TPM_PERMANENT_FLAGS)];
+	uint8_t buf[4];
+	int i;
+
+	ToTpmUint16(response, TPM_TAG_RSP_COMMAND);
+	ToTpmUint32(response + 2, sizeof(response));
+	ToTpmUint32(response + 6, TPM_SUCCESS);
+	ToTpmUint32(response + kTpmResponseHeaderLength,
+		    sizeof(TPM_PERMANENT_FLAGS));
+	for (i = kTpmResponseHeaderLength + sizeof(uint32_t);
+	     i < sizeof(response); i++)
+		response[i] = i;
+
+	/* Disabled by default */
+	ResetMocks();
+	TlclGetStats(&before);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache disabled");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  again");
+	TEST_EQ(ncalls, 2, "  both sent");
+	TlclGetStats(&after);
+	TEST_EQ(after.round_trips - before.round_trips, 2, "  round trips");
+	TEST_EQ(after.cache_hits - before.cache_hits, 0, "  no cache hits");
+
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	for (i = 0; i < MAXCALLS; i++) {
+		calls[i].rsp = response;
+		calls[i].rsp_size = sizeof(response);
+	}
+	TlclGetStats(&before);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache miss");
+	TEST_EQ(ncalls, 1, "  sent");
+	memset(&pflags, 0, sizeof(pflags));
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache hit");
+	TEST_EQ(ncalls, 1, "  not sent");
+	TEST_EQ(memcmp(&pflags, response + kTpmResponseHeaderLength +
+		       sizeof(uint32_t), sizeof(pflags)), 0, "  flags");
+	TlclGetStats(&after);
+	TEST_EQ(after.round_trips - before.round_trips, 1, "  round trips");
+	TEST_EQ(after.cache_hits - before.cache_hits, 1, "  cache hits");
+
+	/* Different requests are cached separately */
+	TEST_EQ(TlclGetSTClearFlags(&vflags), 0, "Other request");
+	TEST_EQ(ncalls, 2, "  sent");
+
+	/* Reads leave the cache alone, writes empty it */
+	ToTpmUint32(response + kTpmResponseHeaderLength, 0);
+	TEST_EQ(TlclRead(0x1007, buf, sizeof(buf)), 0, "Read");
+	ToTpmUint32(response + kTpmResponseHeaderLength,
+		    sizeof(TPM_PERMANENT_FLAGS));
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags cached");
+	TEST_EQ(ncalls, 3, "  not sent");
+	TEST_EQ(TlclWrite(0x1007, buf, sizeof(buf)), 0, "Write");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags not cached");
+	TEST_EQ(ncalls, 5, "  sent");
+
+	/* Failed responses aren't cached */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	calls[0].rsp = response;
+	calls[0].rsp_size = sizeof(response);
+	ToTpmUint32(response + 6, TPM_E_IOERROR);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), TPM_E_IOERROR, "Cache error");
+	ToTpmUint32(response + 6, TPM_SUCCESS);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  not cached");
+	TEST_EQ(ncalls, 2, "  sent");
+
+	/* Closing the library empties the cache */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	calls[0].rsp = calls[1].rsp = response;
+	calls[0].rsp_size = calls[1].rsp_size = sizeof(response);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache before close");
+	TEST_EQ(TlclLibClose(), 0, "  close");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags not cached");
+	TEST_EQ(ncalls, 2, "  sent");
+
+	TlclEnableResponseCache(0);
+}
+
 /**
  * Test random
  *
@@ -1162,6 +1266,7 @@ int main(void)
 	PcrTest();
 	GetSpaceInfoTest();
 	FlagsTest();
+	CacheTest();
 	RandomTest();
 	GetVersionTest();
 	IFXFieldUpgradeInfoTest();
@@ -0,0 +1,232 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests and microbenchmark for TPM2 command marshaling
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "2common.h"
+#include "common/tests.h"
+#include "common/timer_utils.h"
+#include "tpm2_marshaling.h"
+
+#define BENCHMARK_ITERATIONS 1000000
+
+static const uint8_t nv_read_cmd[] = {
+	0x80, 0x02, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00,
+	0x01, 0x4e, 0x40, 0x00, 0x00, 0x0c, 0x00, 0x00,
+	0x10, 0x07, 0x00, 0x00, 0x00, 0x09, 0x40, 0x00,
+	0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x0d, 0x00, 0x02,
+};
+
+static const uint8_t nv_read_ph_disabled_cmd[] = {
+	0x80, 0x02, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00,
+	0x01, 0x4e, 0x00, 0x00, 0x10, 0x07, 0x00, 0x00,
+	0x10, 0x07, 0x00, 0x00, 0x00, 0x09, 0x40, 0x00,
+	0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x0d, 0x00, 0x02,
+};
+
+static const uint8_t get_capability_cmd[] = {
+	0x80, 0x01, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+	0x01, 0x7a, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+};
+
+static const uint8_t pcr_extend_cmd[] = {
+	0x80, 0x02, 0x00, 0x00, 0x00, 0x41, 0x00, 0x00,
+	0x01, 0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x0b, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e,
+	0x1f,
+};
+
+static const uint8_t nv_read_response[] = {
+	0x80, 0x02, 0x00, 0x00, 0x00, 0x19, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x04,
+	0xaa, 0xbb, 0xcc, 0xdd, 0x00, 0x00, 0x01, 0x00,
+	0x00,
+};
+
+static struct tpm2_nv_read_cmd nv_read = {
+	.nvIndex = 0x1007,
+	.size = 13,
+	.offset = 2,
+};
+
+static struct tpm2_get_capability_cmd get_capability = {
+	.capability = TPM_CAP_TPM_PROPERTIES,
+	.property = TPM_PT_PERMANENT,
+	.property_count = 1,
+};
+
+static struct tpm2_pcr_extend_cmd pcr_extend;
+
+static void reset_pcr_extend(void)
+{
+	int i;
+
+	memset(&pcr_extend, 0, sizeof(pcr_extend));
+	pcr_extend.digests.count = 1;
+	pcr_extend.digests.digests[0].hashAlg = TPM_ALG_SHA256;
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		pcr_extend.digests.digests[0].digest.sha256[i] = i;
+}
+
+static void marshal_tests(void)
+{
+	uint8_t buf[TPM_BUFFER_SIZE];
+
+	TEST_EQ(tpm_marshal_command(TPM2_NV_Read, &nv_read, buf, sizeof(buf)),
+		sizeof(nv_read_cmd), "NV_Read size");
+	TEST_SUCC(memcmp(buf, nv_read_cmd, sizeof(nv_read_cmd)),
+		  "  bytes");
+
+	tpm_set_ph_disabled(1);
+	TEST_EQ(tpm_marshal_command(TPM2_NV_Read, &nv_read, buf, sizeof(buf)),
+		sizeof(nv_read_ph_disabled_cmd),
+		"NV_Read with platform hierarchy disabled size");
+	TEST_SUCC(memcmp(buf, nv_read_ph_disabled_cmd,
+			 sizeof(nv_read_ph_disabled_cmd)), "  bytes");
+	tpm_set_ph_disabled(0);
+
+	TEST_EQ(tpm_marshal_command(TPM2_NV_Read, &nv_read, buf,
+				    sizeof(nv_read_cmd) - 1), -1,
+		"NV_Read buffer too small");
+
+	TEST_EQ(tpm_marshal_command(TPM2_GetCapability, &get_capability, buf,
+				    sizeof(buf)),
+		sizeof(get_capability_cmd), "GetCapability size");
+	TEST_SUCC(memcmp(buf, get_capability_cmd, sizeof(get_capability_cmd)),
+		  "  bytes");
+
+	reset_pcr_extend();
+	TEST_EQ(tpm_marshal_command(TPM2_PCR_Extend, &pcr_extend, buf,
+				    sizeof(buf)),
+		sizeof(pcr_extend_cmd), "PCR_Extend size");
+	TEST_SUCC(memcmp(buf, pcr_extend_cmd, sizeof(pcr_extend_cmd)),
+		  "  bytes");
+
+	/* A digest count other than one is marshaled field by field. */
+	pcr_extend.digests.count = 0;
+	TEST_EQ(tpm_marshal_command(TPM2_PCR_Extend, &pcr_extend, buf,
+				    sizeof(buf)),
+		sizeof(pcr_extend_cmd) - 2 - SHA256_DIGEST_SIZE,
+		"PCR_Extend with no digests size");
+	TEST_EQ(buf[30], 0, "  digest count");
+	pcr_extend.digests.count = 1;
+
+	/* So is a digest other than SHA256, which isn't supported. */
+	pcr_extend.digests.digests[0].hashAlg = TPM_ALG_SHA1;
+	TEST_EQ(tpm_marshal_command(TPM2_PCR_Extend, &pcr_extend, buf,
+				    sizeof(buf)), -1,
+		"PCR_Extend with SHA1 digest");
+}
+
+/* Checks that the template gives the same bytes as the field marshaler. */
+static void check_same_as_fields(const char *name, TPM_CC command,
+				 void *body)
+{
+	uint8_t buf[TPM_BUFFER_SIZE];
+	uint8_t fields_buf[TPM_BUFFER_SIZE];
+	int size;
+
+	size = tpm_marshal_command_fields(command, body, fields_buf,
+					  sizeof(fields_buf));
+	TEST_EQ(tpm_marshal_command(command, body, buf, sizeof(buf)), size,
+		name);
+	TEST_SUCC(memcmp(buf, fields_buf, size), "  same bytes as fields");
+}
+
+static void template_tests(void)
+{
+	struct tpm2_nv_read_cmd nv_read_max = {
+		.nvIndex = 0xffffffff,
+		.size = 0xffff,
+		.offset = 0xffff,
+	};
+
+	check_same_as_fields("NV_Read template", TPM2_NV_Read, &nv_read);
+	check_same_as_fields("NV_Read template with max fields", TPM2_NV_Read,
+			     &nv_read_max);
+	tpm_set_ph_disabled(1);
+	check_same_as_fields("NV_Read template with platform hierarchy "
+			     "disabled", TPM2_NV_Read, &nv_read_max);
+	tpm_set_ph_disabled(0);
+	check_same_as_fields("GetCapability template", TPM2_GetCapability,
+			     &get_capability);
+	reset_pcr_extend();
+	pcr_extend.pcrHandle = 0x10;
+	check_same_as_fields("PCR_Extend template", TPM2_PCR_Extend,
+			     &pcr_extend);
+}
+
+static void unmarshal_tests(void)
+{
+	uint8_t buf[sizeof(nv_read_response)];
+	struct tpm2_response response;
+
+	memcpy(buf, nv_read_response, sizeof(buf));
+	TEST_SUCC(tpm_unmarshal_response(TPM2_NV_Read, buf, sizeof(buf),
+					 &response), "NV_Read response");
+	TEST_EQ(response.hdr.tpm_code, TPM_SUCCESS, "  code");
+	TEST_EQ(response.nvr.buffer.t.size, 4, "  size");
+	TEST_PTR_EQ(response.nvr.buffer.t.buffer, buf + 16,
+		    "  parsed in place");
+}
+
+typedef int (*marshal_fn)(TPM_CC command, void *tpm_command_body,
+			  void *buffer, int buffer_size);
+
+static uint32_t time_marshal(marshal_fn marshal, TPM_CC command, void *body)
+{
+	uint8_t buf[TPM_BUFFER_SIZE];
+	ClockTimerState ct;
+	int i;
+
+	StartTimer(&ct);
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		marshal(command, body, buf, sizeof(buf));
+	StopTimer(&ct);
+
+	return (uint32_t)((uint64_t)GetDurationMsecs(&ct) * 1000000 /
+			  BENCHMARK_ITERATIONS);
+}
+
+static void benchmark_command(const char *name, TPM_CC command, void *body)
+{
+	uint32_t fields_ns = time_marshal(tpm_marshal_command_fields,
+					  command, body);
+	uint32_t template_ns = time_marshal(tpm_marshal_command, command,
+					    body);
+
+	fprintf(stderr, "# %s: %u ns per command field by field, "
+		"%u ns from template\n", name, fields_ns, template_ns);
+}
+
+static void benchmark(void)
+{
+	reset_pcr_extend();
+	benchmark_command("NV_Read", TPM2_NV_Read, &nv_read);
+	benchmark_command("GetCapability", TPM2_GetCapability,
+			  &get_capability);
+	benchmark_command("PCR_Extend", TPM2_PCR_Extend, &pcr_extend);
+}
+
+int main(int argc, char *argv[])
+{
+	marshal_tests();
+	template_tests();
+	unmarshal_tests();
+	benchmark();
+
+	return gTestSuccess ? 0 : 255;
+}
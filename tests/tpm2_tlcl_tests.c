@@ -0,0 +1,188 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the TPM 2.0 lightweight command library response cache
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "2api.h"
+#include "common/tests.h"
+#include "tlcl.h"
+#include "tlcl_internal.h"
+#include "tpm2_tss_constants.h"
+
+#define TPM_HEADER_SIZE 10
+
+/* Value of the TPM properties returned by the mocked TPM */
+static uint32_t mock_property_value;
+static uint32_t mock_response_code;
+static int ncalls;
+static uint32_t last_command;
+
+static void ResetMocks(void)
+{
+	TlclEnableResponseCache(0);
+	mock_property_value = 0x12345678;
+	mock_response_code = TPM_SUCCESS;
+	ncalls = 0;
+	last_command = 0;
+}
+
+/* Mocks */
+
+vb2_error_t vb2ex_tpm_init(void)
+{
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_tpm_close(void)
+{
+	return VB2_SUCCESS;
+}
+
+uint32_t vb2ex_tpm_send_recv(const uint8_t *request, uint32_t request_length,
+			     uint8_t *response, uint32_t *response_length)
+{
+	uint32_t size = TPM_HEADER_SIZE;
+	uint32_t property;
+
+	ncalls++;
+	FromTpmUint32(request + 6, &last_command);
+
+	if (mock_response_code == TPM_SUCCESS &&
+	    last_command == TPM2_GetCapability) {
+		/* more_data, capability, count, then the property asked for */
+		FromTpmUint32(request + TPM_HEADER_SIZE + 4, &property);
+		response[size++] = 0;
+		ToTpmUint32(response + size, TPM_CAP_TPM_PROPERTIES);
+		ToTpmUint32(response + size + 4, 1);
+		ToTpmUint32(response + size + 8, property);
+		ToTpmUint32(response + size + 12, mock_property_value);
+		size += 16;
+	} else if (mock_response_code == TPM_SUCCESS &&
+		   last_command == TPM2_NV_Read) {
+		/* Parameter size, the data, then an empty auth session */
+		ToTpmUint32(response + size, 6);
+		ToTpmUint16(response + size + 4, 4);
+		memset(response + size + 6, 0xa5, 4);
+		memset(response + size + 10, 0, 5);
+		size += 15;
+	} else if (mock_response_code == TPM_SUCCESS &&
+		   last_command == TPM2_GetRandom) {
+		ToTpmUint16(response + size, 4);
+		memset(response + size + 2, 0xa5, 4);
+		size += 6;
+	}
+
+	ToTpmUint16(response, TPM_ST_NO_SESSIONS);
+	ToTpmUint32(response + 2, size);
+	ToTpmUint32(response + 6, mock_response_code);
+	*response_length = size;
+	return TPM_SUCCESS;
+}
+
+static void CachePolicyTest(void)
+{
+	TPM_PERMANENT_FLAGS pflags;
+	TPM_STCLEAR_FLAGS vflags;
+	struct tlcl_stats before, after;
+	uint8_t read_public[14];
+	uint8_t response[64];
+	uint8_t buf[4];
+	uint32_t size;
+
+	ToTpmUint16(read_public, TPM_ST_NO_SESSIONS);
+	ToTpmUint32(read_public + 2, sizeof(read_public));
+	ToTpmUint32(read_public + 6, TPM2_NV_ReadPublic);
+	ToTpmUint32(read_public + 10, HR_NV_INDEX + 0x1007);
+
+	/* Disabled by default */
+	ResetMocks();
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache disabled");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  again");
+	TEST_EQ(ncalls, 2, "  both sent");
+
+	/* GetCapability is cached */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	TlclGetStats(&before);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "GetCapability cache miss");
+	TEST_EQ(ncalls, 1, "  sent");
+	mock_property_value = 0;
+	memset(&pflags, 0, sizeof(pflags));
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "GetCapability cache hit");
+	TEST_EQ(ncalls, 1, "  not sent");
+	TEST_EQ(*(uint32_t *)&pflags, 0x12345678, "  cached flags");
+	TlclGetStats(&after);
+	TEST_EQ(after.round_trips - before.round_trips, 1, "  round trips");
+	TEST_EQ(after.cache_hits - before.cache_hits, 1, "  cache hits");
+
+	/* Other properties are cached separately */
+	TEST_EQ(TlclGetSTClearFlags(&vflags), 0, "Other property");
+	TEST_EQ(ncalls, 2, "  sent");
+	TEST_EQ(*(uint32_t *)&vflags, 0, "  its own value");
+
+	/* NV_ReadPublic is cached */
+	TEST_EQ(TlclSendReceive(read_public, response, sizeof(response)), 0,
+		"NV_ReadPublic cache miss");
+	TEST_EQ(TlclSendReceive(read_public, response, sizeof(response)), 0,
+		"NV_ReadPublic cache hit");
+	TEST_EQ(ncalls, 3, "  sent once");
+
+	/* NV_Read and GetRandom are neither cached nor empty the cache */
+	TEST_EQ(TlclRead(0x1007, buf, sizeof(buf)), 0, "NV_Read");
+	TEST_EQ(TlclRead(0x1007, buf, sizeof(buf)), 0, "  again");
+	TEST_EQ(ncalls, 5, "  both sent");
+	TEST_EQ(TlclGetRandom(buf, sizeof(buf), &size), 0, "GetRandom");
+	TEST_EQ(TlclGetRandom(buf, sizeof(buf), &size), 0, "  again");
+	TEST_EQ(ncalls, 7, "  both sent");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags still cached");
+	TEST_EQ(TlclSendReceive(read_public, response, sizeof(response)), 0,
+		"  space info still cached");
+	TEST_EQ(ncalls, 7, "  not sent");
+
+	/* Any other command empties the cache */
+	TEST_EQ(TlclWrite(0x1007, buf, sizeof(buf)), 0, "NV_Write");
+	TEST_EQ(last_command, TPM2_NV_Write, "  sent");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags not cached");
+	TEST_EQ(TlclSendReceive(read_public, response, sizeof(response)), 0,
+		"  space info not cached");
+	TEST_EQ(ncalls, 10, "  sent");
+
+	/* So do commands sent by other functions */
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Flags cached");
+	TEST_EQ(TlclForceClear(), 0, "TPM2_Clear");
+	TEST_EQ(last_command, TPM2_Clear, "  sent");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags not cached");
+	TEST_EQ(ncalls, 12, "  sent");
+
+	/* Failed responses aren't cached */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	mock_response_code = TPM_E_IOERROR;
+	TEST_EQ(TlclGetPermanentFlags(&pflags), TPM_E_IOERROR, "Cache error");
+	mock_response_code = TPM_SUCCESS;
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  not cached");
+	TEST_EQ(ncalls, 2, "  sent");
+
+	/* Closing the library empties the cache */
+	ResetMocks();
+	TlclEnableResponseCache(1);
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "Cache before close");
+	TEST_EQ(TlclLibClose(), 0, "  close");
+	TEST_EQ(TlclGetPermanentFlags(&pflags), 0, "  flags not cached");
+	TEST_EQ(ncalls, 2, "  sent");
+
+	TlclEnableResponseCache(0);
+}
+
+int main(void)
+{
+	CachePolicyTest();
+
+	return gTestSuccess ? 0 : 255;
+}
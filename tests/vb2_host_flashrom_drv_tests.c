@@ -0,0 +1,398 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host libflashrom utilities.
+ */
+
+#include <libflashrom.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2common.h"
+#include "common/tests.h"
+#include "flashrom.h"
+
+#define MOCK_FLASH_SIZE 0x1000
+
+/* Mock data */
+static struct flashrom_programmer *mock_prog =
+	(struct flashrom_programmer *)0x1234;
+static struct flashrom_flashctx *mock_flashctx =
+	(struct flashrom_flashctx *)0x5678;
+static struct flashrom_layout *mock_layout =
+	(struct flashrom_layout *)0x9abc;
+
+static int mock_programmer_inits;
+static int mock_programmer_shutdowns;
+static int mock_probes;
+static int mock_flash_releases;
+static int mock_reads;
+static int mock_writes;
+static int mock_read_retval;
+static int mock_wp_mode;
+static char mock_programmer_name[64];
+static char mock_programmer_params[64];
+static const struct flashrom_layout *mock_layout_set;
+static int mock_num_added;
+static size_t mock_added_start[4], mock_added_end[4];
+
+static void reset_common_data(void)
+{
+	mock_programmer_inits = 0;
+	mock_programmer_shutdowns = 0;
+	mock_probes = 0;
+	mock_flash_releases = 0;
+	mock_reads = 0;
+	mock_writes = 0;
+	mock_read_retval = 0;
+	mock_wp_mode = FLASHROM_WP_MODE_DISABLED;
+	mock_programmer_name[0] = '\0';
+	mock_programmer_params[0] = '\0';
+	mock_layout_set = NULL;
+	mock_num_added = 0;
+}
+
+/* Mocks */
+int flashrom_init(int perform_selfcheck)
+{
+	return 0;
+}
+
+void flashrom_set_log_callback(flashrom_log_callback *log_callback)
+{
+}
+
+int flashrom_programmer_init(struct flashrom_programmer **prog,
+			     const char *prog_name, const char *prog_params)
+{
+	mock_programmer_inits++;
+	strncpy(mock_programmer_name, prog_name,
+		sizeof(mock_programmer_name) - 1);
+	strncpy(mock_programmer_params, prog_params ? prog_params : "",
+		sizeof(mock_programmer_params) - 1);
+	*prog = mock_prog;
+	return 0;
+}
+
+int flashrom_programmer_shutdown(struct flashrom_programmer *prog)
+{
+	mock_programmer_shutdowns++;
+	return 0;
+}
+
+int flashrom_flash_probe(struct flashrom_flashctx **flashctx,
+			 const struct flashrom_programmer *prog,
+			 const char *chip_name)
+{
+	mock_probes++;
+	*flashctx = mock_flashctx;
+	return 0;
+}
+
+size_t flashrom_flash_getsize(const struct flashrom_flashctx *flashctx)
+{
+	return MOCK_FLASH_SIZE;
+}
+
+void flashrom_flash_release(struct flashrom_flashctx *flashctx)
+{
+	mock_flash_releases++;
+}
+
+void flashrom_flag_set(struct flashrom_flashctx *flashctx,
+		       enum flashrom_flag flag, bool value)
+{
+}
+
+int flashrom_image_read(struct flashrom_flashctx *flashctx, void *buffer,
+			size_t buffer_len)
+{
+	uint8_t *buf = buffer;
+	int i;
+
+	mock_reads++;
+	for (i = 0; i < buffer_len; i++)
+		buf[i] = i * 7;
+	return mock_read_retval;
+}
+
+int flashrom_image_write(struct flashrom_flashctx *flashctx, void *buffer,
+			 size_t buffer_len, const void *refbuffer)
+{
+	mock_writes++;
+	return 0;
+}
+
+int flashrom_layout_read_fmap_from_rom(struct flashrom_layout **layout,
+				       struct flashrom_flashctx *flashctx,
+				       size_t offset, size_t length)
+{
+	*layout = mock_layout;
+	return 0;
+}
+
+int flashrom_layout_read_fmap_from_buffer(struct flashrom_layout **layout,
+					  struct flashrom_flashctx *flashctx,
+					  const uint8_t *buf, size_t len)
+{
+	*layout = mock_layout;
+	return 0;
+}
+
+int flashrom_layout_new(struct flashrom_layout **layout)
+{
+	*layout = mock_layout;
+	return 0;
+}
+
+int flashrom_layout_add_region(struct flashrom_layout *layout, size_t start,
+			       size_t end, const char *name)
+{
+	if (mock_num_added >= ARRAY_SIZE(mock_added_start))
+		return 1;
+	mock_added_start[mock_num_added] = start;
+	mock_added_end[mock_num_added] = end;
+	mock_num_added++;
+	return 0;
+}
+
+int flashrom_layout_include_region(struct flashrom_layout *layout,
+				   const char *name)
+{
+	return 0;
+}
+
+int flashrom_layout_get_region_range(struct flashrom_layout *layout,
+				     const char *name, unsigned int *start,
+				     unsigned int *len)
+{
+	if (!strcmp(name, "RO_FRID")) {
+		*start = 0x100;
+		*len = 0x40;
+	} else if (!strcmp(name, "GBB")) {
+		*start = 0x800;
+		*len = 0x200;
+	} else {
+		return 1;
+	}
+	return 0;
+}
+
+void flashrom_layout_release(struct flashrom_layout *layout)
+{
+}
+
+void flashrom_layout_set(struct flashrom_flashctx *flashctx,
+			 const struct flashrom_layout *layout)
+{
+	mock_layout_set = layout;
+}
+
+enum flashrom_wp_result flashrom_wp_cfg_new(struct flashrom_wp_cfg **cfg)
+{
+	*cfg = (struct flashrom_wp_cfg *)0xdef0;
+	return FLASHROM_WP_OK;
+}
+
+void flashrom_wp_cfg_release(struct flashrom_wp_cfg *cfg)
+{
+}
+
+enum flashrom_wp_mode flashrom_wp_get_mode(const struct flashrom_wp_cfg *cfg)
+{
+	return mock_wp_mode;
+}
+
+enum flashrom_wp_result flashrom_wp_read_cfg(struct flashrom_wp_cfg *cfg,
+					     struct flashrom_flashctx *flashctx)
+{
+	return FLASHROM_WP_OK;
+}
+
+static void free_image(struct firmware_image *image)
+{
+	free(image->data);
+	free(image->file_name);
+	image->data = NULL;
+	image->file_name = NULL;
+}
+
+static void one_shot_tests(void)
+{
+	struct firmware_image image = {
+		.programmer = "raiden_debug_spi:target=AP",
+	};
+
+	reset_common_data();
+	TEST_SUCC(flashrom_read_image(NULL, &image, NULL, -1),
+		  "Read without a session");
+	TEST_EQ(mock_probes, 1, "  probed");
+	TEST_EQ(mock_programmer_shutdowns, 1, "  shut down");
+	TEST_EQ(mock_flash_releases, 1, "  released chip");
+	TEST_STR_EQ(mock_programmer_name, "raiden_debug_spi", "  programmer");
+	TEST_STR_EQ(mock_programmer_params, "target=AP", "  params");
+	TEST_EQ(image.size, MOCK_FLASH_SIZE, "  size");
+
+	TEST_SUCC(flashrom_write_image(NULL, &image, NULL, NULL, 1, -1),
+		  "Write without a session");
+	TEST_EQ(mock_probes, 2, "  probed again");
+	TEST_EQ(mock_programmer_shutdowns, 2, "  shut down");
+
+	mock_wp_mode = FLASHROM_WP_MODE_HARDWARE;
+	TEST_EQ(flashrom_get_wp(NULL, "raiden_debug_spi:target=AP", -1),
+		WP_ENABLED, "WP without a session");
+	TEST_EQ(mock_probes, 3, "  probed again");
+	TEST_EQ(mock_programmer_shutdowns, 3, "  shut down");
+	TEST_STR_EQ(mock_programmer_name, "raiden_debug_spi", "  programmer");
+
+	free_image(&image);
+}
+
+static void session_tests(void)
+{
+	struct flashrom_session session = {0};
+	struct firmware_image image = {.programmer = "host"};
+	struct firmware_image ec_image = {.programmer = "ec"};
+	const char * const regions[] = {"RW_SECTION_A", NULL};
+
+	reset_common_data();
+	TEST_SUCC(flashrom_read_image(&session, &image, NULL, -1),
+		  "Read with a session");
+	TEST_EQ(flashrom_get_wp(&session, "host", -1), WP_DISABLED,
+		"WP with a session");
+	TEST_SUCC(flashrom_write_image(&session, &image, regions, NULL, 1, -1),
+		  "Write with a session");
+	TEST_EQ(mock_reads, 1, "  read");
+	TEST_EQ(mock_writes, 1, "  written");
+	TEST_EQ(mock_probes, 1, "  probed once");
+	TEST_EQ(mock_programmer_shutdowns, 0, "  still open");
+	TEST_EQ(session.probes, 1, "  probes counted");
+	TEST_EQ(session.probes_saved, 2, "  saved probes counted");
+	TEST_PTR_EQ(mock_layout_set, NULL, "  layout cleared");
+
+	/* Another programmer shuts down the first one */
+	TEST_SUCC(flashrom_read_image(&session, &ec_image, NULL, -1),
+		  "Read another programmer");
+	TEST_EQ(mock_probes, 2, "  probed");
+	TEST_EQ(mock_programmer_shutdowns, 1, "  shut down the first");
+	TEST_STR_EQ(mock_programmer_name, "ec", "  programmer");
+
+	/* A failed call closes the session, so a retry probes again */
+	free_image(&ec_image);
+	mock_read_retval = 1;
+	TEST_NEQ(flashrom_read_image(&session, &ec_image, NULL, -1), 0,
+		 "Read fails");
+	TEST_EQ(mock_programmer_shutdowns, 2, "  shut down");
+	TEST_PTR_EQ(session.flashctx, NULL, "  session closed");
+	mock_read_retval = 0;
+	free_image(&ec_image);
+	TEST_SUCC(flashrom_read_image(&session, &ec_image, NULL, -1),
+		  "Read retry");
+	TEST_EQ(mock_probes, 3, "  probed again");
+
+	TEST_SUCC(flashrom_session_close(&session), "Close session");
+	TEST_EQ(mock_programmer_shutdowns, 3, "  shut down");
+	TEST_EQ(mock_flash_releases, 3, "  released chip");
+	TEST_PTR_EQ(session.programmer, NULL, "  programmer cleared");
+	TEST_SUCC(flashrom_session_close(&session), "Close again");
+	TEST_EQ(mock_programmer_shutdowns, 3, "  nothing to shut down");
+
+	free_image(&image);
+	free_image(&ec_image);
+}
+
+static void read_regions_tests(void)
+{
+	struct flashrom_session session = {0};
+	struct flashrom_regions regions;
+	const char * const names[] = {"GBB", "RO_FRID", NULL};
+	const char * const bad_names[] = {"GBB", "NO_SUCH_AREA", NULL};
+	const uint8_t *p;
+
+	reset_common_data();
+	TEST_SUCC(flashrom_read_regions(&session, "host", names, &regions, -1),
+		  "Read regions");
+	TEST_EQ(regions.flash_size, MOCK_FLASH_SIZE, "  flash size");
+	TEST_EQ(regions.num, 2, "  number of regions");
+	TEST_STR_EQ(regions.regions[0].name, "GBB", "  first name");
+	TEST_EQ(regions.regions[0].offset, 0x800, "  first offset");
+	TEST_EQ(regions.regions[0].size, 0x200, "  first size");
+	TEST_STR_EQ(regions.regions[1].name, "RO_FRID", "  second name");
+	TEST_EQ(regions.regions[1].data[0], (uint8_t)(0x100 * 7),
+		"  second data");
+	TEST_PTR_EQ(mock_layout_set, NULL, "  layout cleared");
+
+	p = flashrom_regions_get(&regions, 0x810, 0x10);
+	TEST_PTR_EQ(p, regions.regions[0].data + 0x10, "Get inside region");
+	TEST_EQ(p[0], (uint8_t)(0x810 * 7), "  data");
+	TEST_PTR_NEQ(flashrom_regions_get(&regions, 0x800, 0x200), NULL,
+		     "Get whole region");
+	TEST_PTR_EQ(flashrom_regions_get(&regions, 0x900, 0x101), NULL,
+		    "Get past end of region");
+	TEST_PTR_EQ(flashrom_regions_get(&regions, 0x7ff, 0x2), NULL,
+		    "Get before region");
+	TEST_PTR_EQ(flashrom_regions_get(&regions, 0x400, 0x1), NULL,
+		    "Get outside regions");
+	flashrom_free_regions(&regions);
+	TEST_EQ(regions.num, 0, "Free regions");
+
+	TEST_NEQ(flashrom_read_regions(&session, "host", bad_names, &regions,
+				       -1), 0, "Read unknown region");
+	TEST_EQ(regions.num, 0, "  nothing returned");
+	TEST_EQ(mock_reads, 1, "  not read");
+	TEST_PTR_EQ(session.flashctx, NULL, "  session closed");
+}
+
+static void write_ranges_tests(void)
+{
+	uint8_t data[MOCK_FLASH_SIZE] = {0};
+	struct firmware_image image = {
+		.programmer = "host",
+		.data = data,
+		.size = sizeof(data),
+	};
+	struct firmware_image small_image = image;
+	const struct flashrom_range ranges[] = {
+		{0x100, 0x40},
+		{0x800, 0x800},
+	};
+	const struct flashrom_range bad_ranges[] = {
+		{0x800, 0x801},
+	};
+
+	reset_common_data();
+	TEST_SUCC(flashrom_write_ranges(NULL, &image, ranges,
+					ARRAY_SIZE(ranges), NULL, 1, -1),
+		  "Write ranges");
+	TEST_EQ(mock_writes, 1, "  written");
+	TEST_EQ(mock_num_added, 2, "  ranges added");
+	TEST_EQ(mock_added_start[0], 0x100, "  first start");
+	TEST_EQ(mock_added_end[0], 0x13f, "  first end");
+	TEST_EQ(mock_added_start[1], 0x800, "  second start");
+	TEST_EQ(mock_added_end[1], 0xfff, "  second end");
+	TEST_PTR_EQ(mock_layout_set, NULL, "  layout cleared");
+
+	reset_common_data();
+	TEST_NEQ(flashrom_write_ranges(NULL, &image, bad_ranges,
+				       ARRAY_SIZE(bad_ranges), NULL, 1, -1), 0,
+		 "Write range past end of flash");
+	TEST_EQ(mock_writes, 0, "  not written");
+
+	small_image.size = sizeof(data) / 2;
+	TEST_NEQ(flashrom_write_ranges(NULL, &small_image, ranges, 1, NULL,
+				       1, -1), 0, "Write ranges of small image");
+	TEST_EQ(mock_writes, 0, "  not written");
+}
+
+int main(int argc, char *argv[])
+{
+	one_shot_tests();
+	session_tests();
+	read_regions_tests();
+	write_ranges_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
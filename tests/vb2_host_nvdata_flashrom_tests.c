@@ -18,6 +18,8 @@
 #include "2nvstorage.h"
 #include "2return_codes.h"
 #include "common/tests.h"
+#include "crossystem.h"
+#include "crossystem_arch.h"
 #include "crossystem_vbnv.h"
 #include "flashrom.h"
 
@@ -31,6 +33,8 @@ static void assert_mock_params(const char *programmer, const char *region)
 }
 
 static bool mock_flashrom_fail;
+static bool mock_flashrom_write_fail;
+static int mock_nv_writes;
 
 /* To support both 16-byte and 64-byte nvdata with the same fake
    eeprom, we can size the flash chip to be 16x64. So, for 16-byte
@@ -78,6 +82,8 @@ static void reset_test_data(struct vb2_context *ctx, int nvdata_size)
 
 	/* Flashrom succeeds unless the test says otherwise. */
 	mock_flashrom_fail = false;
+	mock_flashrom_write_fail = false;
+	mock_nv_writes = 0;
 }
 
 /* Mocked flashrom_read for tests. */
@@ -100,7 +106,7 @@ vb2_error_t flashrom_read(struct firmware_image *image, const char *region)
 /* Mocked flashrom_write for tests. */
 vb2_error_t flashrom_write(struct firmware_image *image, const char *region)
 {
-	if (mock_flashrom_fail)
+	if (mock_flashrom_fail || mock_flashrom_write_fail)
 		return VB2_ERROR_FLASHROM;
 
 	assert_mock_params(image->programmer, region);
@@ -111,6 +117,46 @@ vb2_error_t flashrom_write(struct firmware_image *image, const char *region)
 	return VB2_SUCCESS;
 }
 
+/* Mocked architecture functions, keeping the NV storage in the fake flash. */
+VbSharedDataHeader *VbSharedDataRead(void)
+{
+	return calloc(1, sizeof(VbSharedDataHeader));
+}
+
+int vb2_read_nv_storage(struct vb2_context *ctx)
+{
+	return vb2_read_nv_storage_flashrom(ctx);
+}
+
+int vb2_write_nv_storage(struct vb2_context *ctx)
+{
+	if (!(ctx->flags & VB2_CONTEXT_NVDATA_CHANGED))
+		return 0;
+
+	mock_nv_writes++;
+	return vb2_write_nv_storage_flashrom(ctx);
+}
+
+int VbGetArchPropertyInt(const char *name)
+{
+	return -1;
+}
+
+const char *VbGetArchPropertyString(const char *name, char *dest, size_t size)
+{
+	return NULL;
+}
+
+int VbSetArchPropertyInt(const char *name, int value)
+{
+	return -1;
+}
+
+int VbSetArchPropertyString(const char *name, const char *value)
+{
+	return -1;
+}
+
 static void test_read_ok_beginning(void)
 {
 	struct vb2_context ctx;
@@ -159,6 +205,52 @@ static void test_read_ok_full(void)
 		0, "The nvdata in the vb2_context was updated from flash");
 }
 
+static void test_read_ok_every_count(void)
+{
+	struct vb2_context ctx;
+	int count, entry;
+
+	/* The newest entry is found however many entries are in use. */
+	for (count = 1; count <= VB2_NVDATA_SIZE_V2; count++) {
+		reset_test_data(&ctx, sizeof(test_nvdata_16b));
+		for (entry = 0; entry < count - 1; entry++)
+			memcpy(fake_flash_region + (entry * VB2_NVDATA_SIZE),
+			       test_nvdata_16b, sizeof(test_nvdata_16b));
+		memcpy(fake_flash_region + ((count - 1) * VB2_NVDATA_SIZE),
+		       test_nvdata2_16b, sizeof(test_nvdata2_16b));
+
+		if (vb2_read_nv_storage_flashrom(&ctx) ||
+		    memcmp(ctx.nvdata, test_nvdata2_16b,
+			   sizeof(test_nvdata2_16b)))
+			break;
+	}
+	TEST_EQ(count, VB2_NVDATA_SIZE_V2 + 1,
+		"The newest entry is read for every number of entries");
+}
+
+static void test_read_ok_torn_entry(void)
+{
+	struct vb2_context ctx;
+	uint8_t torn[VB2_NVDATA_SIZE];
+
+	/* A partially written last entry has a bad CRC. */
+	memcpy(torn, test_nvdata_16b, sizeof(torn));
+	memset(torn + sizeof(torn) / 2, 0xff, sizeof(torn) / 2);
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region + VB2_NVDATA_SIZE, test_nvdata2_16b,
+	       sizeof(test_nvdata2_16b));
+	memcpy(fake_flash_region + (2 * VB2_NVDATA_SIZE), torn, sizeof(torn));
+
+	TEST_EQ(vb2_read_nv_storage_flashrom(&ctx), 0,
+		"Reading storage with a torn entry succeeds");
+	TEST_EQ(memcmp(ctx.nvdata, torn, sizeof(torn)), 0,
+		"The torn entry was read, as the firmware does");
+	TEST_NEQ(vb2_nv_check_crc(&ctx), VB2_SUCCESS,
+		 "  It is left for vb2_nv_init() to reset");
+}
+
 static void test_read_fail_uninitialized(void)
 {
 	struct vb2_context ctx;
@@ -238,6 +330,22 @@ static void test_write_ok_full(void)
 		"the beginning");
 }
 
+static void test_write_ok_after_torn_entry(void)
+{
+	struct vb2_context ctx;
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+	memset(fake_flash_region + VB2_NVDATA_SIZE, 0, VB2_NVDATA_SIZE);
+	memcpy(ctx.nvdata, test_nvdata2_16b, sizeof(test_nvdata2_16b));
+
+	TEST_EQ(vb2_write_nv_storage_flashrom(&ctx), 0,
+		"Writing storage after a torn entry succeeds");
+	TEST_EQ(memcmp(fake_flash_region + (2 * VB2_NVDATA_SIZE),
+		       test_nvdata2_16b, sizeof(test_nvdata2_16b)),
+		0, "The new entry was placed after the torn one");
+}
+
 static void test_write_fail_uninitialized(void)
 {
 	struct vb2_context ctx;
@@ -260,18 +368,113 @@ static void test_write_fail_flashrom(void)
 		 "Writing storage fails when flashrom fails");
 }
 
+static void test_set_properties_one_write(void)
+{
+	struct vb2_context ctx;
+	const VbSystemProperty props[] = {
+		{ .name = "dbg_reset", .value = 1 },
+		{ .name = "fw_try_count", .value = 3 },
+		{ .name = "loc_idx", .value = 5 },
+	};
+	uint8_t blank[VB2_NVDATA_SIZE];
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+
+	TEST_EQ(VbSetSystemProperties(props, ARRAY_SIZE(props)),
+		ARRAY_SIZE(props), "Setting several properties succeeds");
+	TEST_EQ(mock_nv_writes, 1, "  NV storage written once");
+	memset(blank, 0xff, sizeof(blank));
+	TEST_NEQ(memcmp(fake_flash_region + VB2_NVDATA_SIZE, blank,
+			sizeof(blank)), 0, "  One entry was added");
+	TEST_EQ(memcmp(fake_flash_region + (2 * VB2_NVDATA_SIZE), blank,
+		       sizeof(blank)), 0, "  Only one entry was added");
+	TEST_EQ(VbGetSystemPropertyInt("dbg_reset"), 1, "  dbg_reset set");
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 3,
+		"  fw_try_count set");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 5, "  loc_idx set");
+
+	/* Nothing is written if nothing changed. */
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+	TEST_EQ(VbSetSystemProperties(props, 0), 0, "Setting no properties");
+	TEST_EQ(mock_nv_writes, 0, "  NV storage not written");
+}
+
+static void test_set_properties_stop_at_failure(void)
+{
+	struct vb2_context ctx;
+	const VbSystemProperty props[] = {
+		{ .name = "dbg_reset", .value = 1 },
+		{ .name = "no_such_property", .value = 1 },
+		{ .name = "fw_try_count", .value = 3 },
+	};
+	uint8_t expected_flash[sizeof(fake_flash_region)];
+	int try_count;
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+	try_count = VbGetSystemPropertyInt("fw_try_count");
+
+	TEST_EQ(VbSetSystemProperties(props, ARRAY_SIZE(props)), 1,
+		"Setting stops at the first failure");
+	TEST_EQ(mock_nv_writes, 1, "  Properties before it are written");
+	TEST_EQ(VbGetSystemPropertyInt("dbg_reset"), 1, "  dbg_reset set");
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), try_count,
+		"  fw_try_count not set");
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+	memcpy(expected_flash, fake_flash_region, sizeof(expected_flash));
+	mock_flashrom_write_fail = true;
+
+	TEST_EQ(VbSetSystemProperties(props, 1), -1,
+		"Failing to write the NV storage is an error");
+	TEST_EQ(memcmp(fake_flash_region, expected_flash,
+		       sizeof(expected_flash)), 0, "  Flash not changed");
+}
+
+static void test_set_properties_pending_visible(void)
+{
+	struct vb2_context ctx;
+	/* Each of these reads the kernel field and sets some bits in it. */
+	const VbSystemProperty props[] = {
+		{ .name = "fwupdate_tries", .value = 3 },
+		{ .name = "block_devmode", .value = 1 },
+		{ .name = "tpm_attack", .value = 1 },
+	};
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+	memcpy(fake_flash_region, test_nvdata_16b, sizeof(test_nvdata_16b));
+
+	TEST_EQ(VbSetSystemProperties(props, ARRAY_SIZE(props)),
+		ARRAY_SIZE(props), "Setting fields of one NV value");
+	TEST_EQ(mock_nv_writes, 1, "  NV storage written once");
+	TEST_EQ(VbGetSystemPropertyInt("fwupdate_tries"), 3,
+		"  fwupdate_tries kept");
+	TEST_EQ(VbGetSystemPropertyInt("block_devmode"), 1,
+		"  block_devmode kept");
+	TEST_EQ(VbGetSystemPropertyInt("tpm_attack"), 1, "  tpm_attack set");
+}
+
 int main(int argc, char *argv[])
 {
 	test_read_ok_beginning();
 	test_read_ok_2ndentry();
 	test_read_ok_full();
+	test_read_ok_every_count();
+	test_read_ok_torn_entry();
 	test_read_fail_uninitialized();
 	test_read_fail_flashrom();
 	test_write_ok_beginning();
 	test_write_ok_2ndentry();
 	test_write_ok_full();
+	test_write_ok_after_torn_entry();
 	test_write_fail_uninitialized();
 	test_write_fail_flashrom();
+	test_set_properties_one_write();
+	test_set_properties_stop_at_failure();
+	test_set_properties_pending_visible();
 
 	return gTestSuccess ? 0 : 255;
 }
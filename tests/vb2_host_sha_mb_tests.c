@@ -0,0 +1,142 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host multi-buffer hashing.
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+#include "common/tests.h"
+#include "host_sha_mb.h"
+#include "sha_test_vectors.h"
+
+/* More jobs than lanes, so lanes are refilled while others still run. */
+#define NUM_JOBS (3 * VB2_SHA_MB_LANES + 1)
+
+static uint8_t *data;
+static uint32_t data_size;
+
+/* Check every job against the single-buffer implementation. */
+static void check_jobs(enum vb2_hash_algorithm algo,
+		       struct vb2_hash_job *jobs, size_t count,
+		       const char *desc)
+{
+	struct vb2_hash expect;
+	int mismatch = 0;
+	size_t i;
+
+	TEST_SUCC(vb2_hash_calculate_multi(algo, jobs, count), desc);
+	for (i = 0; i < count; i++) {
+		vb2_hash_calculate(false, jobs[i].buf, jobs[i].size, algo,
+				   &expect);
+		if (jobs[i].hash->algo != algo ||
+		    memcmp(jobs[i].hash->raw, expect.raw,
+			   vb2_digest_size(algo)))
+			mismatch++;
+	}
+	TEST_EQ(mismatch, 0, "  digests match vb2_hash_calculate()");
+}
+
+static void known_value_tests(void)
+{
+	const char *inputs[3] = { oneblock_msg, multiblock_msg1, long_msg };
+	/* Enough jobs to fill the lanes, so the vectors are used. */
+	struct vb2_hash hash[VB2_SHA_MB_LANES];
+	struct vb2_hash_job jobs[VB2_SHA_MB_LANES];
+	int i;
+
+	for (i = 0; i < VB2_SHA_MB_LANES; i++) {
+		jobs[i].buf = inputs[i % 3];
+		jobs[i].size = strlen(inputs[i % 3]);
+		jobs[i].hash = &hash[i];
+	}
+	TEST_SUCC(vb2_hash_calculate_multi(VB2_HASH_SHA256, jobs,
+					   VB2_SHA_MB_LANES),
+		  "SHA-256 known values");
+	for (i = 0; i < VB2_SHA_MB_LANES; i++)
+		TEST_EQ(memcmp(hash[i].sha256, sha256_results[i % 3],
+			       sizeof(sha256_results[i % 3])), 0,
+			"  SHA-256 digest");
+
+	for (i = 1; i < VB2_SHA_MB_LANES; i += 3) {
+		jobs[i].buf = multiblock_msg2;
+		jobs[i].size = strlen(multiblock_msg2);
+	}
+	TEST_SUCC(vb2_hash_calculate_multi(VB2_HASH_SHA512, jobs,
+					   VB2_SHA_MB_LANES),
+		  "SHA-512 known values");
+	for (i = 0; i < VB2_SHA_MB_LANES; i++)
+		TEST_EQ(memcmp(hash[i].sha512, sha512_results[i % 3],
+			       sizeof(sha512_results[i % 3])), 0,
+			"  SHA-512 digest");
+}
+
+static void mixed_size_tests(void)
+{
+	const enum vb2_hash_algorithm algos[] = {
+		VB2_HASH_SHA1, VB2_HASH_SHA224, VB2_HASH_SHA256,
+		VB2_HASH_SHA384, VB2_HASH_SHA512,
+	};
+	struct vb2_hash hash[NUM_JOBS];
+	struct vb2_hash_job jobs[NUM_JOBS];
+	uint32_t size;
+	int i, a;
+
+	/* Sizes around every padding boundary, plus some long messages */
+	for (i = 0; i < NUM_JOBS; i++) {
+		size = (i * 37) % 300;
+		if (i % 5 == 0)
+			size = data_size - i;
+		jobs[i].buf = data + i;
+		jobs[i].size = size;
+		jobs[i].hash = &hash[i];
+	}
+
+	for (a = 0; a < ARRAY_SIZE(algos); a++) {
+		char desc[64];
+		snprintf(desc, sizeof(desc), "Mixed sizes, algo %d", algos[a]);
+		check_jobs(algos[a], jobs, NUM_JOBS, desc);
+	}
+
+	/* Every length a single-block tail can have, and its neighbours */
+	for (i = 0; i < NUM_JOBS; i++)
+		jobs[i].size = 40 + i * 3;
+	check_jobs(VB2_HASH_SHA256, jobs, NUM_JOBS, "SHA-256 tail lengths");
+	for (i = 0; i < NUM_JOBS; i++)
+		jobs[i].size = 100 + i * 3;
+	check_jobs(VB2_HASH_SHA512, jobs, NUM_JOBS, "SHA-512 tail lengths");
+
+	/* Fewer jobs than lanes (hashed one by one), and none at all */
+	check_jobs(VB2_HASH_SHA256, jobs, 1, "Single job");
+	check_jobs(VB2_HASH_SHA512, jobs, VB2_SHA_MB_LANES - 1,
+		   "Fewer jobs than lanes");
+	TEST_SUCC(vb2_hash_calculate_multi(VB2_HASH_SHA512, jobs, 0),
+		  "No jobs");
+}
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	/* Initialize long_msg with 'a' x 1,000,000 */
+	long_msg = (char *) malloc(1000001);
+	memset(long_msg, 'a', 1000000);
+	long_msg[1000000] = 0;
+
+	data_size = 100000;
+	data = malloc(data_size);
+	for (i = 0; i < data_size; i++)
+		data[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	known_value_tests();
+	mixed_size_tests();
+
+	free(data);
+	free(long_msg);
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,192 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for persistent external signers.
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2sysincludes.h"
+#include "common/tests.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_signature.h"
+
+/* More than the signer is allowed to have in flight at once */
+#define NUM_REQUESTS 40
+
+static const uint8_t test_data[] = "Some test data";
+
+struct test_key {
+	const char *name;
+	enum vb2_crypto_algorithm alg;
+	char pem[1024];
+	struct vb2_private_key *key;
+};
+
+static struct test_key test_keys[] = {
+	{"key_rsa2048", VB2_ALG_RSA2048_SHA256},
+	{"key_rsa4096", VB2_ALG_RSA4096_SHA512},
+};
+
+static void signer_tests(const char *signer_path)
+{
+	struct vb2_external_signer *signer;
+	struct vb2_signature *sig, *expect;
+	int ids[NUM_REQUESTS];
+	int mismatch = 0;
+	int bad_id;
+	int i;
+
+	signer = vb2_external_signer_open(signer_path);
+	TEST_PTR_NEQ(signer, NULL, "Start signer");
+	if (!signer)
+		return;
+
+	/* Keep many requests in flight, alternating keys */
+	for (i = 0; i < NUM_REQUESTS; i++) {
+		const struct test_key *k = test_keys + i % 2;
+
+		ids[i] = vb2_external_signer_submit(signer, test_data, i + 1,
+						    k->pem, k->alg);
+		if (ids[i] < 0)
+			break;
+	}
+	TEST_EQ(i, NUM_REQUESTS, "Submit requests");
+
+	/* A bad key only fails its own request */
+	bad_id = vb2_external_signer_submit(signer, test_data, 1,
+					    "/nonexistent.pem",
+					    VB2_ALG_RSA2048_SHA256);
+	TEST_TRUE(bad_id >= 0, "Submit request with bad key");
+
+	/* Collect them in a different order */
+	TEST_PTR_EQ(vb2_external_signer_collect(signer, bad_id), NULL,
+		    "Bad key fails");
+	for (i = NUM_REQUESTS - 1; i >= 0; i--) {
+		const struct test_key *k = test_keys + i % 2;
+
+		sig = vb2_external_signer_collect(signer, ids[i]);
+		expect = vb2_calculate_signature(test_data, i + 1, k->key);
+		if (!sig || !expect || sig->sig_size != expect->sig_size ||
+		    sig->data_size != i + 1 ||
+		    memcmp(vb2_signature_data(sig), vb2_signature_data(expect),
+			   expect->sig_size))
+			mismatch++;
+		free(sig);
+		free(expect);
+	}
+	TEST_EQ(mismatch, 0, "Signatures match private key signatures");
+
+	TEST_PTR_EQ(vb2_external_signer_collect(signer, ids[0]), NULL,
+		    "Collect twice");
+
+	vb2_external_signer_close(signer);
+}
+
+static void persist_tests(const char *signer_path)
+{
+	const struct test_key *k = test_keys;
+	struct vb2_signature *sig, *expect;
+	int ids[4];
+	int mismatch = 0;
+	int old_id;
+	int i;
+
+	expect = vb2_calculate_signature(test_data, sizeof(test_data), k->key);
+
+	vb2_external_signer_persist(true);
+	sig = vb2_external_signature(test_data, sizeof(test_data), k->pem,
+				     k->alg, signer_path);
+	TEST_PTR_NEQ(sig, NULL, "Persistent vb2_external_signature()");
+	if (sig && expect)
+		TEST_SUCC(memcmp(vb2_signature_data(sig),
+				 vb2_signature_data(expect), expect->sig_size),
+			  "  signature matches");
+	free(sig);
+
+	sig = vb2_external_signature(test_data, sizeof(test_data),
+				     "/nonexistent.pem", k->alg, signer_path);
+	TEST_PTR_EQ(sig, NULL, "  bad key");
+
+	sig = vb2_external_signature(test_data, sizeof(test_data), k->pem,
+				     k->alg, signer_path);
+	TEST_PTR_NEQ(sig, NULL, "  signer still running");
+	free(sig);
+
+	/* Several requests in flight before any is collected */
+	for (i = 0; i < ARRAY_SIZE(ids); i++)
+		ids[i] = vb2_external_signature_submit(test_data,
+						       sizeof(test_data),
+						       k->pem, k->alg,
+						       signer_path);
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		sig = vb2_external_signature_collect(ids[i]);
+		if (!sig || !expect ||
+		    memcmp(vb2_signature_data(sig), vb2_signature_data(expect),
+			   expect->sig_size))
+			mismatch++;
+		free(sig);
+	}
+	TEST_EQ(mismatch, 0, "  submitted signatures match");
+	old_id = vb2_external_signature_submit(test_data, sizeof(test_data),
+					       k->pem, k->alg, signer_path);
+	TEST_TRUE(old_id >= 0, "  submit before restart");
+	vb2_external_signer_persist(false);
+
+	TEST_EQ(vb2_external_signature_submit(test_data, sizeof(test_data),
+					      k->pem, k->alg, signer_path),
+		-1, "  submit needs a persistent signer");
+
+	/* IDs from a stopped signer don't match a new signer's requests */
+	vb2_external_signer_persist(true);
+	ids[0] = vb2_external_signature_submit(test_data, sizeof(test_data),
+					       k->pem, k->alg, signer_path);
+	TEST_NEQ(ids[0], old_id, "  IDs not reused after restart");
+	TEST_PTR_EQ(vb2_external_signature_collect(old_id), NULL,
+		    "  old request dropped");
+	sig = vb2_external_signature_collect(ids[0]);
+	TEST_PTR_NEQ(sig, NULL, "  new request signed");
+	free(sig);
+	vb2_external_signer_persist(false);
+
+	/* A signer which doesn't exist */
+	vb2_external_signer_persist(true);
+	sig = vb2_external_signature(test_data, sizeof(test_data), k->pem,
+				     k->alg, "/nonexistent_signer");
+	TEST_PTR_EQ(sig, NULL, "  bad signer");
+	vb2_external_signer_persist(false);
+
+	free(expect);
+}
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <signer> <keys_dir>\n", argv[0]);
+		return -1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(test_keys); i++) {
+		struct test_key *k = test_keys + i;
+
+		snprintf(k->pem, sizeof(k->pem), "%s/%s.pem", argv[2], k->name);
+		k->key = vb2_read_private_key_pem(k->pem, k->alg);
+		if (!k->key) {
+			fprintf(stderr, "Error reading %s\n", k->pem);
+			return 1;
+		}
+	}
+
+	signer_tests(argv[1]);
+	persist_tests(argv[1]);
+
+	for (i = 0; i < ARRAY_SIZE(test_keys); i++)
+		vb2_free_private_key(test_keys[i].key);
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -32,6 +32,9 @@ static int mock_part_next;
 /* Mock data */
 static uint8_t kernel_buffer[80000];
 static int disk_read_to_fail;
+static int disk_read_count;
+static uint64_t disk_read_lba[16];
+static uint32_t digest_extend_bytes;
 static int gpt_init_fail;
 static int keyblock_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
@@ -58,6 +61,9 @@ static struct vb2_packed_key mock_key;
 static void ResetMocks(void)
 {
 	disk_read_to_fail = -1;
+	disk_read_count = 0;
+	memset(disk_read_lba, 0, sizeof(disk_read_lba));
+	digest_extend_bytes = 0;
 
 	gpt_init_fail = 0;
 	keyblock_verify_fail = 0;
@@ -159,6 +165,9 @@ vb2_error_t VbExDiskRead(vb2ex_disk_handle_t h, uint64_t lba_start,
 	if ((int)lba_start == disk_read_to_fail)
 		return VB2_ERROR_MOCK;
 
+	if (disk_read_count < ARRAY_SIZE(disk_read_lba))
+		disk_read_lba[disk_read_count] = lba_start;
+	disk_read_count++;
 	return VB2_SUCCESS;
 }
 
@@ -212,6 +221,7 @@ vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	key->hash_alg = VB2_HASH_SHA256;
 	return VB2_SUCCESS;
 }
 
@@ -251,10 +261,9 @@ vb2_error_t vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
-			    struct vb2_signature *sig,
-			    const struct vb2_public_key *key,
-			    const struct vb2_workbuf *wb)
+vb2_error_t vb2_verify_digest(const struct vb2_public_key *key,
+			      struct vb2_signature *sig, const uint8_t *digest,
+			      const struct vb2_workbuf *wb)
 {
 	if (verify_data_fail)
 		return VB2_ERROR_MOCK;
@@ -262,6 +271,13 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2_digest_extend(struct vb2_digest_context *dc, const uint8_t *buf,
+			      uint32_t size)
+{
+	digest_extend_bytes += size;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2_digest_finalize(struct vb2_digest_context *dc, uint8_t *digest,
 				uint32_t digest_size)
 {
@@ -595,6 +611,25 @@ static void load_kernel_tests(void)
 	ResetMocks();
 	kph.body_signature.data_size = 8192;
 	test_load_kernel(VB2_SUCCESS, "Kernel tiny");
+	TEST_EQ(digest_extend_bytes, 8192, "  hashed whole body");
+
+	/* Body is hashed a chunk at a time as it is read */
+	ResetMocks();
+	test_load_kernel(VB2_SUCCESS, "Default body chunk size");
+	TEST_EQ(disk_read_count, 2, "  vblock and body in one read each");
+	TEST_EQ(digest_extend_bytes, 70144, "  hashed whole body");
+
+	ResetMocks();
+	lkp.body_chunk_size = 2048;
+	test_load_kernel(VB2_SUCCESS, "Small body chunk size");
+	TEST_EQ(disk_read_count, 1 + 5, "  body read in chunks");
+	TEST_EQ(digest_extend_bytes, 70144, "  hashed whole body");
+
+	ResetMocks();
+	lkp.body_chunk_size = 2048;
+	disk_read_to_fail = 228 + 4;
+	test_load_kernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+			 "Fail reading second body chunk");
 
 	ResetMocks();
 	disk_read_to_fail = 228;
@@ -617,10 +652,85 @@ static void load_kernel_tests(void)
 	test_load_kernel(VB2_SUCCESS, "Can't read disk");
 }
 
+static void batch_vblocks_tests(void)
+{
+	/* A good first kernel ends the search before anything is batched */
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	test_load_kernel(VB2_SUCCESS, "Batch: first kernel good");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(disk_read_count, 2, "  only first vblock and body read");
+	TEST_EQ(disk_read_lba[0], 100, "  vblock");
+	TEST_EQ(disk_read_lba[1], 228, "  then body after vblock");
+	TEST_EQ(digest_extend_bytes, 70144, "  hashed whole body");
+
+	/* Vblocks checked for rollback are read together in LBA order */
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	mock_parts[1].start = 600;
+	mock_parts[1].size = 150;
+	mock_parts[2].start = 400;
+	mock_parts[2].size = 150;
+	sd->kernel_version_secdata = 0x10001;
+	kbh.data_key.key_version = 3;
+	test_load_kernel(VB2_SUCCESS, "Batch: check other vblock versions");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(disk_read_count, 4, "  one read per remaining vblock");
+	TEST_EQ(disk_read_lba[2], 400, "  lowest remaining vblock first");
+	TEST_EQ(disk_read_lba[3], 600, "  then next vblock");
+	TEST_EQ(sd->kernel_version, 0x30001, "  roll forward");
+
+	/* A vblock that can't be read in the batch is retried serially */
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	sd->kernel_version_secdata = 0x10001;
+	disk_read_to_fail = 300;
+	test_load_kernel(VB2_SUCCESS, "Batch: other vblock unreadable");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(disk_read_count, 2, "  first vblock and body");
+
+	/* Without a good kernel, partitions are still tried one at a time */
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	disk_read_to_fail = 100;
+	test_load_kernel(VB2_SUCCESS, "Batch: first vblock unreadable");
+	TEST_EQ(lkp.partition_number, 2, "  part num");
+	TEST_EQ(disk_read_count, 2, "  second vblock and body");
+	TEST_EQ(disk_read_lba[1], 428, "  body after second vblock");
+
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	keyblock_verify_fail = 1;
+	test_load_kernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+			 "Batch: bad keyblock");
+
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	disk_read_to_fail = 228;
+	test_load_kernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+			 "Batch: fail reading kernel data");
+
+	/* Partition too small to hold a vblock isn't batched */
+	ResetMocks();
+	disk_info.flags |= VB2_DISK_FLAG_BATCH_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 100;
+	sd->kernel_version_secdata = 0x10001;
+	test_load_kernel(VB2_SUCCESS, "Batch: partition smaller than vblock");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+}
+
 int main(void)
 {
 	invalid_params_tests();
 	load_kernel_tests();
+	batch_vblocks_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
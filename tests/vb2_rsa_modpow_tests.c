@@ -0,0 +1,176 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests that the RSA exponentiation implementations agree with each other.
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2rsa_private.h"
+#include "2sysincludes.h"
+#include "common/tests.h"
+
+#define MAX_WORDS (8192 / 32)
+
+static uint32_t n[MAX_WORDS], n2[MAX_WORDS];
+static uint32_t rr[MAX_WORDS], rr2[MAX_WORDS];
+static uint32_t workbuf32[3 * MAX_WORDS];
+static uint32_t rand_state = 0x12345678;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) | (rand_state << 16);
+}
+
+/* Make up a modulus with the top and bottom bits set, and its constants. */
+static void make_key(struct vb2_public_key *key, uint32_t words,
+		     uint32_t *mod, uint32_t *r2)
+{
+	uint32_t inv;
+	int i, j;
+
+	key->arrsize = words;
+	key->n = mod;
+	key->rr = r2;
+
+	for (i = 0; i < words; i++)
+		mod[i] = next_rand();
+	mod[0] |= 1;
+	mod[words - 1] |= 0x80000000;
+
+	/* -1 / n mod 2^32, by Newton's method */
+	inv = mod[0];
+	for (i = 0; i < 4; i++)
+		inv *= 2 - mod[0] * inv;
+
+	/* R^2 mod n, by doubling 1 mod n */
+	memset(r2, 0, words * sizeof(uint32_t));
+	r2[0] = 1;
+	for (i = 0; i < 64 * words; i++) {
+		uint32_t carry = 0;
+		for (j = 0; j < words; j++) {
+			uint32_t top = r2[j] >> 31;
+			r2[j] = r2[j] << 1 | carry;
+			carry = top;
+		}
+		if (carry || vb2_mont_ge(key, r2)) {
+			int64_t A = 0;
+			for (j = 0; j < words; j++) {
+				A += (uint64_t)r2[j] - mod[j];
+				r2[j] = (uint32_t)A;
+				A >>= 32;
+			}
+		}
+	}
+
+	key->n0inv = -inv;
+}
+
+static void check_key(uint32_t words, int exp)
+{
+	struct vb2_public_key key = {0};
+	uint8_t in[MAX_WORDS * 4];
+	uint8_t expect[MAX_WORDS * 4];
+	uint8_t got[MAX_WORDS * 4];
+	int mismatch64 = 0, mismatch_ifma = 0;
+	int i, j;
+
+	make_key(&key, words, n, rr);
+
+	printf("Testing RSA-%u exponent %d\n", words * 32, exp);
+
+	/* Known values: 1^exp and 2^3 */
+	memset(in, 0, words * 4);
+	in[words * 4 - 1] = exp == 3 ? 2 : 1;
+	vb2_modpow32(&key, in, workbuf32, exp);
+	TEST_EQ(in[words * 4 - 1], exp == 3 ? 8 : 1, "  known value");
+
+	for (i = 0; i < 20; i++) {
+		/* The last input is all ones, which is above the modulus */
+		for (j = 0; j < words * 4; j++)
+			in[j] = i == 19 ? 0xff : (uint8_t)next_rand();
+
+		memcpy(expect, in, words * 4);
+		vb2_modpow32(&key, expect, workbuf32, exp);
+
+#ifdef VB2_RSA_LIMB64
+		memcpy(got, in, words * 4);
+		vb2_modpow64(&key, got, workbuf32, exp);
+		if (memcmp(got, expect, words * 4))
+			mismatch64++;
+#endif
+
+#ifdef X86_RSA_DISPATCH
+		if (vb2_modpow_ifma_supported(&key)) {
+			memcpy(got, in, words * 4);
+			vb2_modpow_ifma(&key, got, exp);
+			if (memcmp(got, expect, words * 4))
+				mismatch_ifma++;
+		}
+#endif
+	}
+
+	TEST_EQ(mismatch64, 0, "  64-bit limbs match 32-bit limbs");
+	TEST_EQ(mismatch_ifma, 0, "  IFMA matches 32-bit limbs");
+}
+
+#ifdef X86_RSA_DISPATCH
+/* Alternate between keys, and reuse a key's memory for a new key */
+static void check_ifma_key_cache(void)
+{
+	struct vb2_public_key key1 = {0}, key2 = {0};
+	uint8_t in[2048 / 8];
+	uint8_t expect[sizeof(in)];
+	uint8_t got[sizeof(in)];
+	int mismatch = 0;
+	int i, j;
+
+	make_key(&key1, 2048 / 32, n, rr);
+	make_key(&key2, 2048 / 32, n2, rr2);
+	if (!vb2_modpow_ifma_supported(&key1))
+		return;
+
+	for (i = 0; i < 12; i++) {
+		struct vb2_public_key *key = i & 1 ? &key2 : &key1;
+
+		/* Same buffer, new modulus */
+		if (i == 6)
+			make_key(&key1, 2048 / 32, n, rr);
+
+		for (j = 0; j < sizeof(in); j++)
+			in[j] = (uint8_t)next_rand();
+		memcpy(expect, in, sizeof(in));
+		vb2_modpow32(key, expect, workbuf32, 65537);
+		memcpy(got, in, sizeof(in));
+		vb2_modpow_ifma(key, got, 65537);
+		if (memcmp(got, expect, sizeof(in)))
+			mismatch++;
+	}
+	TEST_EQ(mismatch, 0, "IFMA key cache");
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef X86_RSA_DISPATCH
+	struct vb2_public_key key = {.arrsize = MAX_WORDS};
+	printf("AVX-512 IFMA %s\n",
+	       vb2_modpow_ifma_supported(&key) ? "supported" : "not supported");
+#endif
+
+	check_key(1024 / 32, 65537);
+	check_key(2048 / 32, 65537);
+	check_key(2048 / 32, 3);
+	check_key(3072 / 32, 3);
+	check_key(4096 / 32, 65537);
+	check_key(8192 / 32, 65537);
+#ifdef X86_RSA_DISPATCH
+	check_ifma_key_cache();
+#endif
+
+	return gTestSuccess ? 0 : 255;
+}
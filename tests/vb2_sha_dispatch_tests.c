@@ -0,0 +1,122 @@
+/* Copyright 2026 The ChromiumOS Authors.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for run-time selected SHA-256 block transforms.
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+#include "common/tests.h"
+#include "sha_test_vectors.h"
+
+#ifdef X86_SHA_DISPATCH
+
+#include <cpuid.h>
+
+/* Hash a buffer with just a block transform, doing the padding here. */
+static void sha256_with(vb2_sha256_transform_fn transform,
+			const uint8_t *buf, uint32_t size, uint8_t *digest)
+{
+	uint8_t tail[2 * VB2_SHA256_BLOCK_SIZE];
+	uint32_t h[8];
+	uint32_t blocks = size / VB2_SHA256_BLOCK_SIZE;
+	uint32_t rem = size % VB2_SHA256_BLOCK_SIZE;
+	uint32_t tail_size;
+	int i;
+
+	memcpy(h, vb2_sha256_h0, sizeof(h));
+	transform(h, buf, blocks);
+
+	tail_size = VB2_SHA256_BLOCK_SIZE *
+		(1 + (rem > VB2_SHA256_BLOCK_SIZE - SHA256_MIN_PAD_LEN));
+	memset(tail, 0, sizeof(tail));
+	memcpy(tail, buf + blocks * VB2_SHA256_BLOCK_SIZE, rem);
+	tail[rem] = SHA256_PAD_BEGIN;
+	UNPACK32(size * 8, tail + tail_size - 4);
+	transform(h, tail, tail_size / VB2_SHA256_BLOCK_SIZE);
+
+	for (i = 0; i < 8; i++)
+		UNPACK32(h[i], &digest[i * 4]);
+}
+
+static void check_transform(vb2_sha256_transform_fn transform,
+			    const char *name)
+{
+	const char *inputs[3] = { oneblock_msg, multiblock_msg1, long_msg };
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	struct vb2_hash expect;
+	uint8_t *data;
+	uint32_t size;
+	int mismatch = 0;
+	int i;
+
+	printf("Testing %s\n", name);
+
+	for (i = 0; i < 3; i++) {
+		sha256_with(transform, (const uint8_t *)inputs[i],
+			    strlen(inputs[i]), digest);
+		TEST_EQ(memcmp(digest, sha256_results[i], sizeof(digest)), 0,
+			"  SHA-256 known value");
+	}
+
+	/* Every block count up to two batches of lanes, plus odd tails */
+	data = malloc(20 * VB2_SHA256_BLOCK_SIZE);
+	for (i = 0; i < 20 * VB2_SHA256_BLOCK_SIZE; i++)
+		data[i] = (uint8_t)(i * 13 + (i >> 7));
+	for (size = 0; size <= 20 * VB2_SHA256_BLOCK_SIZE; size += 29) {
+		sha256_with(transform, data, size, digest);
+		vb2_hash_calculate(false, data, size, VB2_HASH_SHA256,
+				   &expect);
+		if (memcmp(digest, expect.sha256, sizeof(digest)))
+			mismatch++;
+	}
+	TEST_EQ(mismatch, 0, "  digests match vb2_hash_calculate()");
+	free(data);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int a, b, c, d;
+	vb2_sha256_transform_fn fast;
+
+	/* Initialize long_msg with 'a' x 1,000,000 */
+	long_msg = (char *) malloc(1000001);
+	memset(long_msg, 'a', 1000000);
+	long_msg[1000000] = 0;
+
+	fast = vb2_sha256_x86_transform();
+	TEST_EQ(!fast, !strcmp(vb2_digest_impl_name(VB2_HASH_SHA256),
+			       "generic"), "SHA-256 implementation name");
+	printf("SHA-256 implementation: %s\n",
+	       vb2_digest_impl_name(VB2_HASH_SHA256));
+	if (fast)
+		check_transform(fast, "selected transform");
+
+	if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSSE3))
+		check_transform(vb2_sha256_transform_ssse3, "SSSE3");
+
+	if (__get_cpuid_count(7, 0, &a, &b, &c, &d) &&
+	    (b & bit_AVX2) && (b & bit_BMI2))
+		check_transform(vb2_sha256_transform_avx2, "AVX2");
+
+	free(long_msg);
+
+	return gTestSuccess ? 0 : 255;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+	TEST_STR_EQ(vb2_digest_impl_name(VB2_HASH_SHA256), "generic",
+		    "Portable SHA-256 implementation");
+
+	return gTestSuccess ? 0 : 255;
+}
+
+#endif
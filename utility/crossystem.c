@@ -112,6 +112,9 @@ static void PrintHelp(const char *progname) {
          "  %s [--all]\n"
          "    Prints all parameters with descriptions and current values.\n"
          "    If --all is specified, prints even normally hidden fields.\n"
+         "  %s --json\n"
+         "    Prints all parameters and their values as a JSON object, with\n"
+         "    null for the values which can't be read.\n"
          "  %s [param1 [param2 [...]]]\n"
          "    Prints the current value(s) of the parameter(s).\n"
          "  %s [param1=value1] [param2=value2 [...]]]\n"
@@ -120,7 +123,8 @@ static void PrintHelp(const char *progname) {
          "    Checks if the parameter(s) all contain the specified value(s).\n"
          "    Stops at the first error.\n"
          "\n"
-         "Valid parameters:\n", progname, progname, progname, progname);
+         "Valid parameters:\n", progname, progname, progname, progname,
+         progname);
   for (p = sys_param_list; p->name; p++) {
     printf("  %-*s  [%s/%s] %s\n", kNameWidth, p->name,
            (p->flags & CAN_WRITE) ? "RW" : "RO",
@@ -164,24 +168,54 @@ enum {
   PARAM_ERROR_INVALID_INT,
 };
 
-/* Set the specified parameter.
+/* Parameters queued by SetParam() for FlushParams() to set */
+static VbSystemProperty* pending;
+static int num_pending;
+
+/* Queue the specified parameter to be set by FlushParams().
  *
  * Returns PARAM_SUCCESS if success, PARAM_ERROR_* if error. */
 static int SetParam(const Param* p, const char* value) {
+  VbSystemProperty* prop = &pending[num_pending];
+
   if (!(p->flags & CAN_WRITE))
     return PARAM_ERROR_READ_ONLY;
 
+  prop->name = p->name;
   if (p->flags & IS_STRING) {
-    return (0 == VbSetSystemPropertyString(p->name, value) ?
-            0 : PARAM_ERROR_UNKNOWN);
+    prop->str = value;
   } else {
     char* e;
     int i = (int)strtol(value, &e, 0);
     if (!*value || (e && *e))
       return PARAM_ERROR_INVALID_INT;
-    return (0 == VbSetSystemPropertyInt(p->name, i) ?
-            0 : PARAM_ERROR_UNKNOWN);
+    prop->str = NULL;
+    prop->value = i;
+  }
+  num_pending++;
+  return PARAM_SUCCESS;
+}
+
+/* Set all the parameters queued by SetParam() at once, so the NV storage is
+ * written only once.
+ *
+ * Returns PARAM_SUCCESS if success, PARAM_ERROR_UNKNOWN if error. */
+static int FlushParams(void) {
+  int set, i;
+
+  if (!num_pending)
+    return PARAM_SUCCESS;
+
+  set = VbSetSystemProperties(pending, num_pending);
+  if (set < 0) {
+    for (i = 0; i < num_pending; i++)
+      fprintf(stderr, "Failed to set parameter %s\n", pending[i].name);
+  } else if (set < num_pending) {
+    fprintf(stderr, "Failed to set parameter %s\n", pending[set].name);
   }
+  i = num_pending;
+  num_pending = 0;
+  return set == i ? PARAM_SUCCESS : PARAM_ERROR_UNKNOWN;
 }
 
 /* Compares the parameter with the expected value.
@@ -260,6 +294,53 @@ static int PrintAllParams(int force_all) {
 }
 
 
+/* Print a string as a JSON string. */
+static void PrintJsonString(const char* s) {
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c == '\n')
+      printf("\\n");
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+  }
+  putchar('"');
+}
+
+
+/* Print all parameters, including normally hidden ones, as one JSON object.
+ *
+ * Returns 0 if success, non-zero if error. */
+static int PrintAllParamsJson(void) {
+  const Param* p;
+  char buf[VB_MAX_STRING_PROPERTY];
+
+  printf("{");
+  for (p = sys_param_list; p->name; p++) {
+    printf("%s\n  \"%s\": ", p == sys_param_list ? "" : ",", p->name);
+    if (p->flags & IS_STRING) {
+      const char* v = VbGetSystemPropertyString(p->name, buf, sizeof(buf));
+      if (v)
+        PrintJsonString(v);
+      else
+        printf("null");
+    } else {
+      int v = VbGetSystemPropertyInt(p->name);
+      if (v == -1)
+        printf("null");
+      else
+        printf(p->format ? "%u" : "%d", v);
+    }
+  }
+  printf("\n}\n");
+  return 0;
+}
+
+
 int main(int argc, char* argv[]) {
   int retval = 0;
   int i;
@@ -270,12 +351,17 @@ int main(int argc, char* argv[]) {
   else
     progname = argv[0];
 
+  /* Read everything at most once, however many params are asked for */
+  VbSystemPropertySnapshotBegin();
+
   /* If no args specified, print all params */
   if (argc == 1)
     return PrintAllParams(0);
   /* --all or -a prints all params including normally hidden ones */
   if (!strcasecmp(argv[1], "--all") || !strcmp(argv[1], "-a"))
     return PrintAllParams(1);
+  if (!strcasecmp(argv[1], "--json"))
+    return PrintAllParamsJson();
 
   /* Print help if needed */
   if (!strcasecmp(argv[1], "-h") || !strcmp(argv[1], "-?") ||
@@ -284,6 +370,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  pending = calloc(argc, sizeof(*pending));
+  if (!pending)
+    return 1;
+
   /* Otherwise, loop through params and get/set them */
   for (i = 1; i < argc && retval == 0; i++) {
     char* has_set = strchr(argv[i], '=');
@@ -296,14 +386,16 @@ int main(int argc, char* argv[]) {
     if (!name || has_set == argv[i] || has_expect == argv[i]) {
       fprintf(stderr, "Poorly formed parameter\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
     if (!value)
       value=""; /* Allow setting/checking an empty string ('foo=' or 'foo?') */
     if (has_set && has_expect) {
       fprintf(stderr, "Use either = or ? in a parameter, but not both.\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     /* Find the parameter */
@@ -311,7 +403,8 @@ int main(int argc, char* argv[]) {
     if (!p) {
       fprintf(stderr, "Invalid parameter name: %s\n", name);
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     if (i > 1)
@@ -331,11 +424,20 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "Failed to set parameter %s\n", p->name);
         break;
       }
-    } else if (has_expect)
-      retval = CheckParam(p, value);
-    else
-      retval = PrintParam(p);
+    } else {
+      /* Set the params before this one first, so it sees their values */
+      retval = FlushParams();
+      if (retval == 0 && has_expect)
+        retval = CheckParam(p, value);
+      else if (retval == 0)
+        retval = PrintParam(p);
+    }
   }
 
+  /* Set the params after the last check or print */
+  if (FlushParams() != PARAM_SUCCESS && retval == 0)
+    retval = PARAM_ERROR_UNKNOWN;
+
+  free(pending);
   return retval;
 }